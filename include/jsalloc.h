@@ -0,0 +1,29 @@
+#ifndef JSALLOC_H
+#define JSALLOC_H
+
+#include <inttypes.h>
+
+/// @brief Allocation counter, for checking that steady state never touches the heap.
+///        Linking jsalloc.cpp interposes malloc, calloc, realloc, reallocarray and the
+///        aligned allocators (posix_memalign, aligned_alloc, memalign, valloc, pvalloc)
+///        by ones which count calls while counting is enabled. Global operator new,
+///        aligned ones included, goes through them, so does libc.
+///        Allocations made inside glibc by its internal entry points (e.g. by the
+///        dynamic loader or thread stacks mapped directly) are not seen.
+///        Counting is disabled by default. Meant only for check builds
+///        (cmake -DJSREMOTE_ALLOCCHECK=ON), never for production binaries.
+
+/// @brief Enables or disables counting.
+/// @param counting counting flag
+void jsalloc_set_counting(bool counting);
+
+/// @brief Checks whether allocations are counted.
+/// @return @c true if counting, otherwise @c false
+bool jsalloc_is_counting();
+
+/// @brief Gets number of allocations counted so far.
+/// @return number of allocations
+uint64_t jsalloc_get_count();
+
+#endif // JSALLOC_H
+
@@ -0,0 +1,36 @@
+#ifndef JSCLOCK_H
+#define JSCLOCK_H
+
+#include <time.h>
+#include <inttypes.h>
+
+/// @brief Gets monotonic time.
+/// @return monotonic time [ns]
+static inline uint64_t jsclock_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// @brief Gets wall clock time.
+/// @return time since epoch [ns]
+static inline uint64_t jsclock_realtime_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/// @brief Converts nanoseconds to timespec.
+/// @param ts timespec to be filled
+/// @param ns time [ns]
+/// @return @p ts
+static inline struct timespec *jsclock_ns2timespec(struct timespec *ts, uint64_t ns)
+{
+	ts->tv_sec  = ns / 1000000000ULL;
+	ts->tv_nsec = ns % 1000000000ULL;
+	return ts;
+}
+
+#endif // JSCLOCK_H
@@ -0,0 +1,402 @@
+#ifndef JSCODEC_H
+#define JSCODEC_H
+
+#include "jsremote.h"
+
+#include <stddef.h>
+#include <string.h>
+
+/// @brief Frame lengths, buffers passed to encoders are checked against them at compile time.
+#define JSCODEC_EVENT_LEN     (sizeof(jsmessage) + sizeof(jsc_event))
+#define JSCODEC_TEVENT_LEN    (sizeof(jsmessage) + sizeof(jsc_event) + sizeof(jsc_trace))
+#define JSCODEC_ALIVE_LEN     (sizeof(jsmessage) + sizeof(jsc_hello))
+#define JSCODEC_KALIVE_LEN    (sizeof(jsmessage) + sizeof(jsc_hello) + sizeof(jsc_keepalive))
+#define JSCODEC_HELLO_LEN     (sizeof(jsmessage) + sizeof(jsc_hello))
+#define JSCODEC_REQUEST_LEN   (sizeof(jsmessage) + sizeof(jsc_request))
+#define JSCODEC_AXES_LEN      (sizeof(jsmessage) + sizeof(jsr_getaxes) + sizeof(jsc_request))
+#define JSCODEC_BUTTONS_LEN   (sizeof(jsmessage) + sizeof(jsr_getbuttons) + sizeof(jsc_request))
+#define JSCODEC_NAME_LEN      (sizeof(jsmessage) + sizeof(jsr_getname) + UINT8_MAX + sizeof(jsc_request))
+#define JSCODEC_SESSION_LEN   (sizeof(jsmessage) + sizeof(jsc_session))
+#define JSCODEC_SUBSCRIBE_LEN (sizeof(jsmessage) + sizeof(jsc_subscribe) + (UINT8_MAX + 1) * sizeof(jsc_rate))
+
+/// @brief Frame validation result.
+enum jscodec_result
+{
+	JSCODEC_OK,          ///< complete frame available
+	JSCODEC_INCOMPLETE,  ///< more data needed
+	JSCODEC_INVALID,     ///< malformed frame, stream can't be resynchronized
+};
+
+/// @brief Gets minimum frame length of command.
+///        Longer frames are accepted, newer peers may append fields.
+/// @param command command
+/// @return minimum frame length, zero for commands unknown to this codec
+static constexpr size_t jscodec_min_length(uint8_t command)
+{
+	return command == JS_COMMAND_EVENT                      ? JSCODEC_EVENT_LEN                          :
+	       command == JS_COMMAND_TEVENT                     ? JSCODEC_TEVENT_LEN                         :
+	       command == JS_COMMAND_EVENTS                     ? sizeof(jsmessage)                          :
+	       command == JS_COMMAND_ALIVE                      ? sizeof(jsmessage)                          :
+	       command == JS_COMMAND_GETAXES                    ? sizeof(jsmessage)                          :
+	       command == JS_COMMAND_GETBUTTONS                 ? sizeof(jsmessage)                          :
+	       command == JS_COMMAND_GETNAME                    ? sizeof(jsmessage)                          :
+	       command == JS_COMMAND_SESSION                    ? JSCODEC_SESSION_LEN                        :
+	       command == JS_COMMAND_ACK                        ? JSCODEC_SESSION_LEN                        :
+	       command == JS_COMMAND_SUBSCRIBE                  ? sizeof(jsmessage) + sizeof(jsc_subscribe)  :
+	       command == (JS_COMMAND_HELLO      | JS_RESPONSE) ? JSCODEC_HELLO_LEN                          :
+	       command == (JS_COMMAND_SESSION    | JS_RESPONSE) ? JSCODEC_SESSION_LEN                        :
+	       command == (JS_COMMAND_GETAXES    | JS_RESPONSE) ? sizeof(jsmessage) + sizeof(jsr_getaxes)    :
+	       command == (JS_COMMAND_GETBUTTONS | JS_RESPONSE) ? sizeof(jsmessage) + sizeof(jsr_getbuttons) :
+	       command == (JS_COMMAND_GETNAME    | JS_RESPONSE) ? sizeof(jsmessage) + sizeof(jsr_getname)    :
+	       0;
+}
+
+static_assert(jscodec_min_length(JS_COMMAND_EVENT) == 11, "event frame layout changed");
+static_assert(JSCODEC_NAME_LEN <= JS_MESSAGE_LENGTH_MAX, "name response exceeds legacy frame limit");
+static_assert(JSCODEC_SUBSCRIBE_LEN <= JS_MESSAGE_LENGTH_MAX, "subscription exceeds legacy frame limit");
+
+/// @brief Locates next complete frame.
+/// @param data received data
+/// @param len number of received bytes
+/// @param max maximum acceptable frame length
+/// @param msg filled with frame if complete
+/// @return validation result
+static inline jscodec_result jscodec_frame(const uint8_t *data, size_t len, size_t max, const jsmessage **msg)
+{
+	if (len < sizeof(jsmessage))
+		return JSCODEC_INCOMPLETE;
+
+	const jsmessage *m = (const jsmessage *) data;
+
+	// zero length would never advance
+	if (m->length < sizeof(jsmessage) || m->length > max)
+		return JSCODEC_INVALID;
+
+	if (len < m->length)
+		return JSCODEC_INCOMPLETE;
+
+	*msg = m;
+
+	return JSCODEC_OK;
+}
+
+/// @brief Frame visitor, dispatch calls the methods of the derived type directly.
+///        Derived types override (hide) only what they handle, the rest is ignored.
+struct jscodec_visitor
+{
+	/// @brief Event, @p trace is zero unless traced.
+	void on_event(const jsc_event *ev, const jsc_trace *trace) {}
+
+	/// @brief Batch of events.
+	void on_events(const jsc_event *evs, size_t cnt) {}
+
+	/// @brief Alive, @p hello is zero for plain alive, @p keepalive is zero unless announced.
+	void on_alive(const jsc_hello *hello, const jsc_keepalive *keepalive) {}
+
+	/// @brief Hello response.
+	void on_hello(const jsc_hello *hello) {}
+
+	/// @brief Metadata request (JS_COMMAND_GETAXES, JS_COMMAND_GETBUTTONS, JS_COMMAND_GETNAME), @p req is zero if untagged.
+	void on_request(uint8_t command, const jsc_request *req) {}
+
+	/// @brief Axes response, @p req is zero if untagged.
+	void on_axes(uint8_t number, const jsc_request *req) {}
+
+	/// @brief Buttons response, @p req is zero if untagged.
+	void on_buttons(uint8_t number, const jsc_request *req) {}
+
+	/// @brief Name response, @p req is zero if untagged.
+	void on_name(const char *name, size_t len, const jsc_request *req) {}
+
+	/// @brief Session resumption request.
+	void on_session(const jsc_session *session) {}
+
+	/// @brief Session resumption response.
+	void on_session_reply(const jsc_session *session) {}
+
+	/// @brief Session acknowledgement.
+	void on_ack(const jsc_session *session) {}
+
+	/// @brief Subscription filter with @p cnt axis rate limits.
+	void on_subscribe(const jsc_subscribe *sub, const jsc_rate *rates, size_t cnt) {}
+
+	/// @brief Command unknown to this codec.
+	void on_unknown(const jsmessage *msg) {}
+};
+
+/// @brief Validates frame payload and calls the matching visitor method.
+/// @param v visitor
+/// @param msg complete frame located by jscodec_frame
+/// @return @c true if frame was valid, otherwise @c false
+template <typename V>
+static inline bool jscodec_dispatch(V &v, const jsmessage *msg)
+{
+	size_t         len  = msg->length;
+	const uint8_t *data = msg->data;
+	size_t         min  = jscodec_min_length(msg->command);
+
+	if (!min) {
+		v.on_unknown(msg);
+		return true;
+	}
+
+	if (len < min)
+		return false;
+
+	switch (msg->command) {
+
+		case JS_COMMAND_EVENT:
+			v.on_event((const jsc_event *) data, 0);
+			return true;
+
+		case JS_COMMAND_TEVENT:
+			v.on_event((const jsc_event *) data, (const jsc_trace *) (data + sizeof(jsc_event)));
+			return true;
+
+		case JS_COMMAND_EVENTS:
+			if ((len - sizeof(jsmessage)) % sizeof(jsc_event))
+				return false;
+			v.on_events((const jsc_event *) data, (len - sizeof(jsmessage)) / sizeof(jsc_event));
+			return true;
+
+		case JS_COMMAND_ALIVE:
+			v.on_alive(len >= JSCODEC_ALIVE_LEN ? (const jsc_hello *) data : 0,
+			           len >= JSCODEC_KALIVE_LEN ? (const jsc_keepalive *) (data + sizeof(jsc_hello)) : 0);
+			return true;
+
+		case JS_COMMAND_GETAXES:
+		case JS_COMMAND_GETBUTTONS:
+		case JS_COMMAND_GETNAME:
+			v.on_request(msg->command, len >= JSCODEC_REQUEST_LEN ? (const jsc_request *) data : 0);
+			return true;
+
+		case JS_COMMAND_HELLO | JS_RESPONSE:
+			v.on_hello((const jsc_hello *) data);
+			return true;
+
+		case JS_COMMAND_SESSION:
+			v.on_session((const jsc_session *) data);
+			return true;
+
+		case JS_COMMAND_SESSION | JS_RESPONSE:
+			v.on_session_reply((const jsc_session *) data);
+			return true;
+
+		case JS_COMMAND_ACK:
+			v.on_ack((const jsc_session *) data);
+			return true;
+
+		case JS_COMMAND_SUBSCRIBE:
+			if ((len - min) % sizeof(jsc_rate))
+				return false;
+			v.on_subscribe((const jsc_subscribe *) data, (const jsc_rate *) (data + sizeof(jsc_subscribe)), (len - min) / sizeof(jsc_rate));
+			return true;
+
+		case JS_COMMAND_GETAXES | JS_RESPONSE:
+			v.on_axes(((const jsr_getaxes *) data)->number,
+			          len >= min + sizeof(jsc_request) ? (const jsc_request *) (data + sizeof(jsr_getaxes)) : 0);
+			return true;
+
+		case JS_COMMAND_GETBUTTONS | JS_RESPONSE:
+			v.on_buttons(((const jsr_getbuttons *) data)->number,
+			             len >= min + sizeof(jsc_request) ? (const jsc_request *) (data + sizeof(jsr_getbuttons)) : 0);
+			return true;
+
+		case JS_COMMAND_GETNAME | JS_RESPONSE: {
+			const jsr_getname *name = (const jsr_getname *) data;
+
+			if (len < min + name->length)
+				return false;
+
+			v.on_name((const char *) name->name, name->length,
+			          len >= min + name->length + sizeof(jsc_request) ? (const jsc_request *) (name->name + name->length) : 0);
+			return true;
+		}
+	}
+
+	v.on_unknown(msg);
+	return true;
+}
+
+/// @brief Writes frame header.
+static inline size_t jscodec_header(uint8_t *buff, uint8_t command, size_t len)
+{
+	jsmessage *msg = (jsmessage *) buff;
+
+	msg->length  = len;
+	msg->command = command;
+
+	return len;
+}
+
+/// @brief Encodes event, traced one if @p trace is given.
+/// @return frame length
+template <size_t N>
+static inline size_t jscodec_put_event(uint8_t (&buff)[N], const jsc_event *ev, const jsc_trace *trace)
+{
+	static_assert(N >= JSCODEC_TEVENT_LEN, "buffer too small for event");
+
+	memcpy(buff + sizeof(jsmessage), ev, sizeof(jsc_event));
+
+	if (!trace)
+		return jscodec_header(buff, JS_COMMAND_EVENT, JSCODEC_EVENT_LEN);
+
+	memcpy(buff + JSCODEC_EVENT_LEN, trace, sizeof(jsc_trace));
+
+	return jscodec_header(buff, JS_COMMAND_TEVENT, JSCODEC_TEVENT_LEN);
+}
+
+/// @brief Appends event to batch frame (JS_COMMAND_EVENTS), frame is started if @p len is zero.
+/// @param buff frame start, with room for one more event behind @p len
+/// @param len current frame length, zero if there is no frame yet
+/// @return frame length
+static inline size_t jscodec_put_events(uint8_t *buff, size_t len, const jsc_event *ev)
+{
+	if (!len)
+		len = sizeof(jsmessage);
+
+	memcpy(buff + len, ev, sizeof(jsc_event));
+
+	return jscodec_header(buff, JS_COMMAND_EVENTS, len + sizeof(jsc_event));
+}
+
+/// @brief Encodes alive, carrying capabilities if @p hello is given.
+/// @return frame length
+template <size_t N>
+static inline size_t jscodec_put_alive(uint8_t (&buff)[N], const jsc_hello *hello)
+{
+	static_assert(N >= JSCODEC_ALIVE_LEN, "buffer too small for alive");
+
+	if (!hello)
+		return jscodec_header(buff, JS_COMMAND_ALIVE, sizeof(jsmessage));
+
+	memcpy(buff + sizeof(jsmessage), hello, sizeof(jsc_hello));
+
+	return jscodec_header(buff, JS_COMMAND_ALIVE, JSCODEC_ALIVE_LEN);
+}
+
+/// @brief Encodes alive carrying capabilities and keepalive period.
+/// @return frame length
+template <size_t N>
+static inline size_t jscodec_put_alive(uint8_t (&buff)[N], const jsc_hello *hello, const jsc_keepalive *keepalive)
+{
+	static_assert(N >= JSCODEC_KALIVE_LEN, "buffer too small for alive");
+
+	memcpy(buff + sizeof(jsmessage), hello, sizeof(jsc_hello));
+	memcpy(buff + JSCODEC_ALIVE_LEN, keepalive, sizeof(jsc_keepalive));
+
+	return jscodec_header(buff, JS_COMMAND_ALIVE, JSCODEC_KALIVE_LEN);
+}
+
+/// @brief Encodes hello response.
+/// @return frame length
+template <size_t N>
+static inline size_t jscodec_put_hello(uint8_t (&buff)[N], const jsc_hello *hello)
+{
+	static_assert(N >= JSCODEC_HELLO_LEN, "buffer too small for hello");
+
+	memcpy(buff + sizeof(jsmessage), hello, sizeof(jsc_hello));
+
+	return jscodec_header(buff, JS_COMMAND_HELLO | JS_RESPONSE, JSCODEC_HELLO_LEN);
+}
+
+/// @brief Encodes session frame (JS_COMMAND_SESSION, its response or JS_COMMAND_ACK).
+/// @return frame length
+template <size_t N>
+static inline size_t jscodec_put_session(uint8_t (&buff)[N], uint8_t command, const jsc_session *session)
+{
+	static_assert(N >= JSCODEC_SESSION_LEN, "buffer too small for session");
+
+	memcpy(buff + sizeof(jsmessage), session, sizeof(jsc_session));
+
+	return jscodec_header(buff, command, JSCODEC_SESSION_LEN);
+}
+
+/// @brief Encodes subscription filter. Rate limits beyond one per axis are dropped.
+/// @return frame length
+template <size_t N>
+static inline size_t jscodec_put_subscribe(uint8_t (&buff)[N], const jsc_subscribe *sub, const jsc_rate *rates, size_t cnt)
+{
+	static_assert(N >= JSCODEC_SUBSCRIBE_LEN, "buffer too small for subscription");
+
+	if (cnt > UINT8_MAX + 1)
+		cnt = UINT8_MAX + 1;
+
+	memcpy(buff + sizeof(jsmessage), sub, sizeof(jsc_subscribe));
+	memcpy(buff + sizeof(jsmessage) + sizeof(jsc_subscribe), rates, cnt * sizeof(jsc_rate));
+
+	return jscodec_header(buff, JS_COMMAND_SUBSCRIBE, sizeof(jsmessage) + sizeof(jsc_subscribe) + cnt * sizeof(jsc_rate));
+}
+
+/// @brief Encodes metadata request, tagged if @p req is given.
+/// @return frame length
+template <size_t N>
+static inline size_t jscodec_put_request(uint8_t (&buff)[N], uint8_t command, const jsc_request *req)
+{
+	static_assert(N >= JSCODEC_REQUEST_LEN, "buffer too small for request");
+
+	if (!req)
+		return jscodec_header(buff, command, sizeof(jsmessage));
+
+	memcpy(buff + sizeof(jsmessage), req, sizeof(jsc_request));
+
+	return jscodec_header(buff, command, JSCODEC_REQUEST_LEN);
+}
+
+/// @brief Appends echoed request id to response payload of @p len bytes.
+static inline size_t jscodec_put_response(uint8_t *buff, uint8_t command, size_t len, const jsc_request *req)
+{
+	len += sizeof(jsmessage);
+
+	if (req) {
+		memcpy(buff + len, req, sizeof(jsc_request));
+		len += sizeof(jsc_request);
+	}
+
+	return jscodec_header(buff, command | JS_RESPONSE, len);
+}
+
+/// @brief Encodes axes response, tagged if @p req is given.
+/// @return frame length
+template <size_t N>
+static inline size_t jscodec_put_axes(uint8_t (&buff)[N], uint8_t number, const jsc_request *req)
+{
+	static_assert(N >= JSCODEC_AXES_LEN, "buffer too small for axes response");
+
+	((jsr_getaxes *) (buff + sizeof(jsmessage)))->number = number;
+
+	return jscodec_put_response(buff, JS_COMMAND_GETAXES, sizeof(jsr_getaxes), req);
+}
+
+/// @brief Encodes buttons response, tagged if @p req is given.
+/// @return frame length
+template <size_t N>
+static inline size_t jscodec_put_buttons(uint8_t (&buff)[N], uint8_t number, const jsc_request *req)
+{
+	static_assert(N >= JSCODEC_BUTTONS_LEN, "buffer too small for buttons response");
+
+	((jsr_getbuttons *) (buff + sizeof(jsmessage)))->number = number;
+
+	return jscodec_put_response(buff, JS_COMMAND_GETBUTTONS, sizeof(jsr_getbuttons), req);
+}
+
+/// @brief Encodes name response, tagged if @p req is given. Name is truncated to 255 bytes.
+/// @return frame length
+template <size_t N>
+static inline size_t jscodec_put_name(uint8_t (&buff)[N], const char *name, size_t len, const jsc_request *req)
+{
+	static_assert(N >= JSCODEC_NAME_LEN, "buffer too small for name response");
+
+	jsr_getname *data = (jsr_getname *) (buff + sizeof(jsmessage));
+
+	if (len > UINT8_MAX)
+		len = UINT8_MAX;
+
+	data->length = len;
+	memcpy(data->name, name, len);
+
+	return jscodec_put_response(buff, JS_COMMAND_GETNAME, sizeof(jsr_getname) + len, req);
+}
+
+#endif // JSCODEC_H
+
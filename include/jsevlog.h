@@ -0,0 +1,160 @@
+#ifndef JSEVLOG_H
+#define JSEVLOG_H
+
+#include "jsremote.h"
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+/// @brief Magic of event log file.
+#define JSEVLOG_MAGIC        "JSEVLOG1"
+
+/// @brief Number of events per block.
+#define JSEVLOG_BLOCK_EVENTS 4096u
+
+/// @brief Size of file and block header, one page each.
+#define JSEVLOG_HEADER_LEN   4096u
+
+/// @brief Size of block, header followed by columns.
+#define JSEVLOG_BLOCK_LEN    (JSEVLOG_HEADER_LEN + JSEVLOG_BLOCK_EVENTS * (sizeof(uint64_t) + sizeof(int16_t) + 2 * sizeof(uint8_t)))
+
+/// @brief Event log file header.
+struct jsevlog_file
+{
+	char     magic[8];
+	uint32_t block_events;
+	uint32_t block_len;
+};
+
+/// @brief Event log block header, the block index.
+///        Columns follow the header page: time, value, type, number.
+struct jsevlog_block
+{
+	uint64_t min_ns;  ///< earliest event time in block
+	uint64_t max_ns;  ///< latest event time in block
+	uint32_t cnt;     ///< number of events in block, stored last so readers see complete rows
+};
+
+/// @brief Visitor of events returned by query.
+struct jsevlog_visitor
+{
+	virtual ~jsevlog_visitor() = default;
+
+	/// @brief Called for every event in queried range, in log order.
+	/// @param time_ns wall clock time of reception [ns]
+	/// @param ev event, time field is not stored and is zero
+	virtual void on_event(uint64_t time_ns, const jsc_event *ev) = 0;
+};
+
+/// @brief Append-only columnar event log.
+///        Every stream (one per peer) is a file of fixed size blocks, each holding
+///        time, value, type and number columns of JSEVLOG_BLOCK_EVENTS events
+///        behind a header with min/max time, so range queries map and scan only
+///        blocks overlapping the range. Callers just enqueue events into a lock-free
+///        single producer queue, files are opened, grown, mapped and written
+///        in batches by a background thread.
+class jsevlog
+{
+private:
+	/// @brief Queued event.
+	struct record
+	{
+		uint64_t  time_ns;
+		jsc_event ev;
+		uint32_t  stream;
+	};
+
+	/// @brief Stream life cycle, FREE -> OPENING by caller, OPENING -> OPEN by writer,
+	///        OPEN -> CLOSING by caller, CLOSING -> FREE by writer.
+	enum state
+	{
+		STATE_FREE,
+		STATE_OPENING,
+		STATE_OPEN,
+		STATE_CLOSING,
+	};
+
+	/// @brief Stream, file fields are owned by writer thread.
+	struct stream
+	{
+		std::atomic<uint8_t> state;
+		std::string          path;
+		bool                 opened;
+		bool                 closing;
+		int                  fd;
+		uint8_t             *block;
+		uint64_t             block_off;
+	};
+
+	std::string           dir;
+	jsevlog::record      *queue;
+	size_t                queue_mask;
+	std::atomic<size_t>   queue_head;
+	std::atomic<size_t>   queue_tail;
+	std::atomic<uint64_t> dropped;
+	jsevlog::stream      *streams;
+	size_t                streams_len;
+	std::atomic<bool>     running;
+	std::thread           writer;
+
+public:
+	/// @brief Constructor.
+	jsevlog();
+
+	/// @brief Destructor.
+	~jsevlog();
+
+	/// @brief Initializes log and starts writer thread.
+	/// @param dir directory of stream files
+	/// @param streams_len maximal number of open streams
+	/// @param queue_len queue capacity in events, rounded up to power of two
+	/// @return @c true if initialization was successful, otherwise @c false
+	bool init(const std::string &dir, size_t streams_len, size_t queue_len);
+
+	/// @brief Writes out queued events, closes streams and stops writer thread.
+	void cleanup();
+
+	/// @brief Opens stream, appending to its file if it exists.
+	/// @param name file name in log directory
+	/// @return stream id or -1 if there is no free stream
+	int open(const std::string &name);
+
+	/// @brief Closes stream once its queued events are written.
+	/// @param id stream id
+	void close(int id);
+
+	/// @brief Enqueues event. Must be called from one thread only (the epoller loop).
+	/// @param id stream id
+	/// @param ev event
+	/// @param time_ns wall clock time of reception [ns]
+	/// @return @c true if enqueued, @c false if queue is full and event was dropped
+	bool append(int id, const jsc_event *ev, uint64_t time_ns);
+
+	/// @brief Gets number of events dropped because the queue was full.
+	/// @return number of events
+	uint64_t get_dropped() const;
+
+	/// @brief Reads events of a stream file in time range.
+	///        Blocks outside the range are skipped by their header, untouched columns are not read.
+	/// @param path stream file path
+	/// @param from_ns range start, inclusive [ns]
+	/// @param to_ns range end, inclusive [ns]
+	/// @param v visitor
+	/// @return @c true if file was read, otherwise @c false
+	static bool query(const std::string &path, uint64_t from_ns, uint64_t to_ns, jsevlog_visitor &v);
+
+private:
+	void run();
+	bool drain();
+	void store(const jsevlog::record *rec);
+	bool stream_open(jsevlog::stream *st);
+	bool stream_map(jsevlog::stream *st, uint64_t off);
+	void stream_close(jsevlog::stream *st);
+};
+
+#endif // JSEVLOG_H
+
@@ -0,0 +1,157 @@
+#ifndef JSLINK_H
+#define JSLINK_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/// @brief Link statistics.
+struct jslink_stats
+{
+	uint64_t opens;          ///< joystick opens
+	uint64_t connects;       ///< connection attempts
+	uint64_t connected;      ///< successful connections
+	uint64_t socket_losses;  ///< connections (or attempts) lost
+	uint64_t device_losses;  ///< joystick losses
+	uint64_t alives;         ///< alive packets sent on idle link
+	uint64_t down_ns;        ///< total time with joystick open but not connected [ns]
+	uint64_t down_max_ns;    ///< longest such time [ns]
+};
+
+/// @brief Link supervisor, the reconnect state machine of jsremote.
+///        Waits for joystick device, then keeps connection to server, sharing one
+///        timer for device polling and reconnect delay. Alive packets have their own
+///        timer and go out only after the link was idle for the alive period. It does no
+///        i/o on its own, clock, timer, device and socket are reached through
+///        jslink::env, so the same state machine runs on epoller in jsremote and
+///        in virtual time in jssim.
+class jslink
+{
+public:
+	/// @brief Link state.
+	enum state
+	{
+		JOYSTICK_WAIT,  ///< device is polled periodically
+		SERVER_WAIT,    ///< device open, connection attempt is delayed
+		CONNECTING,     ///< connection attempt in progress
+		CONNECTED,      ///< connected, alive packets are sent on idle link
+	};
+
+	/// @brief Environment of link.
+	///        Methods returning bool report failure by @c false.
+	class env
+	{
+	public:
+		/// @brief Destructor.
+		virtual ~env() = default;
+
+		/// @brief Gets monotonic time.
+		/// @return time [ns]
+		virtual uint64_t now_ns() = 0;
+
+		/// @brief Arms link timer, jslink::timeout is called when it expires.
+		/// @param ns timeout [ns]
+		/// @param periodic @c true to expire every @p ns, @c false to expire once
+		virtual bool timer_arm(uint64_t ns, bool periodic) = 0;
+
+		/// @brief Disarms link timer.
+		virtual void timer_disarm() = 0;
+
+		/// @brief Arms keepalive timer (one-shot), jslink::alive_timeout is called when it expires.
+		/// @param ns timeout [ns]
+		virtual bool alive_arm(uint64_t ns) = 0;
+
+		/// @brief Disarms keepalive timer.
+		virtual void alive_disarm() = 0;
+
+		/// @brief Checks whether device is present, without opening it.
+		virtual bool joystick_present() = 0;
+
+		/// @brief Opens device, its failures are reported by jslink::joystick_lost.
+		virtual bool joystick_open() = 0;
+
+		/// @brief Closes device, does nothing if not open.
+		virtual void joystick_close() = 0;
+
+		/// @brief Starts connecting, completion is reported by jslink::connected.
+		virtual bool socket_connect() = 0;
+
+		/// @brief Sets up connected socket (reception, hello etc.).
+		virtual bool socket_setup() = 0;
+
+		/// @brief Closes socket, does nothing if not open.
+		virtual void socket_close() = 0;
+
+		/// @brief Sends alive packet.
+		virtual void socket_alive() = 0;
+	};
+
+private:
+	jslink::env    *e;
+	jslink::state   st;
+	jslink_stats    stats;
+	uint64_t        joystick_period_ns;
+	uint64_t        server_period_ns;
+	uint64_t        alive_period_ns;
+	uint64_t        alive_tx_ns;
+	uint64_t        down_since;
+
+public:
+	/// @brief Constructor.
+	jslink();
+
+	/// @brief Initializes link, nothing happens until started.
+	/// @param e environment
+	/// @param joystick_period_ms device polling period [ms]
+	/// @param server_period_ms delay of connection attempt [ms]
+	/// @param alive_period_ms idle time after which alive packet is sent [ms], zero disables them
+	void init(jslink::env *e, uint32_t joystick_period_ms, uint32_t server_period_ms, uint32_t alive_period_ms);
+
+	/// @brief Starts polling device.
+	/// @return @c true if successful, @c false if timer failed
+	bool start();
+
+	/// @brief Closes socket and device and stops timer.
+	void stop();
+
+	/// @brief To be called when link timer expires.
+	/// @return @c true if successful, @c false on fatal failure
+	bool timeout();
+
+	/// @brief To be called when connection attempt completes.
+	/// @param ok @c true if connected, @c false if attempt failed
+	/// @return @c true if successful, @c false on fatal failure
+	bool connected(bool ok);
+
+	/// @brief To be called when keepalive timer expires.
+	/// @return @c true if successful, @c false on fatal failure
+	bool alive_timeout();
+
+	/// @brief To be called whenever anything was written to socket, it postpones alive packet.
+	///        Only stamps the time, keepalive timer is moved once it expires.
+	void transmitted();
+
+	/// @brief To be called when socket fails or gets closed by server.
+	///        Socket is closed and connection is retried after delay.
+	/// @return @c true if successful, @c false on fatal failure
+	bool socket_lost();
+
+	/// @brief To be called when device fails or disappears.
+	///        Socket and device are closed and device is polled again.
+	/// @return @c true if successful, @c false on fatal failure
+	bool joystick_lost();
+
+	/// @brief Gets state.
+	/// @return state
+	jslink::state get_state() const;
+
+	/// @brief Gets statistics.
+	/// @return statistics
+	const jslink_stats &get_stats() const;
+
+private:
+	bool monitor_joystick();
+	bool monitor_server();
+	void down_end();
+};
+
+#endif // JSLINK_H
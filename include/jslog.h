@@ -0,0 +1,50 @@
+#ifndef JSLOG_H
+#define JSLOG_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/// @brief Maximal length of one log line, longer ones are truncated.
+#define JSLOG_LINE_LEN 240u
+
+/// @brief Log level, messages above the set level are discarded before formatting.
+enum jslog_level
+{
+	JSLOG_ERROR,  ///< failures, written to stderr
+	JSLOG_WARN,   ///< recoverable problems, written to stderr
+	JSLOG_INFO,   ///< connection and device life cycle
+	JSLOG_EVENT,  ///< every event, off by default
+};
+
+/// @brief Starts asynchronous logging.
+///        Lines are formatted by the calling thread into a lock-free single producer ring
+///        and written out by a background thread, so the caller never waits for the terminal.
+///        Lines which don't fit into a full ring are dropped and counted.
+///        Until started (and after cleanup), lines are written synchronously.
+/// @param slots ring capacity in lines, rounded up to power of two
+/// @return @c true if logging thread was started, otherwise @c false
+bool jslog_init(size_t slots);
+
+/// @brief Writes out queued lines and stops logging thread.
+void jslog_cleanup();
+
+/// @brief Sets log level.
+/// @param level highest level which gets logged
+void jslog_set_level(jslog_level level);
+
+/// @brief Checks whether level gets logged, for skipping preparation of expensive messages.
+/// @param level level
+/// @return @c true if level gets logged, otherwise @c false
+bool jslog_enabled(jslog_level level);
+
+/// @brief Logs one line. Must be called from one thread only (the epoller loop).
+/// @param level level
+/// @param fmt printf format, without trailing newline
+void jslog(jslog_level level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/// @brief Gets number of lines dropped because the ring was full.
+/// @return number of lines
+uint64_t jslog_dropped();
+
+#endif // JSLOG_H
+
@@ -0,0 +1,69 @@
+#ifndef JSLOWLAT_H
+#define JSLOWLAT_H
+
+#include <epoller/fdepoller.h>
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/// @brief Low-latency runtime settings.
+///        Parsed from comma separated suboptions, e.g. "cpu=2,fifo=50,spin=200,busypoll=50".
+struct jslowlat_cfg
+{
+	int      cpu;          ///< core to pin the loop to, -1 leaves affinity untouched
+	int      fifo;         ///< SCHED_FIFO priority, zero leaves scheduling policy untouched
+	uint32_t spin_us;      ///< busy-poll budget of epoller loop before blocking [us], zero disables spinning
+	uint32_t busypoll_us;  ///< SO_BUSY_POLL of sockets [us], zero leaves sockets untouched
+};
+
+/// @brief Low-latency runtime mode.
+///        Pins the calling thread, switches it to SCHED_FIFO and keeps epoller
+///        loop spinning for a while after each wakeup instead of going to sleep.
+///        Spinning is done by an always readable eventfd whose handler polls
+///        the epoller descriptor until it has other ready events or the budget runs out,
+///        then it blocks on the epoller descriptor just like the loop would.
+class jslowlat : private fdepoller
+{
+private:
+	jslowlat_cfg cfg;
+	int          efd;
+	uint64_t     spins;
+	uint64_t     hits;
+	uint64_t     blocks;
+
+public:
+	/// @brief Constructor.
+	/// @param epoller parent epoller
+	jslowlat(struct epoller *epoller);
+
+	/// @brief Destructor.
+	~jslowlat();
+
+	/// @brief Parses settings.
+	/// @param cfg settings to be filled, unspecified ones are set to defaults
+	/// @param str comma separated suboptions (cpu, fifo, spin, busypoll), empty for defaults
+	/// @return @c true if parsing was successful, otherwise @c false
+	static bool parse(jslowlat_cfg *cfg, const char *str);
+
+	/// @brief Applies settings to the calling thread and starts spinning.
+	/// @param cfg settings
+	/// @return @c true if initialization was successful, otherwise @c false
+	bool init(const jslowlat_cfg *cfg);
+
+	/// @brief Stops spinning. Affinity and scheduling policy are kept.
+	void cleanup();
+
+	/// @brief Applies socket settings.
+	/// @param fd socket file descriptor
+	/// @return @c true if successful, otherwise @c false
+	bool setup_socket(int fd);
+
+	/// @brief Prints spinning statistics.
+	void print_stats();
+
+private:
+	virtual int in();
+};
+
+#endif // JSLOWLAT_H
+
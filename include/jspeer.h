@@ -2,12 +2,54 @@
 #define JSPEER_H
 
 #include "jsremote.h"
+#include "jscodec.h"
+#include "jsring.h"
+#include "jspredict.h"
+#include "jstrace.h"
+#include "jsshape.h"
+#include "jswheel.h"
+#include "jsevlog.h"
+#include "jsshm.h"
+#ifdef JSREMOTE_IO_URING
+#include "jsuring.h"
+#endif
 #include <epoller/sockepoller.h>
+#include <epoller/timepoller.h>
 
 #include <string>
 
+/// @brief Maximum number of outstanding tagged requests per peer.
+#define JSPEER_REQUESTS_MAX 32u
+
+/// @brief Default buffer lengths of connection, see jspeer::set_buffers.
+#define JSPEER_RX_BUFF_LEN  JS_MESSAGE_LENGTH_MAX
+#define JSPEER_TX_BUFF_LEN  JS_MESSAGE_LENGTH_MAX
+#define JSPEER_RX_RING_LEN  (64u * 1024u)
+
+/// @brief Number of announced keepalive periods without any reception after which peer is idle.
+#define JSPEER_KEEPALIVE_MISSES 3u
+
+/// @brief Number of tracked axes and buttons (event number is 8-bit).
+#define JSPEER_AXES_MAX     256u
+#define JSPEER_BUTTONS_MAX  256u
+
+/// @brief Session is forgotten if its remote doesn't come back within this time [ms].
+#define JSPEER_SESSION_TTL_MS 30000u
+
+/// @brief Session events are acknowledged at least after this number of events.
+#define JSPEER_ACK_EVENTS     64u
+
+/// @brief Cached metadata flags.
+#define JSPEER_META_AXES    0x01
+#define JSPEER_META_BUTTONS 0x02
+#define JSPEER_META_NAME    0x04
+#define JSPEER_META_ALL     (JSPEER_META_AXES | JSPEER_META_BUTTONS | JSPEER_META_NAME)
+
 /// @brief Receiver for jsremote client application.
 class jspeer : private sockepoller
+#ifdef JSREMOTE_IO_URING
+             , private jsuring::handler
+#endif
 {
 public:
 	/// @brief Receiver for jspeer instance.
@@ -48,10 +90,149 @@ public:
 		/// @param jsp jspeer instance
 		/// @param name joystick name
 		virtual void name(jspeer *jsp, const std::string &name) = 0;
+
+		/// @brief Called if response to tagged 'getaxes' command was received.
+		///        Forwards to jspeer::receiver::axes by default.
+		/// @param jsp jspeer instance
+		/// @param id request id
+		/// @param axes number of joystick axes
+		virtual void reply_axes(jspeer *jsp, uint16_t id, uint8_t axes) { this->axes(jsp, axes); }
+
+		/// @brief Called if response to tagged 'getbuttons' command was received.
+		///        Forwards to jspeer::receiver::buttons by default.
+		/// @param jsp jspeer instance
+		/// @param id request id
+		/// @param buttons number of joystick buttons
+		virtual void reply_buttons(jspeer *jsp, uint16_t id, uint8_t buttons) { this->buttons(jsp, buttons); }
+
+		/// @brief Called if response to tagged 'getname' command was received.
+		///        Forwards to jspeer::receiver::name by default.
+		/// @param jsp jspeer instance
+		/// @param id request id
+		/// @param name joystick name
+		virtual void reply_name(jspeer *jsp, uint16_t id, const std::string &name) { this->name(jsp, name); }
+
+		/// @brief Called if protocol was negotiated with remote peer.
+		///        Peers which never send hello stay on legacy protocol (version 0).
+		/// @param jsp jspeer instance
+		/// @param proto negotiated protocol
+		virtual void hello(jspeer *jsp, const jsc_hello *proto) {}
+
+		/// @brief Called if remote opened or resumed session.
+		///        On resumption axis and button state is kept and only changes since
+		///        the last received event are delivered, otherwise full state follows.
+		/// @param jsp jspeer instance
+		/// @param id session id
+		/// @param resumed @c true if session was resumed
+		virtual void session(jspeer *jsp, uint32_t id, bool resumed) {}
+
+		/// @brief Called if tagged request was not answered in time.
+		///        Late response to such request is dropped.
+		/// @param jsp jspeer instance
+		/// @param id request id
+		/// @param command request command
+		virtual void timeout(jspeer *jsp, uint16_t id, uint8_t command) {}
+
+		/// @brief Called if nothing was received from remote peer for idle timeout.
+		///        Default evicts the peer the same way as an error does.
+		/// @param jsp jspeer instance
+		virtual void idle(jspeer *jsp) { error(jsp); }
 	};
 
 private:
+	/// @brief Request timeout timer.
+	class timer : public timepoller
+	{
+	public:
+		jspeer *owner;
+		timer(struct epoller *epoller, jspeer *owner) : timepoller(epoller), owner(owner) {}
+	};
+
+	/// @brief Idle timeout entry of shared timer wheel.
+	class idler : public jswheel::entry
+	{
+	public:
+		jspeer *owner;
+		idler(jspeer *owner) : owner(owner) {}
+		void expired();
+	};
+
+	/// @brief Frame decoder.
+	struct decoder : public jscodec_visitor
+	{
+		jspeer  *jsp;
+		uint64_t decode_ns;
+
+		decoder(jspeer *jsp) : jsp(jsp), decode_ns(0) {}
+
+		void on_event(const jsc_event *ev, const jsc_trace *trace);
+		void on_events(const jsc_event *evs, size_t cnt);
+		void on_alive(const jsc_hello *hello, const jsc_keepalive *keepalive);
+		void on_axes(uint8_t number, const jsc_request *req);
+		void on_buttons(uint8_t number, const jsc_request *req);
+		void on_name(const char *name, size_t len, const jsc_request *req);
+		void on_session(const jsc_session *session);
+		void on_unknown(const jsmessage *msg);
+	};
+
+	/// @brief Outstanding tagged request.
+	struct request
+	{
+		uint16_t id;
+		uint8_t  command;
+		uint64_t sent;
+		uint64_t deadline;
+	};
+
 	jspeer::receiver *rcvr;
+	jsc_hello         proto;
+	jsring            rxring;
+	size_t            rx_buff_len;
+	size_t            tx_buff_len;
+	size_t            rx_ring_len;
+	bool              rx_ring_resize;
+	jspeer::timer     tmr;
+	jspeer::request   requests[JSPEER_REQUESTS_MAX];
+	size_t            requests_cnt;
+	uint16_t          request_id;
+	uint64_t          rtt;
+	uint64_t          rx_bytes;
+	int16_t           axes[JSPEER_AXES_MAX];
+	uint8_t           buttons[JSPEER_BUTTONS_MAX];
+	uint32_t          session_id;
+	uint32_t          session_seq;
+	uint32_t          session_acked;
+	uint32_t          parked_id;
+	uint32_t          parked_seq;
+	uint64_t          parked_ns;
+	int16_t           parked_axes[JSPEER_AXES_MAX];
+	uint8_t           parked_buttons[JSPEER_BUTTONS_MAX];
+	uint8_t           meta;
+	uint8_t           meta_axes;
+	uint8_t           meta_buttons;
+	std::string       meta_name;
+	jspredictor      *predictor;
+	jstrace          *tracer;
+	const jsshaper   *shaper;
+	jswheel          *wheel;
+	jspeer::idler     idle;
+	uint32_t          idle_ms;
+	uint32_t          idle_cfg_ms;
+	uint64_t          idle_rx_tick;
+	uint16_t          keepalive_ms;
+	jsevlog          *evlog;
+	std::string       evlog_name;
+	int               evlog_stream;
+	jsshm            *shm;
+	size_t            shm_slot;
+	jsc_subscribe     subscription;
+	jsc_rate          sub_rates[JSPEER_AXES_MAX];
+	size_t            sub_rates_cnt;
+	bool              subscribed;
+#ifdef JSREMOTE_IO_URING
+	jsuring          *uring;
+	bool              uring_rx_armed;
+#endif
 
 public:
 	/// @brief Constructor.
@@ -69,6 +250,15 @@ public:
 	/// @return @c true if initialization was successful, otherwise @c false
 	bool init(int fd);
 
+#ifdef JSREMOTE_IO_URING
+	/// @brief Initializes jspeer with reception through io_uring.
+	///        Socket is read by multishot receives of @p uring instead of the epoller.
+	/// @param fd peer file descriptor
+	/// @param uring io_uring backend shared by peers, must outlive the peer
+	/// @return @c true if initialization was successful, otherwise @c false
+	bool init(int fd, jsuring *uring);
+#endif
+
 	/// @brief Cleanups jspeer.
 	void cleanup();
 
@@ -76,6 +266,11 @@ public:
 	/// @return @c true if jspeer is initialized, otherwise @c false
 	bool is_initialized();
 
+	/// @brief Checks if io_uring reception of the previous connection is still completing.
+	///        Peer can't be initialized again until the receive is over.
+	/// @return @c true if jspeer is draining, otherwise @c false
+	bool is_draining();
+
 	/// @brief Gets peer file descriptor.
 	/// @return peer file descriptor or -1 if peer is not initialized
 	int get_fd();
@@ -99,13 +294,190 @@ public:
 	/// @return @c true if command was sent successfully, otherwise @c false
 	bool get_name();
 
+	/// @brief Sends tagged metadata commands to remote peer in one write.
+	///        Responses are received per jspeer::receiver::reply_axes,
+	///        jspeer::receiver::reply_buttons and jspeer::receiver::reply_name,
+	///        unanswered requests per jspeer::receiver::timeout.
+	/// @param commands array of commands (JS_COMMAND_GETAXES, JS_COMMAND_GETBUTTONS, JS_COMMAND_GETNAME)
+	/// @param ids array filled with assigned request ids, may be zero
+	/// @param n number of commands
+	/// @param timeout_ms response timeout [ms], zero means no timeout
+	/// @return @c true if commands were sent successfully, otherwise @c false
+	bool query(const uint8_t *commands, uint16_t *ids, size_t n, uint32_t timeout_ms);
+
+	/// @brief Sends tagged 'getaxes' command to remote peer.
+	/// @param id filled with assigned request id, may be zero
+	/// @param timeout_ms response timeout [ms], zero means no timeout
+	/// @return @c true if command was sent successfully, otherwise @c false
+	bool get_axes(uint16_t *id, uint32_t timeout_ms);
+
+	/// @brief Sends tagged 'getbuttons' command to remote peer.
+	/// @param id filled with assigned request id, may be zero
+	/// @param timeout_ms response timeout [ms], zero means no timeout
+	/// @return @c true if command was sent successfully, otherwise @c false
+	bool get_buttons(uint16_t *id, uint32_t timeout_ms);
+
+	/// @brief Sends tagged 'getname' command to remote peer.
+	/// @param id filled with assigned request id, may be zero
+	/// @param timeout_ms response timeout [ms], zero means no timeout
+	/// @return @c true if command was sent successfully, otherwise @c false
+	bool get_name(uint16_t *id, uint32_t timeout_ms);
+
+	/// @brief Gets which metadata are cached.
+	///        Cache is filled by every response, solicited or pushed by remote after hello.
+	/// @return JSPEER_META_* flags
+	uint8_t get_cached();
+
+	/// @brief Gets cached number of axes.
+	/// @return number of axes or -1 if not known yet
+	int get_cached_axes();
+
+	/// @brief Gets cached number of buttons.
+	/// @return number of buttons or -1 if not known yet
+	int get_cached_buttons();
+
+	/// @brief Gets cached joystick name.
+	/// @return joystick name or zero if not known yet
+	const std::string *get_cached_name();
+
+	/// @brief Gets negotiated protocol.
+	/// @return negotiated protocol, version 0 means legacy peer
+	const jsc_hello *get_protocol();
+
+	/// @brief Gets round trip time measured on the last tagged request.
+	/// @return round trip time [ns], zero if not measured yet
+	uint64_t get_rtt();
+
+	/// @brief Gets keepalive period announced by remote in its hello.
+	/// @return period [ms], zero if not announced
+	uint16_t get_keepalive_ms();
+
+	/// @brief Gets last received axis value.
+	/// @param number axis number
+	/// @return axis value
+	int16_t get_axis(uint8_t number);
+
+	/// @brief Gets last received button state.
+	/// @param number button number
+	/// @return button state
+	bool get_button(uint8_t number);
+
+	/// @brief Enables or disables prediction of axis positions.
+	/// @param enable enable flag
+	/// @return @c true if successful, otherwise @c false
+	bool set_prediction(bool enable);
+
+	/// @brief Gets predictor for tuning.
+	/// @return predictor or zero if prediction is disabled
+	jspredictor *get_predictor();
+
+	/// @brief Gets axis value extrapolated to the current instant.
+	///        Falls back to the last received value if prediction is disabled
+	///        or the axis has no sample yet.
+	/// @param number axis number
+	/// @return predicted axis value
+	int16_t get_predicted_axis(uint8_t number);
+
+	/// @brief Sets shaper of axis values (calibration, deadzone, response curve).
+	/// @param shaper shaper, may be shared by peers and must outlive them. Set to zero to unset shaper.
+	void set_shaper(const jsshaper *shaper);
+
+	/// @brief Gets last received axis value passed through shaper.
+	///        Falls back to the last received value if no shaper is set.
+	/// @param number axis number
+	/// @return shaped axis value
+	int16_t get_shaped_axis(uint8_t number);
+
+	/// @brief Gets last received values of all axes passed through shaper in one pass.
+	///        Falls back to the last received values if no shaper is set.
+	/// @param out array of JSPEER_AXES_MAX values to be filled
+	/// @return number of axes filled, announced number of axes if known
+	size_t get_shaped_axes(int16_t *out);
+
+	/// @brief Sets tracer of event delivery stages.
+	///        Remote stamps are requested (JS_ENCODING_TRACE) only from peers
+	///        which say hello while tracer is set.
+	/// @param tracer tracer, must outlive the peer. Set to zero to unset tracer.
+	void set_tracer(jstrace *tracer);
+
+	/// @brief Sets idle timeout, reported per jspeer::receiver::idle.
+	///        Reception only stamps the current tick of @p wheel, the wheel entry
+	///        is moved when it expires, so peers cost no syscalls and no timers of their own.
+	///        Remote must send something (e.g. alive) more often than the timeout.
+	///        Remote announcing its keepalive period in hello is timed out after
+	///        JSPEER_KEEPALIVE_MISSES periods instead.
+	/// @param wheel timer wheel shared by peers, must outlive the peer. Set to zero to disable idle timeout.
+	/// @param timeout_ms idle timeout [ms], zero disables idle timeout
+	/// @return @c true if successful, otherwise @c false
+	bool set_idle_timeout(jswheel *wheel, uint32_t timeout_ms);
+
+	/// @brief Sets event log, every received event is appended to stream @p name
+	///        stamped with wall clock time of reception. Stream is open while peer is initialized,
+	///        name is forgotten by cleanup, so it is set for every remote.
+	/// @param evlog event log shared by peers, must outlive the peer. Set to zero to unset event log.
+	/// @param name stream (file) name
+	/// @return @c true if successful, @c false if there is no free stream
+	bool set_event_log(jsevlog *evlog, const std::string &name);
+
+	/// @brief Sets shared memory slot, state and metadata are published into it on every change.
+	/// @param shm shared memory segment shared by peers, must outlive the peer. Set to zero to stop publishing.
+	/// @param slot slot index, must not be used by other peer
+	void set_shm(jsshm *shm, size_t slot);
+
+	/// @brief Sets subscription filter, so remote sends only wanted axes and buttons,
+	///        optionally rate limiting axes. Filter is pushed now and after every hello,
+	///        remotes without JS_ENCODING_SUBSCRIBE keep sending everything.
+	/// @param sub wanted axes and buttons. Set to zero to subscribe everything.
+	/// @param rates axis rate limits, may be zero
+	/// @param cnt number of rate limits, at most JSPEER_AXES_MAX
+	/// @return @c true if successful, @c false if filter could not be sent
+	bool subscribe(const jsc_subscribe *sub, const jsc_rate *rates, size_t cnt);
+
+	/// @brief Gets number of outstanding tagged requests.
+	/// @return number of requests
+	size_t get_pending();
+
+	/// @brief Gets number of bytes received since initialization.
+	/// @return number of bytes
+	uint64_t get_rx_bytes();
+
+	/// @brief Sets buffer lengths of connection, they apply from next initialization.
+	///        Reception ring bounds the frame length offered in hello response, so a larger
+	///        ring lets remote batch more events into one frame. Buffers are at least
+	///        JS_MESSAGE_LENGTH_MAX long, ring is rounded up to the page size.
+	/// @param rx_len socket reception buffer length
+	/// @param tx_len socket transmission buffer length
+	/// @param ring_len reception ring length
+	/// @return @c true if lengths are valid, otherwise @c false
+	bool set_buffers(size_t rx_len, size_t tx_len, size_t ring_len);
+
+	/// @brief Gets memory held by peer, its buffers included.
+	/// @return number of bytes
+	size_t get_memory();
+
 private:
+	bool parse();
+	void event(const jsc_event *ev, const jsc_trace *trace, uint64_t decode_ns);
+	void hello(const jsc_hello *remote);
+	void session_ack();
+	void shm_meta();
+	bool subscribe_send();
+	void request_remove(size_t i);
+	bool request_done(uint16_t id);
+	void request_untagged(uint8_t command);
+	void request_arm();
+	static int timerhandler(timepoller &sender, uint64_t exp);
+
 	virtual int rx(int len);
 	virtual int tx(int len);
 	virtual int hup();
 	virtual int err();
 
 	virtual bool write_datagram(const void *buff, size_t len);
+
+#ifdef JSREMOTE_IO_URING
+	virtual void uring_recv(jsuring *ur, const uint8_t *data, int len);
+#endif
 };
 
 #endif // JSPEER_H
@@ -0,0 +1,94 @@
+#ifndef JSPREDICT_H
+#define JSPREDICT_H
+
+#include "jsremote.h"
+
+#include <stddef.h>
+
+/// @brief Number of axes tracked by predictor (event axis number is 8-bit).
+#define JSPREDICT_AXES_MAX 256u
+
+/// @brief Axis position predictor.
+///        Estimates clock offset and one-way delay from event timestamps
+///        and extrapolates axis positions to the current instant.
+class jspredictor
+{
+public:
+	/// @brief Extrapolation mode.
+	enum mode
+	{
+		MODE_LINEAR,     ///< velocity from the last two samples
+		MODE_ALPHABETA,  ///< alpha-beta filtered position and velocity
+	};
+
+private:
+	struct axis
+	{
+		float    x;
+		float    v;
+		uint32_t t;
+		bool     valid;
+	};
+
+	jspredictor::mode md;
+	float             alpha;
+	float             beta;
+	uint32_t          horizon_ms;
+	uint64_t          rtt_ns;
+
+	// minimum of (local rx time - remote event time) over two sliding windows
+	int64_t           dmin_cur;
+	int64_t           dmin_prev;
+	uint64_t          dmin_start_ns;
+	int64_t           dlast;
+
+	jspredictor::axis axes[JSPREDICT_AXES_MAX];
+
+public:
+	/// @brief Constructor.
+	jspredictor();
+
+	/// @brief Forgets all state, e.g. after reconnect.
+	void reset();
+
+	/// @brief Sets extrapolation mode.
+	/// @param md extrapolation mode
+	void set_mode(jspredictor::mode md);
+
+	/// @brief Sets alpha-beta filter gains.
+	/// @param alpha position gain (0, 1]
+	/// @param beta velocity gain (0, 2)
+	void set_gains(float alpha, float beta);
+
+	/// @brief Sets maximum extrapolation horizon.
+	///        Prediction stops moving after this time since the last sample.
+	/// @param horizon_ms horizon [ms]
+	void set_horizon(uint32_t horizon_ms);
+
+	/// @brief Sets measured round trip time, used to split offset from delay.
+	/// @param rtt_ns round trip time [ns]
+	void set_rtt(uint64_t rtt_ns);
+
+	/// @brief Feeds received event.
+	/// @param ev joystick event
+	/// @param rx_ns local monotonic reception time [ns]
+	void update(const jsc_event *ev, uint64_t rx_ns);
+
+	/// @brief Predicts axis position.
+	/// @param number axis number
+	/// @param now_ns local monotonic time [ns] to predict for
+	/// @param value predicted axis value, untouched if no sample was received yet
+	/// @return @c true if predicted, @c false if axis has no sample yet
+	bool predict(uint8_t number, uint64_t now_ns, int16_t *value) const;
+
+	/// @brief Gets estimated clock offset (local - remote).
+	/// @return offset [ms]
+	int64_t get_offset_ms() const;
+
+	/// @brief Gets estimated one-way delay of the last received event.
+	/// @return delay [ms]
+	uint32_t get_delay_ms() const;
+};
+
+#endif // JSPREDICT_H
+
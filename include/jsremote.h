@@ -5,13 +5,29 @@
 
 #define JS_MESSAGE_LENGTH_MAX  1024u
 
+#define JS_PROTOCOL_VERSION    1u
+
+#define JS_ENCODING_SINGLE     0x01
+#define JS_ENCODING_BATCH      0x02
+#define JS_ENCODING_TRACE      0x04
+#define JS_ENCODING_SESSION    0x08
+#define JS_ENCODING_SUBSCRIBE  0x10
+
 #define JS_RESPONSE            0x80
 
 #define JS_COMMAND_EVENT       0x01
 #define JS_COMMAND_GETAXES     0x02
 #define JS_COMMAND_GETBUTTONS  0x03
 #define JS_COMMAND_GETNAME     0x04
+#define JS_COMMAND_HELLO       0x05
+#define JS_COMMAND_EVENTS      0x06
+#define JS_COMMAND_TEVENT      0x07
 #define JS_COMMAND_ALIVE       0x08
+#define JS_COMMAND_SESSION     0x09
+#define JS_COMMAND_ACK         0x0A
+#define JS_COMMAND_SUBSCRIBE   0x0B
+
+#define JS_SUBSCRIBE_MAP_LEN   32u
 
 struct __attribute__((packed)) jsmessage
 {
@@ -28,6 +44,68 @@ struct __attribute__((packed)) jsc_event
 	uint8_t  number;
 };
 
+// remote monotonic stamps [ns] of traced event, sent as jsc_event followed
+// by jsc_trace in JS_COMMAND_TEVENT once JS_ENCODING_TRACE was negotiated
+struct __attribute__((packed)) jsc_trace
+{
+	uint64_t read_ns;
+	uint64_t enqueue_ns;
+};
+
+// session resumption, once JS_ENCODING_SESSION was negotiated:
+// jsremote sends SESSION with its session id and last acked sequence,
+// server answers with number of events it has seen of that session (zero
+// if unknown or expired) and jsremote resends state changed after that;
+// server acks cumulative event count of the session with ACK
+struct __attribute__((packed)) jsc_session
+{
+	uint32_t id;
+	uint32_t seq;
+};
+
+// subscription filter, once JS_ENCODING_SUBSCRIBE was negotiated:
+// server sends bitmaps of wanted axes and buttons (bit n % 8 of byte n / 8),
+// optionally followed by jsc_rate entries, jsremote drops other events
+// before encoding them and sends current state of controls which became wanted;
+// rate limited axis keeps its latest value and sends it once the interval passes;
+// filter applies to the connection, it is reset to everything by reconnect
+struct __attribute__((packed)) jsc_subscribe
+{
+	uint8_t axes[JS_SUBSCRIBE_MAP_LEN];
+	uint8_t buttons[JS_SUBSCRIBE_MAP_LEN];
+};
+
+struct __attribute__((packed)) jsc_rate
+{
+	uint8_t  number;
+	uint16_t max_hz;
+};
+
+// optional request id, appended to metadata commands and
+// echoed back after the payload of the corresponding response
+struct __attribute__((packed)) jsc_request
+{
+	uint16_t id;
+};
+
+// protocol capabilities, sent by jsremote as payload of its first alive
+// (legacy servers treat it as plain alive) and answered by HELLO response,
+// after which jsremote pushes its metadata as untagged responses
+struct __attribute__((packed)) jsc_hello
+{
+	uint8_t  version;
+	uint8_t  encodings;
+	uint16_t max_length;
+};
+
+// keepalive period, appended to capabilities of the first alive;
+// jsremote sends alive only after the link was idle for the period,
+// so the server expects some frame at least that often; zero means none
+struct __attribute__((packed)) jsc_keepalive
+{
+	uint16_t period_ms;
+};
+
 struct __attribute__((packed)) jsr_getaxes
 {
 	uint8_t number;
@@ -44,5 +122,17 @@ struct __attribute__((packed)) jsr_getname
 	uint8_t name[];
 };
 
+static inline void jshello_negotiate(jsc_hello *res, const jsc_hello *local, const jsc_hello *remote)
+{
+	res->version    = local->version    < remote->version    ? local->version    : remote->version;
+	res->encodings  = local->encodings  & remote->encodings;
+	res->max_length = local->max_length < remote->max_length ? local->max_length : remote->max_length;
+
+	if (res->max_length < JS_MESSAGE_LENGTH_MAX)
+		res->max_length = JS_MESSAGE_LENGTH_MAX;
+
+	res->encodings |= JS_ENCODING_SINGLE;
+}
+
 #endif // JSREMOTE_H
 
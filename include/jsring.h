@@ -0,0 +1,80 @@
+#ifndef JSRING_H
+#define JSRING_H
+
+#include <stddef.h>
+#include <inttypes.h>
+#include <sys/types.h>
+
+/// @brief Mirrored ring buffer.
+///        The same physical pages are mapped twice back to back, so both the
+///        readable and the writable region are always contiguous in memory.
+///        Frames never straddle the end of the buffer and no compaction is needed.
+class jsring
+{
+private:
+	uint8_t *buff;
+	size_t   len;
+	size_t   rd;
+	size_t   used;
+
+public:
+	/// @brief Constructor.
+	jsring();
+
+	/// @brief Destructor.
+	~jsring();
+
+	/// @brief Initializes ring buffer.
+	/// @param len requested buffer length, rounded up to the page size
+	/// @return @c true if initialization was successful, otherwise @c false
+	bool init(size_t len);
+
+	/// @brief Cleanups ring buffer.
+	void cleanup();
+
+	/// @brief Checks if ring buffer is initialized.
+	/// @return @c true if ring buffer is initialized, otherwise @c false
+	bool is_initialized() const;
+
+	/// @brief Drops all buffered data.
+	void clear();
+
+	/// @brief Gets buffer length.
+	/// @return buffer length (after rounding to the page size)
+	size_t size() const;
+
+	/// @brief Gets number of bytes available for reading.
+	size_t tord() const;
+
+	/// @brief Gets number of bytes available for writing.
+	size_t towr() const;
+
+	/// @brief Gets read pointer. At least tord() bytes are contiguous from here.
+	uint8_t *rd_ptr() const;
+
+	/// @brief Gets write pointer. At least towr() bytes are contiguous from here.
+	uint8_t *wr_ptr() const;
+
+	/// @brief Consumes bytes from the read side.
+	/// @param n number of bytes, must not exceed tord()
+	void skip(size_t n);
+
+	/// @brief Commits bytes written to wr_ptr().
+	/// @param n number of bytes, must not exceed towr()
+	void commit(size_t n);
+
+	/// @brief Copies data into the buffer.
+	/// @param data data to be copied
+	/// @param n number of bytes
+	/// @return number of copied bytes, less than @p n if buffer is full
+	size_t write(const void *data, size_t n);
+
+	/// @brief Reads from non-blocking file descriptor until it would block or buffer gets full.
+	/// @param fd file descriptor
+	/// @param eof set to @c true if end of stream was reached
+	/// @return number of bytes read or -1 on error
+	ssize_t fill(int fd, bool *eof);
+};
+
+#endif // JSRING_H
+
@@ -0,0 +1,93 @@
+#ifndef JSSHAPE_H
+#define JSSHAPE_H
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/// @brief Number of axes shaped by shaper (event axis number is 8-bit).
+#define JSSHAPE_AXES_MAX 256u
+
+/// @brief Axis calibration and response curve.
+///        Parsed from comma separated suboptions, e.g. "min=-30000,center=200,max=31000,deadzone=0.05,expo=0.3".
+struct jsshape_axis
+{
+	int16_t min;       ///< raw value of full negative deflection
+	int16_t center;    ///< raw value of rest position
+	int16_t max;       ///< raw value of full positive deflection
+	float   deadzone;  ///< part of each half around center reported as rest [0, 1)
+	float   expo;      ///< blend of linear (0) and cubic (1) response [0, 1]
+};
+
+/// @brief Axis shaper.
+///        Maps raw axis values through calibration (center and ends), deadzone
+///        and expo curve onto the full -32767..32767 range. Whole frames of axes
+///        are shaped at once by SIMD kernel (AVX2 or SSE2 on x86, picked at runtime)
+///        over per-axis parameters kept as structure of arrays.
+class jsshaper
+{
+public:
+	/// @brief Frame kernel.
+	typedef void (*kernel)(const jsshaper *shaper, const int16_t *in, int16_t *out, size_t first, size_t n);
+
+private:
+	// structure of arrays, one lane per axis
+	alignas(32) float center[JSSHAPE_AXES_MAX];
+	alignas(32) float scale_neg[JSSHAPE_AXES_MAX];
+	alignas(32) float scale_pos[JSSHAPE_AXES_MAX];
+	alignas(32) float deadzone[JSSHAPE_AXES_MAX];
+	alignas(32) float deadzone_scale[JSSHAPE_AXES_MAX];
+	alignas(32) float expo[JSSHAPE_AXES_MAX];
+
+	jsshaper::kernel kern;
+	const char      *kern_name;
+
+public:
+	/// @brief Constructor. All axes are passed through unchanged.
+	jsshaper();
+
+	/// @brief Parses axis settings.
+	/// @param cfg settings to be filled, unspecified ones are set to pass-through
+	/// @param str comma separated suboptions (min, center, max, deadzone, expo), empty for pass-through
+	/// @return @c true if parsing was successful, otherwise @c false
+	static bool parse(jsshape_axis *cfg, const char *str);
+
+	/// @brief Sets pass-through settings of all axes.
+	void reset();
+
+	/// @brief Sets settings of one axis.
+	/// @param number axis number
+	/// @param cfg settings
+	/// @return @c true if settings are valid, otherwise @c false
+	bool set_axis(uint8_t number, const jsshape_axis *cfg);
+
+	/// @brief Sets settings of all axes.
+	/// @param cfg settings
+	/// @return @c true if settings are valid, otherwise @c false
+	bool set_axes(const jsshape_axis *cfg);
+
+	/// @brief Shapes frame of axes 0..n-1.
+	/// @param in raw axis values
+	/// @param out shaped axis values, may be the same as @p in
+	/// @param n number of axes
+	void apply(const int16_t *in, int16_t *out, size_t n) const;
+
+	/// @brief Shapes one axis value.
+	/// @param number axis number
+	/// @param value raw axis value
+	/// @return shaped axis value
+	int16_t apply(uint8_t number, int16_t value) const;
+
+	/// @brief Gets name of kernel picked for this CPU.
+	/// @return "avx2", "sse2" or "scalar"
+	const char *get_kernel_name() const;
+
+private:
+	static void apply_scalar(const jsshaper *shaper, const int16_t *in, int16_t *out, size_t first, size_t n);
+#if defined(__x86_64__) || defined(__i386__)
+	static void apply_sse2(const jsshaper *shaper, const int16_t *in, int16_t *out, size_t first, size_t n);
+	static void apply_avx2(const jsshaper *shaper, const int16_t *in, int16_t *out, size_t first, size_t n);
+#endif
+};
+
+#endif // JSSHAPE_H
+
@@ -0,0 +1,131 @@
+#ifndef JSSHM_H
+#define JSSHM_H
+
+#include "jsremote.h"
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#include <string>
+
+/// @brief Magic of shared memory segment.
+#define JSSHM_MAGIC       "JSSHM001"
+
+/// @brief Number of published axes and buttons (event number is 8-bit).
+#define JSSHM_AXES_MAX    256u
+#define JSSHM_BUTTONS_MAX 256u
+
+/// @brief Maximal published name length, including terminating zero.
+#define JSSHM_NAME_LEN    128u
+
+/// @brief Segment header.
+struct jsshm_header
+{
+	char     magic[8];
+	uint32_t peers;       ///< number of peer slots
+	uint32_t peer_len;    ///< size of peer slot
+	uint32_t generation;  ///< incremented by every server start
+};
+
+/// @brief Published peer state, one slot per peer.
+struct alignas(64) jsshm_peer
+{
+	uint32_t seq;                         ///< seqlock, odd while slot is being written
+	uint32_t generation;                  ///< incremented whenever a new remote takes the slot
+	uint8_t  active;                      ///< remote is connected
+	uint8_t  meta;                        ///< JSPEER_META_* flags of known metadata
+	uint8_t  axes_cnt;                    ///< announced number of axes
+	uint8_t  buttons_cnt;                 ///< announced number of buttons
+	uint64_t events;                      ///< number of events received by slot's current remote
+	uint64_t update_ns;                   ///< monotonic time of last change [ns]
+	char     name[JSSHM_NAME_LEN];        ///< joystick name, zero terminated
+	int16_t  axes[JSSHM_AXES_MAX];        ///< last axis values
+	uint8_t  buttons[JSSHM_BUTTONS_MAX];  ///< last button states
+};
+
+/// @brief Peer state published in named shared memory.
+///        Server creates the segment and updates a peer slot on every change, each update
+///        being a short seqlock write section without any syscall. Any number of local
+///        processes attach read-only and poll slots at their own rate, a read which races
+///        with an update is retried. Segment outlives the server, so readers stay attached
+///        across its restarts and notice them by the header generation.
+class jsshm
+{
+private:
+	jsshm_header *hdr;
+	jsshm_peer   *peers;
+	size_t        len;
+	bool          writer;
+
+public:
+	/// @brief Constructor.
+	jsshm();
+
+	/// @brief Destructor.
+	~jsshm();
+
+	/// @brief Creates segment or takes over existing one, all slots become inactive.
+	/// @param name segment name (see shm_open)
+	/// @param peers number of peer slots
+	/// @return @c true if initialization was successful, otherwise @c false
+	bool init(const std::string &name, size_t peers);
+
+	/// @brief Attaches existing segment read-only.
+	/// @param name segment name (see shm_open)
+	/// @return @c true if attaching was successful, otherwise @c false
+	bool attach(const std::string &name);
+
+	/// @brief Detaches segment, writer marks all slots inactive first.
+	void cleanup();
+
+	/// @brief Gets number of peer slots.
+	/// @return number of slots, zero if not initialized
+	size_t get_peers() const;
+
+	/// @brief Gets server generation.
+	/// @return generation, changes whenever server is restarted
+	uint32_t get_generation() const;
+
+	/// @brief Reads consistent copy of peer slot.
+	/// @param i slot index
+	/// @param out filled with slot copy
+	/// @return @c true if read, @c false if slot kept changing during all retries
+	bool read(size_t i, jsshm_peer *out) const;
+
+	/// @brief Publishes connection of new remote, with its initial state.
+	/// @param i slot index
+	/// @param axes JSSHM_AXES_MAX axis values
+	/// @param buttons JSSHM_BUTTONS_MAX button states
+	void peer_open(size_t i, const int16_t *axes, const uint8_t *buttons);
+
+	/// @brief Publishes disconnection of remote, last state stays readable.
+	/// @param i slot index
+	void peer_close(size_t i);
+
+	/// @brief Publishes whole axis and button state, e.g. after session restart.
+	/// @param i slot index
+	/// @param axes JSSHM_AXES_MAX axis values
+	/// @param buttons JSSHM_BUTTONS_MAX button states
+	void peer_state(size_t i, const int16_t *axes, const uint8_t *buttons);
+
+	/// @brief Publishes one event.
+	/// @param i slot index
+	/// @param ev event
+	void peer_event(size_t i, const jsc_event *ev);
+
+	/// @brief Publishes metadata.
+	/// @param i slot index
+	/// @param meta JSPEER_META_* flags of known metadata
+	/// @param axes number of axes
+	/// @param buttons number of buttons
+	/// @param name joystick name, truncated to JSSHM_NAME_LEN - 1 characters
+	void peer_meta(size_t i, uint8_t meta, uint8_t axes, uint8_t buttons, const std::string &name);
+
+private:
+	jsshm_peer *write_begin(size_t i);
+	void write_end(jsshm_peer *p);
+	bool map(int fd, size_t len, bool writable);
+};
+
+#endif // JSSHM_H
+
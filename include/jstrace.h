@@ -0,0 +1,113 @@
+#ifndef JSTRACE_H
+#define JSTRACE_H
+
+#include "jsremote.h"
+
+#include <stddef.h>
+#include <inttypes.h>
+
+#include <string>
+#include <ostream>
+
+/// @brief Number of log2 histogram buckets, the last one collects everything above 2^31 ns.
+#define JSTRACE_BUCKETS 32u
+
+/// @brief Per-stage latency tracer of event delivery path.
+///        Stages are split by monotonic stamps taken at device read and socket enqueue
+///        (remote clock, carried by JS_COMMAND_TEVENT) and at decode, receiver delivery
+///        and receiver return (local clock).
+class jstrace
+{
+public:
+	/// @brief Delivery stage.
+	enum stage
+	{
+		STAGE_REMOTE,    ///< device read -> socket enqueue (remote)
+		STAGE_NETWORK,   ///< socket enqueue -> decode (across clocks, queueing + network)
+		STAGE_DISPATCH,  ///< decode -> receiver delivery (local)
+		STAGE_CONSUMER,  ///< receiver delivery -> receiver return (local)
+		STAGES_CNT,
+	};
+
+	/// @brief Stage latency histogram.
+	struct histogram
+	{
+		uint64_t cnt;
+		uint64_t sum;
+		uint64_t min;
+		uint64_t max;
+		uint64_t buckets[JSTRACE_BUCKETS];
+	};
+
+private:
+	/// @brief Recorded span, all stamps on local clock.
+	struct span
+	{
+		uint64_t stamps[STAGES_CNT + 1];
+		uint8_t  type;
+		uint8_t  number;
+	};
+
+	jstrace::histogram hist[STAGES_CNT];
+	jstrace::span     *spans;
+	size_t             spans_len;
+	size_t             spans_cnt;
+	size_t             spans_wr;
+	uint64_t           rtt_ns;
+
+	// minimum of (local decode - remote enqueue) over two sliding windows
+	int64_t            dmin_cur;
+	int64_t            dmin_prev;
+	uint64_t           dmin_start_ns;
+
+public:
+	/// @brief Constructor.
+	jstrace();
+
+	/// @brief Destructor.
+	~jstrace();
+
+	/// @brief Initializes tracer.
+	/// @param spans_len number of last spans kept for export, zero for histograms only
+	/// @return @c true if initialization was successful, otherwise @c false
+	bool init(size_t spans_len);
+
+	/// @brief Cleanups tracer.
+	void cleanup();
+
+	/// @brief Forgets recorded spans and histograms.
+	void reset();
+
+	/// @brief Sets measured round trip time, network stage is aligned to its half.
+	/// @param rtt_ns round trip time [ns]
+	void set_rtt(uint64_t rtt_ns);
+
+	/// @brief Records delivered event.
+	/// @param ev joystick event
+	/// @param trace remote stamps, zero if event was not traced by remote
+	/// @param decode_ns local decode time [ns]
+	/// @param deliver_ns local receiver delivery time [ns]
+	/// @param done_ns local receiver return time [ns]
+	void record(const jsc_event *ev, const jsc_trace *trace, uint64_t decode_ns, uint64_t deliver_ns, uint64_t done_ns);
+
+	/// @brief Gets stage histogram.
+	/// @param st stage
+	/// @return histogram
+	const jstrace::histogram *get_histogram(jstrace::stage st) const;
+
+	/// @brief Prints stage histograms.
+	/// @param os output stream
+	void print(std::ostream &os) const;
+
+	/// @brief Writes kept spans as Chrome trace event file (loadable by Perfetto).
+	/// @param path output file path
+	/// @return @c true if file was written, otherwise @c false
+	bool export_chrome(const std::string &path) const;
+
+private:
+	void add(jstrace::stage st, uint64_t ns);
+	int64_t offset() const;
+};
+
+#endif // JSTRACE_H
+
@@ -0,0 +1,118 @@
+#ifndef JSURING_H
+#define JSURING_H
+
+#include <epoller/fdepoller.h>
+
+#include <liburing.h>
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/// @brief io_uring I/O backend.
+///        Completion queue is drained from the epoller loop (ring fd is watched for readability).
+///        Socket reception uses multishot receives into a provided buffer ring,
+///        device-to-socket forwarding uses linked read->send submissions.
+class jsuring : public fdepoller
+{
+public:
+	/// @brief Completion handler.
+	///        Handler must outlive all operations submitted on its behalf.
+	class handler
+	{
+	public:
+		/// @brief Destructor.
+		virtual ~handler() = default;
+
+		/// @brief Called if data were received by multishot receive.
+		/// @param ur jsuring instance
+		/// @param data received data, valid only during the call
+		/// @param len number of received bytes, zero on end of stream, negative errno on error
+		virtual void uring_recv(jsuring *ur, const uint8_t *data, int len) {}
+
+		/// @brief Called if read or send was completed.
+		/// @param ur jsuring instance
+		/// @param op completed operation (jsuring::OP_READ, jsuring::OP_SEND)
+		/// @param res operation result, negative errno on error
+		virtual void uring_done(jsuring *ur, int op, int res) {}
+	};
+
+	/// @brief Operation type, carried in the low bits of completion user data.
+	enum
+	{
+		OP_RECV = 1,
+		OP_READ = 2,
+		OP_SEND = 3,
+	};
+
+private:
+	struct io_uring          ring;
+	struct io_uring_buf_ring *br;
+	uint8_t                 *bufs;
+	unsigned                 bufs_cnt;
+	size_t                   buf_len;
+	bool                     initialized;
+
+public:
+	/// @brief Constructor.
+	/// @param epoller parent epoller
+	jsuring(struct epoller *epoller);
+
+	/// @brief Destructor.
+	~jsuring();
+
+	/// @brief Initializes ring.
+	/// @param entries submission queue entries
+	/// @param bufs_cnt number of provided receive buffers (power of two)
+	/// @param buf_len length of each provided receive buffer
+	/// @param sqpoll use kernel submission polling thread, submissions then need no syscall
+	/// @return @c true if initialization was successful, otherwise @c false
+	bool init(unsigned entries, unsigned bufs_cnt, size_t buf_len, bool sqpoll);
+
+	/// @brief Cleanups ring.
+	void cleanup();
+
+	/// @brief Checks if ring is initialized.
+	/// @return @c true if ring is initialized, otherwise @c false
+	bool is_initialized();
+
+	/// @brief Queues multishot receive on socket.
+	/// @param fd socket file descriptor
+	/// @param h completion handler
+	/// @return @c true if receive was queued, otherwise @c false
+	bool recv(int fd, jsuring::handler *h);
+
+	/// @brief Queues read, optionally linked to send of a buffer containing the read data.
+	///        Send is skipped if read comes short.
+	/// @param rfd file descriptor to read from
+	/// @param rbuff read buffer
+	/// @param rlen number of bytes to read
+	/// @param sfd socket to send to, -1 for read only
+	/// @param sbuff send buffer
+	/// @param slen number of bytes to send
+	/// @param h completion handler
+	/// @return @c true if operations were queued, otherwise @c false
+	bool read_send(int rfd, void *rbuff, size_t rlen, int sfd, const void *sbuff, size_t slen, jsuring::handler *h);
+
+	/// @brief Queues send.
+	/// @param fd socket file descriptor
+	/// @param buff data to be sent, must stay valid until completion
+	/// @param len number of bytes
+	/// @param h completion handler
+	/// @return @c true if send was queued, otherwise @c false
+	bool send(int fd, const void *buff, size_t len, jsuring::handler *h);
+
+	/// @brief Cancels all operations of handler.
+	/// @param h completion handler
+	/// @return @c true if cancellation was queued, otherwise @c false
+	bool cancel(jsuring::handler *h);
+
+	/// @brief Submits queued operations.
+	/// @return @c true if successful, otherwise @c false
+	bool submit();
+
+private:
+	virtual int in();
+};
+
+#endif // JSURING_H
+
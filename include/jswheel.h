@@ -0,0 +1,102 @@
+#ifndef JSWHEEL_H
+#define JSWHEEL_H
+
+#include <epoller/timepoller.h>
+
+#include <stddef.h>
+#include <inttypes.h>
+
+/// @brief Number of wheel levels.
+#define JSWHEEL_LEVELS 3u
+
+/// @brief Number of slots per level (power of two).
+#define JSWHEEL_SLOTS  64u
+
+/// @brief Hierarchical timer wheel.
+///        Any number of timeouts share one timerfd ticking at fixed period.
+///        Adding, removing and expiring an entry is O(1), entries further
+///        than one revolution of the lowest level are cascaded down as it wraps.
+///        Timeouts are rounded up to whole ticks, longer than
+///        JSWHEEL_SLOTS^JSWHEEL_LEVELS ticks are waited out in steps.
+class jswheel : private timepoller
+{
+public:
+	/// @brief Wheel entry, embedded into its owner.
+	class entry
+	{
+		friend class jswheel;
+
+	private:
+		jswheel::entry **slot;
+		jswheel::entry  *prev;
+		jswheel::entry  *next;
+		uint64_t         expires;
+
+	public:
+		/// @brief Constructor.
+		entry() : slot(0), prev(0), next(0), expires(0) {}
+
+		/// @brief Destructor.
+		virtual ~entry() = default;
+
+		/// @brief Checks if entry is scheduled.
+		/// @return @c true if entry is scheduled, otherwise @c false
+		bool is_scheduled() const { return slot != 0; }
+
+		/// @brief Called when entry expires, it is already removed from the wheel.
+		virtual void expired() = 0;
+	};
+
+private:
+	jswheel::entry *slots[JSWHEEL_LEVELS][JSWHEEL_SLOTS];
+	uint64_t        now;
+	uint32_t        tick_ms;
+	size_t          cnt;
+
+public:
+	/// @brief Constructor.
+	/// @param epoller parent epoller
+	jswheel(struct epoller *epoller);
+
+	/// @brief Destructor.
+	~jswheel();
+
+	/// @brief Initializes wheel.
+	/// @param tick_ms tick period [ms], resolution of all timeouts
+	/// @return @c true if initialization was successful, otherwise @c false
+	bool init(uint32_t tick_ms);
+
+	/// @brief Cleanups wheel, scheduled entries are dropped without expiring.
+	void cleanup();
+
+	/// @brief Schedules entry, reschedules it if already scheduled.
+	/// @param e entry
+	/// @param timeout_ms timeout [ms]
+	/// @return @c true if successful, otherwise @c false
+	bool add(jswheel::entry *e, uint32_t timeout_ms);
+
+	/// @brief Unschedules entry, does nothing if not scheduled.
+	/// @param e entry
+	void remove(jswheel::entry *e);
+
+	/// @brief Gets current tick, for cheap time stamping of activity.
+	/// @return number of ticks since initialization
+	uint64_t get_tick() const;
+
+	/// @brief Gets tick period.
+	/// @return tick period [ms]
+	uint32_t get_tick_ms() const;
+
+	/// @brief Gets number of scheduled entries.
+	/// @return number of entries
+	size_t get_count() const;
+
+private:
+	void link(jswheel::entry *e);
+	void unlink(jswheel::entry *e);
+	void cascade(size_t level);
+	static int timerhandler(timepoller &sender, uint64_t exp);
+};
+
+#endif // JSWHEEL_H
+
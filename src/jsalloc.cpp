@@ -0,0 +1,229 @@
+#include "jsalloc.h"
+
+#include <errno.h>
+
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+// allocator entry points of glibc, the interposed ones below forward to them
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t nmemb, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+extern "C" void *__libc_valloc(size_t size);
+extern "C" void *__libc_pvalloc(size_t size);
+
+static std::atomic<bool>     counting;
+static std::atomic<uint64_t> count;
+
+void jsalloc_set_counting(bool counting)
+{
+	::counting.store(counting, std::memory_order_relaxed);
+}
+
+bool jsalloc_is_counting()
+{
+	return counting.load(std::memory_order_relaxed);
+}
+
+uint64_t jsalloc_get_count()
+{
+	return count.load(std::memory_order_relaxed);
+}
+
+static void jsalloc_count()
+{
+	if (counting.load(std::memory_order_relaxed))
+		count.fetch_add(1, std::memory_order_relaxed);
+}
+
+extern "C" void *malloc(size_t size) noexcept
+{
+	jsalloc_count();
+
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t nmemb, size_t size) noexcept
+{
+	jsalloc_count();
+
+	return __libc_calloc(nmemb, size);
+}
+
+extern "C" void *realloc(void *p, size_t size) noexcept
+{
+	// growing in place is counted too, it may move any time
+	jsalloc_count();
+
+	return __libc_realloc(p, size);
+}
+
+extern "C" void *reallocarray(void *p, size_t nmemb, size_t size) noexcept
+{
+	// glibc's own one calls realloc internally, past the interposed one
+	if (size && nmemb > SIZE_MAX / size) {
+		errno = ENOMEM;
+		return 0;
+	}
+
+	return realloc(p, nmemb * size);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size) noexcept
+{
+	jsalloc_count();
+
+	return __libc_memalign(alignment, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+	jsalloc_count();
+
+	return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **p, size_t alignment, size_t size) noexcept
+{
+	jsalloc_count();
+
+	if (!alignment || (alignment & (alignment - 1)) || alignment % sizeof(void *))
+		return EINVAL;
+
+	void *q = __libc_memalign(alignment, size);
+
+	if (!q)
+		return ENOMEM;
+
+	*p = q;
+
+	return 0;
+}
+
+extern "C" void *valloc(size_t size) noexcept
+{
+	jsalloc_count();
+
+	return __libc_valloc(size);
+}
+
+extern "C" void *pvalloc(size_t size) noexcept
+{
+	jsalloc_count();
+
+	return __libc_pvalloc(size);
+}
+
+void *operator new(size_t size)
+{
+	void *p = malloc(size ? size : 1);
+
+	if (!p)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void *operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return malloc(size ? size : 1);
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+	free(p);
+}
+
+#ifdef __cpp_aligned_new
+void *operator new(size_t size, std::align_val_t al)
+{
+	void *p = aligned_alloc((size_t) al, size ? size : 1);
+
+	if (!p)
+		throw std::bad_alloc();
+
+	return p;
+}
+
+void *operator new[](size_t size, std::align_val_t al)
+{
+	return operator new(size, al);
+}
+
+void *operator new(size_t size, std::align_val_t al, const std::nothrow_t &) noexcept
+{
+	return aligned_alloc((size_t) al, size ? size : 1);
+}
+
+void *operator new[](size_t size, std::align_val_t al, const std::nothrow_t &) noexcept
+{
+	return aligned_alloc((size_t) al, size ? size : 1);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept
+{
+	free(p);
+}
+
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept
+{
+	free(p);
+}
+#endif
@@ -0,0 +1,640 @@
+#include "jspeer.h"
+#include "jsalloc.h"
+
+#include <epoller/epoller.h>
+#include <epoller/sigepoller.h>
+#include <epoller/timepoller.h>
+#include <epoller/tcpsepoller.h>
+
+#include <fcntl.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <iostream>
+
+////////////////////////////////////////////////////////////////////////////////
+// macros
+////////////////////////////////////////////////////////////////////////////////
+
+#define REMOTE_PATH       "./jsremote-alloccheck"
+#define SERVER_ADDR       "127.0.0.1"
+#define SERVER_PORT       17531u
+#define WARMUP_MS         1000u
+#define DURATION_MS       5000u
+#define RATE_HZ           1000u
+#define QUERY_PERIOD_MS   100u
+#define QUERY_TIMEOUT_MS  1000u
+#define DEVICE_AXES       6u
+#define DEVICE_BUTTONS    8u
+#define DEVICE_WAIT_MS    2000u
+#define DEVICE_NAME       "jsalloccheck fake joystick"
+
+////////////////////////////////////////////////////////////////////////////////
+// types
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Receiver of the checked remote, counts events and stays silent
+///        while allocations are counted.
+class check_receiver : public jspeer::receiver
+{
+public:
+	virtual void disconnected(jspeer *jsp);
+	virtual void error(jspeer *jsp);
+	virtual void event(jspeer *jsp, const jsc_event *ev);
+	virtual void alive(jspeer *jsp) {}
+	virtual void axes(jspeer *jsp, uint8_t axes) {}
+	virtual void buttons(jspeer *jsp, uint8_t buttons) {}
+	virtual void name(jspeer *jsp, const std::string &name) {}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// variables
+////////////////////////////////////////////////////////////////////////////////
+
+static epoller        epoller;
+static sigepoller     sc(&epoller);
+static tcpsepoller    srv(&epoller);
+static timepoller     device(&epoller);
+static timepoller     warmup(&epoller);
+static timepoller     query(&epoller);
+static timepoller     finish(&epoller);
+static jspeer         peer(&epoller);
+static check_receiver rcvr;
+
+static std::string    remote_path = REMOTE_PATH;
+static uint16_t       server_port = SERVER_PORT;
+static uint32_t       warmup_ms   = WARMUP_MS;
+static uint32_t       duration_ms = DURATION_MS;
+static uint32_t       rate_hz     = RATE_HZ;
+
+static int            uinput_fd = -1;
+static std::string    jsdev;
+static uint32_t       device_cnt;
+static pid_t          remote_pid = -1;
+static bool           remote_exited;
+static bool           check_void;
+static uint64_t       events;
+static uint64_t       counted_events;
+
+static const char* const short_opts = "hr:p:w:d:R:";
+
+static const struct option long_opts[] = {
+	{"help",      0, NULL, 'h'},
+	{"remote",    1, NULL, 'r'},
+	{"port",      1, NULL, 'p'},
+	{"warmup",    1, NULL, 'w'},
+	{"duration",  1, NULL, 'd'},
+	{"rate",      1, NULL, 'R'},
+	{ NULL,       0, NULL,  0 }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+static void print_help();
+static struct timespec* ms2timespec(struct timespec *ts, uint64_t ms);
+static bool device_create();
+static bool device_find(const char *sysname);
+static void device_destroy();
+static bool remote_spawn(char **extra, int extra_cnt);
+static bool remote_reap();
+static void peer_close();
+
+static int sighandler(sigepoller &sender, struct signalfd_siginfo *siginfo);
+static int devicehandler(timepoller &sender, uint64_t exp);
+static int warmuphandler(timepoller &sender, uint64_t exp);
+static int queryhandler(timepoller &sender, uint64_t exp);
+static int finishhandler(timepoller &sender, uint64_t exp);
+static int srvacc(tcpsepoller &sender, int fd, const struct sockaddr *addr, const socklen_t *addrlen);
+
+////////////////////////////////////////////////////////////////////////////////
+// aux functions
+////////////////////////////////////////////////////////////////////////////////
+
+static void print_help()
+{
+	std::cout << "usage: jsalloccheck [arguments] [-- <jsremote arguments>]"                                         << std::endl;
+	std::cout << "runs jsremote against a fake joystick (uinput) and an in-process server, both sides count heap"    << std::endl;
+	std::cout << "allocations once warmed up and the check fails if either allocated anything"                       << std::endl;
+	std::cout << "  -h  --help             print this help"                                                          << std::endl;
+	std::cout << "  -r  --remote <path>    jsremote built with allocation counting (default: " << REMOTE_PATH  << ")" << std::endl;
+	std::cout << "  -p  --port <port>      loopback tcp port of the server (default: "         << SERVER_PORT  << ")" << std::endl;
+	std::cout << "  -w  --warmup <ms>      time after connecting before counting (default: "   << WARMUP_MS    << ")" << std::endl;
+	std::cout << "  -d  --duration <ms>    counted time (default: "                            << DURATION_MS  << ")" << std::endl;
+	std::cout << "  -R  --rate <hz>        fake joystick event rate (default: "                << RATE_HZ      << ")" << std::endl;
+	std::cout << std::endl;
+}
+
+static struct timespec* ms2timespec(struct timespec *ts, uint64_t ms)
+{
+	ts->tv_sec  =  ms / 1000ULL;
+	ts->tv_nsec = (ms % 1000ULL) * 1000000ULL;
+	return ts;
+}
+
+static bool device_create()
+{
+	struct uinput_setup setup;
+	char                sysname[64];
+
+	uinput_fd = open("/dev/uinput", O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+	if (uinput_fd == -1) {
+		perror("opening /dev/uinput failed");
+		return false;
+	}
+
+	// joydev takes devices with absolute axes and joystick buttons
+	bool ok = ioctl(uinput_fd, UI_SET_EVBIT, EV_KEY) != -1 && ioctl(uinput_fd, UI_SET_EVBIT, EV_ABS) != -1;
+
+	for (unsigned i = 0; ok && i < DEVICE_BUTTONS; ++i)
+		ok = ioctl(uinput_fd, UI_SET_KEYBIT, BTN_TRIGGER + i) != -1;
+
+	for (unsigned i = 0; ok && i < DEVICE_AXES; ++i) {
+		struct uinput_abs_setup abs;
+
+		memset(&abs, 0, sizeof abs);
+		abs.code             = ABS_X + i;
+		abs.absinfo.minimum  = -INT16_MAX;
+		abs.absinfo.maximum  =  INT16_MAX;
+
+		ok = ioctl(uinput_fd, UI_SET_ABSBIT, ABS_X + i) != -1 && ioctl(uinput_fd, UI_ABS_SETUP, &abs) != -1;
+	}
+
+	memset(&setup, 0, sizeof setup);
+	setup.id.bustype = BUS_VIRTUAL;
+	strncpy(setup.name, DEVICE_NAME, sizeof setup.name - 1);
+
+	if (!ok || ioctl(uinput_fd, UI_DEV_SETUP, &setup) == -1 || ioctl(uinput_fd, UI_DEV_CREATE) == -1) {
+		perror("creating fake joystick failed");
+		close(uinput_fd);
+		uinput_fd = -1;
+		return false;
+	}
+
+	if (ioctl(uinput_fd, UI_GET_SYSNAME(sizeof sysname), sysname) == -1) {
+		perror("getting fake joystick name failed");
+		device_destroy();
+		return false;
+	}
+
+	// joystick node shows up asynchronously
+	for (uint32_t waited = 0; !device_find(sysname); waited += 10) {
+		if (waited >= DEVICE_WAIT_MS) {
+			std::cerr << "joystick node of fake joystick " << sysname << " not found" << std::endl;
+			device_destroy();
+			return false;
+		}
+		usleep(10000);
+	}
+
+	std::cout << "fake joystick: " << jsdev << std::endl;
+
+	return true;
+}
+
+static bool device_find(const char *sysname)
+{
+	std::string    dir = std::string("/sys/devices/virtual/input/") + sysname;
+	DIR           *d   = opendir(dir.c_str());
+	struct dirent *ent;
+
+	if (!d)
+		return false;
+
+	jsdev.clear();
+
+	while ((ent = readdir(d)))
+		if (!strncmp(ent->d_name, "js", 2))
+			jsdev = std::string("/dev/input/") + ent->d_name;
+
+	closedir(d);
+
+	return !jsdev.empty() && access(jsdev.c_str(), R_OK) == 0;
+}
+
+static void device_destroy()
+{
+	if (uinput_fd == -1)
+		return;
+
+	ioctl(uinput_fd, UI_DEV_DESTROY);
+	close(uinput_fd);
+	uinput_fd = -1;
+}
+
+static bool remote_spawn(char **extra, int extra_cnt)
+{
+	std::string         port   = std::to_string(server_port);
+	std::string         warm   = std::to_string(warmup_ms);
+	std::vector<char *> argv;
+
+	argv.push_back((char *) remote_path.c_str());
+	argv.push_back((char *) "-a");
+	argv.push_back((char *) SERVER_ADDR);
+	argv.push_back((char *) "-p");
+	argv.push_back((char *) port.c_str());
+	argv.push_back((char *) "-j");
+	argv.push_back((char *) jsdev.c_str());
+	argv.push_back((char *) "-A");
+	argv.push_back((char *) warm.c_str());
+	for (int i = 0; i < extra_cnt; ++i)
+		argv.push_back(extra[i]);
+	argv.push_back(NULL);
+
+	remote_pid = fork();
+
+	if (remote_pid == -1) {
+		perror("starting remote failed");
+		return false;
+	}
+
+	if (!remote_pid) {
+		sigset_t sigset;
+
+		sigemptyset(&sigset);
+		sigprocmask(SIG_SETMASK, &sigset, NULL);
+
+		execv(argv[0], argv.data());
+		perror("executing remote failed");
+		_exit(EXIT_FAILURE);
+	}
+
+	return true;
+}
+
+static bool remote_reap()
+{
+	int status;
+
+	if (remote_pid == -1)
+		return false;
+
+	if (!remote_exited)
+		kill(remote_pid, SIGTERM);
+
+	if (waitpid(remote_pid, &status, 0) == -1) {
+		perror("waiting for remote failed");
+		return false;
+	}
+
+	remote_pid = -1;
+
+	// remote fails itself if it allocated in steady state
+	return WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS;
+}
+
+static void peer_close()
+{
+	if (!peer.is_initialized())
+		return;
+
+	int fd = peer.get_fd();
+	peer.cleanup();
+	close(fd);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// handlers
+////////////////////////////////////////////////////////////////////////////////
+
+static int sighandler(sigepoller &sender, struct signalfd_siginfo *siginfo)
+{
+	std::cerr << "received signal ";
+	switch (siginfo->ssi_signo) {
+		case SIGTERM:
+			std::cerr << "SIGTERM" << std::endl;
+			return 1;
+		case SIGINT:
+			std::cerr << "SIGINT" << std::endl;
+			return 1;
+		case SIGQUIT:
+			std::cerr << "SIGQUIT" << std::endl;
+			return 1;
+		case SIGCHLD:
+			std::cerr << "SIGCHLD, remote exited early" << std::endl;
+			remote_exited = true;
+			return 1;
+		case SIGPIPE:
+			std::cerr << "SIGPIPE" << std::endl;
+			return 0;
+		default:
+			std::cerr << "<unknown>" << std::endl;
+			return 0;
+	}
+}
+
+void check_receiver::disconnected(jspeer *jsp)
+{
+	// reconnects are not steady state, the check is void
+	if (jsalloc_is_counting())
+		check_void = true;
+	peer_close();
+}
+
+void check_receiver::error(jspeer *jsp)
+{
+	if (jsalloc_is_counting())
+		check_void = true;
+	peer_close();
+}
+
+void check_receiver::event(jspeer *jsp, const jsc_event *ev)
+{
+	++events;
+
+	if (jsalloc_is_counting())
+		++counted_events;
+}
+
+static int devicehandler(timepoller &sender, uint64_t exp)
+{
+	struct input_event ev[2];
+
+	memset(ev, 0, sizeof ev);
+
+	// sweep over all axes, then the first button toggles
+	uint32_t slot = device_cnt % (DEVICE_AXES + 1);
+
+	if (slot < DEVICE_AXES) {
+		ev[0].type  = EV_ABS;
+		ev[0].code  = ABS_X + slot;
+		ev[0].value = (int32_t) ((device_cnt * 1021u) % (2u * INT16_MAX + 1u)) - INT16_MAX;
+	} else {
+		ev[0].type  = EV_KEY;
+		ev[0].code  = BTN_TRIGGER;
+		ev[0].value = (device_cnt / (DEVICE_AXES + 1)) & 1;
+	}
+
+	ev[1].type = EV_SYN;
+	ev[1].code = SYN_REPORT;
+
+	++device_cnt;
+
+	if (write(uinput_fd, ev, sizeof ev) != (ssize_t) sizeof ev) {
+		perror("writing fake joystick event failed");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int warmuphandler(timepoller &sender, uint64_t exp)
+{
+	std::cout << "counting allocations" << std::endl;
+	jsalloc_set_counting(true);
+
+	return 0;
+}
+
+static int queryhandler(timepoller &sender, uint64_t exp)
+{
+	// metadata requests and responses take the steady state path too
+	static const uint8_t commands[] = {JS_COMMAND_GETAXES, JS_COMMAND_GETBUTTONS, JS_COMMAND_GETNAME};
+
+	if (peer.is_initialized() && !peer.query(commands, NULL, sizeof commands, QUERY_TIMEOUT_MS))
+		check_void = true;
+
+	return 0;
+}
+
+static int finishhandler(timepoller &sender, uint64_t exp)
+{
+	return 1;
+}
+
+static int srvacc(tcpsepoller &sender, int fd, const struct sockaddr *addr, const socklen_t *addrlen)
+{
+	struct timespec ts;
+
+	if (fd < 0) {
+		std::cerr << "remote accepting failed" << std::endl;
+		return 0;
+	}
+
+	if (peer.is_initialized() || jsalloc_is_counting()) {
+		std::cerr << "remote reconnected, check is void" << std::endl;
+		check_void = true;
+		close(fd);
+		return 1;
+	}
+
+	if (!peer.init(fd)) {
+		std::cerr << "initializing peer failed" << std::endl;
+		close(fd);
+		return -1;
+	}
+
+	peer.set_receiver(&rcvr);
+
+	std::cout << "remote connected" << std::endl;
+
+	// remote counts from its connection on the same warm-up
+	if (!warmup.arm_oneshot(ms2timespec(&ts, warmup_ms)) ||
+	    !finish.arm_oneshot(ms2timespec(&ts, (uint64_t) warmup_ms + duration_ms)) ||
+	    !query.arm_periodic(ms2timespec(&ts, QUERY_PERIOD_MS))) {
+		std::cerr << "setting check timers failed" << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	bool            err = false;
+	int             next_opt;
+	sigset_t        sigset;
+	struct timespec ts;
+	uint64_t        count;
+
+	// block signals, child exit ends the loop too
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGTERM);
+	sigaddset(&sigset, SIGINT);
+	sigaddset(&sigset, SIGQUIT);
+	sigaddset(&sigset, SIGCHLD);
+	sigaddset(&sigset, SIGPIPE);
+	sigprocmask(SIG_BLOCK, &sigset, NULL);
+
+	// parse options, the rest goes to remote
+	do {
+		next_opt = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		switch (next_opt) {
+			case 'h':
+				print_help();
+				goto unwind;
+			case 'r':
+				remote_path = optarg;
+				break;
+			case 'p':
+				server_port = atoi(optarg);
+				break;
+			case 'w':
+				warmup_ms = strtoul(optarg, NULL, 10);
+				break;
+			case 'd':
+				duration_ms = strtoul(optarg, NULL, 10);
+				break;
+			case 'R':
+				rate_hz = strtoul(optarg, NULL, 10);
+				break;
+			case -1:
+				break;
+			default:
+				std::cerr << "an arguments parsing error encountered" << std::endl;
+				print_help();
+				err = true;
+				goto unwind;
+		}
+	} while (next_opt != -1);
+
+	// check options
+	if (!server_port || !warmup_ms || !duration_ms || !rate_hz || rate_hz > 1000000u) {
+		std::cerr << "invalid port, warm-up, duration or rate" << std::endl;
+		print_help();
+		err = true;
+		goto unwind;
+	}
+
+	// initialize epoller
+	if (!epoller.init()) {
+		err = true;
+		goto unwind;
+	}
+
+	// initialize signal catcher
+	if (!sc.init(&sigset)) {
+		err = true;
+		goto unwind_epoller;
+	}
+	sc._sighandler = &sighandler;
+
+	// initialize timers
+	if (!warmup.init()) {
+		err = true;
+		goto unwind_sc;
+	}
+	warmup._timerhandler = &warmuphandler;
+
+	if (!query.init()) {
+		err = true;
+		goto unwind_warmup;
+	}
+	query._timerhandler = &queryhandler;
+
+	if (!finish.init()) {
+		err = true;
+		goto unwind_query;
+	}
+	finish._timerhandler = &finishhandler;
+
+	// initialize fake joystick, fed from a periodic timer
+	if (!device_create()) {
+		err = true;
+		goto unwind_finish;
+	}
+
+	if (!device.init()) {
+		err = true;
+		goto unwind_device;
+	}
+	device._timerhandler = &devicehandler;
+
+	ts.tv_sec  = 1000000000ULL / rate_hz / 1000000000ULL;
+	ts.tv_nsec = 1000000000ULL / rate_hz % 1000000000ULL;
+
+	if (!device.arm_periodic(&ts)) {
+		std::cerr << "setting fake joystick timer failed" << std::endl;
+		err = true;
+		goto unwind_device_timer;
+	}
+
+	// initialize server for jsremote application
+	if (!srv.socket(AF_INET, SERVER_ADDR, server_port)) {
+		err = true;
+		goto unwind_device_timer;
+	}
+	srv._acc = &srvacc;
+
+	// start remote
+	if (!remote_spawn(argv + optind, argc - optind)) {
+		err = true;
+		goto unwind_srv;
+	}
+
+	// enter the loop
+	err = !epoller.loop();
+
+	// cleanups
+
+	jsalloc_set_counting(false);
+	count = jsalloc_get_count();
+
+	std::cout << "events: " << events << " received, " << counted_events << " while counting" << std::endl;
+	std::cout << "server steady state allocations: " << count << std::endl;
+
+	if (!remote_reap()) {
+		std::cerr << "remote failed or allocated in steady state" << std::endl;
+		err = true;
+	}
+
+	if (check_void)
+		std::cerr << "connection broke or a query failed while counting" << std::endl;
+
+	if (!counted_events)
+		std::cerr << "no events received while counting" << std::endl;
+
+	if (check_void || !counted_events || count)
+		err = true;
+
+	peer_close();
+
+unwind_srv:
+	srv.close();
+	remote_reap();
+
+unwind_device_timer:
+	device.cleanup();
+
+unwind_device:
+	device_destroy();
+
+unwind_finish:
+	finish.cleanup();
+
+unwind_query:
+	query.cleanup();
+
+unwind_warmup:
+	warmup.cleanup();
+
+unwind_sc:
+	sc.cleanup();
+
+unwind_epoller:
+	epoller.cleanup();
+
+unwind:
+	if (err) {
+		std::cout << "finished with error" << std::endl;
+		return EXIT_FAILURE;
+	} else {
+		std::cout << "finished with success" << std::endl;
+		return EXIT_SUCCESS;
+	}
+}
@@ -0,0 +1,437 @@
+#include "jsevlog.h"
+
+#include <time.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <new>
+#include <cstring>
+#include <iostream>
+
+#define DBG_PREFIX "jsevlog: "
+
+#define WRITE_PERIOD_US 2000u
+
+// column offsets within block
+#define COL_TIME   JSEVLOG_HEADER_LEN
+#define COL_VALUE  (COL_TIME  + JSEVLOG_BLOCK_EVENTS * sizeof(uint64_t))
+#define COL_TYPE   (COL_VALUE + JSEVLOG_BLOCK_EVENTS * sizeof(int16_t))
+#define COL_NUMBER (COL_TYPE  + JSEVLOG_BLOCK_EVENTS * sizeof(uint8_t))
+
+static_assert(JSEVLOG_BLOCK_LEN % JSEVLOG_HEADER_LEN == 0, "blocks must stay page aligned");
+
+jsevlog::jsevlog() : queue(0), queue_mask(0), queue_head(0), queue_tail(0), dropped(0), streams(0), streams_len(0), running(false)
+{
+}
+
+jsevlog::~jsevlog()
+{
+	cleanup();
+}
+
+bool jsevlog::init(const std::string &dir, size_t streams_len, size_t queue_len)
+{
+	cleanup();
+
+	size_t len = 1;
+
+	while (len < queue_len)
+		len <<= 1;
+
+	queue   = new (std::nothrow) jsevlog::record[len];
+	streams = new (std::nothrow) jsevlog::stream[streams_len];
+
+	if (!queue || !streams) {
+		std::cerr << DBG_PREFIX"allocating queue failed" << std::endl;
+		delete[] queue;
+		delete[] streams;
+		queue   = 0;
+		streams = 0;
+		return false;
+	}
+
+	for (size_t i = 0; i < streams_len; ++i) {
+		streams[i].state.store(STATE_FREE, std::memory_order_relaxed);
+		streams[i].opened  = false;
+		streams[i].closing = false;
+		streams[i].fd      = -1;
+		streams[i].block   = 0;
+	}
+
+	this->dir         = dir;
+	this->streams_len = streams_len;
+	queue_mask        = len - 1;
+	queue_head.store(0, std::memory_order_relaxed);
+	queue_tail.store(0, std::memory_order_relaxed);
+	dropped.store(0, std::memory_order_relaxed);
+	running.store(true, std::memory_order_release);
+
+	try {
+		writer = std::thread(&jsevlog::run, this);
+	} catch (...) {
+		std::cerr << DBG_PREFIX"starting writer thread failed" << std::endl;
+		running.store(false, std::memory_order_relaxed);
+		delete[] queue;
+		delete[] streams;
+		queue   = 0;
+		streams = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void jsevlog::cleanup()
+{
+	if (!queue)
+		return;
+
+	running.store(false, std::memory_order_release);
+	writer.join();
+
+	delete[] queue;
+	delete[] streams;
+
+	queue       = 0;
+	streams     = 0;
+	streams_len = 0;
+}
+
+int jsevlog::open(const std::string &name)
+{
+	for (size_t i = 0; i < streams_len; ++i) {
+
+		jsevlog::stream &st = streams[i];
+
+		if (st.state.load(std::memory_order_acquire) != STATE_FREE)
+			continue;
+
+		// path is handed over to writer by the state store
+		st.path = dir + "/" + name;
+		st.state.store(STATE_OPENING, std::memory_order_release);
+
+		return i;
+	}
+
+	return -1;
+}
+
+void jsevlog::close(int id)
+{
+	if (id < 0 || (size_t) id >= streams_len)
+		return;
+
+	uint8_t expected = STATE_OPEN;
+
+	// not opened by writer yet, it closes right after opening
+	if (!streams[id].state.compare_exchange_strong(expected, STATE_CLOSING, std::memory_order_acq_rel)) {
+		expected = STATE_OPENING;
+		streams[id].state.compare_exchange_strong(expected, STATE_CLOSING, std::memory_order_acq_rel);
+	}
+}
+
+bool jsevlog::append(int id, const jsc_event *ev, uint64_t time_ns)
+{
+	size_t head = queue_head.load(std::memory_order_relaxed);
+
+	if (id < 0 || head - queue_tail.load(std::memory_order_acquire) > queue_mask) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	jsevlog::record &rec = queue[head & queue_mask];
+
+	rec.time_ns = time_ns;
+	rec.ev      = *ev;
+	rec.stream  = id;
+
+	queue_head.store(head + 1, std::memory_order_release);
+
+	return true;
+}
+
+uint64_t jsevlog::get_dropped() const
+{
+	return dropped.load(std::memory_order_relaxed);
+}
+
+bool jsevlog::query(const std::string &path, uint64_t from_ns, uint64_t to_ns, jsevlog_visitor &v)
+{
+	int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+	if (fd == -1) {
+		std::cerr << DBG_PREFIX"opening " << path << " failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	struct stat  sb;
+	jsevlog_file hdr;
+
+	if (fstat(fd, &sb) || pread(fd, &hdr, sizeof hdr, 0) != sizeof hdr || memcmp(hdr.magic, JSEVLOG_MAGIC, sizeof hdr.magic) ||
+	    hdr.block_events != JSEVLOG_BLOCK_EVENTS || hdr.block_len != JSEVLOG_BLOCK_LEN) {
+		std::cerr << DBG_PREFIX << path << " is not an event log" << std::endl;
+		::close(fd);
+		return false;
+	}
+
+	for (uint64_t off = JSEVLOG_HEADER_LEN; off + JSEVLOG_BLOCK_LEN <= (uint64_t) sb.st_size; off += JSEVLOG_BLOCK_LEN) {
+
+		jsevlog_block blk;
+
+		// index only, columns of blocks out of range are never read
+		if (pread(fd, &blk, sizeof blk, off) != sizeof blk)
+			break;
+
+		if (!blk.cnt || blk.max_ns < from_ns || blk.min_ns > to_ns)
+			continue;
+
+		uint8_t *block = (uint8_t *) mmap(NULL, JSEVLOG_BLOCK_LEN, PROT_READ, MAP_SHARED, fd, off);
+
+		if (block == MAP_FAILED) {
+			std::cerr << DBG_PREFIX"mapping block failed: " << strerror(errno) << std::endl;
+			::close(fd);
+			return false;
+		}
+
+		const uint64_t *times   = (const uint64_t *) (block + COL_TIME);
+		const int16_t  *values  = (const int16_t *)  (block + COL_VALUE);
+		const uint8_t  *types   = block + COL_TYPE;
+		const uint8_t  *numbers = block + COL_NUMBER;
+		uint32_t        cnt     = __atomic_load_n(&((const jsevlog_block *) block)->cnt, __ATOMIC_ACQUIRE);
+
+		for (uint32_t i = 0; i < cnt; ++i) {
+
+			if (times[i] < from_ns || times[i] > to_ns)
+				continue;
+
+			jsc_event ev;
+
+			ev.time   = 0;
+			ev.value  = values[i];
+			ev.type   = types[i];
+			ev.number = numbers[i];
+
+			v.on_event(times[i], &ev);
+		}
+
+		munmap(block, JSEVLOG_BLOCK_LEN);
+	}
+
+	::close(fd);
+
+	return true;
+}
+
+void jsevlog::run()
+{
+	struct timespec ts;
+
+	ts.tv_sec  = 0;
+	ts.tv_nsec = WRITE_PERIOD_US * 1000L;
+
+	// polls instead of being woken up, so producer never makes a syscall
+	for (;;) {
+		bool last = !running.load(std::memory_order_acquire);
+		bool busy = false;
+
+		// opened before draining, so their events find them; closing ones are
+		// noted before draining, so events appended before close are written
+		for (size_t i = 0; i < streams_len; ++i) {
+
+			jsevlog::stream &st = streams[i];
+			uint8_t          s  = st.state.load(std::memory_order_acquire);
+
+			if (s == STATE_OPENING) {
+				if (!st.opened)
+					stream_open(&st);
+
+				uint8_t expected = STATE_OPENING;
+				if (!st.state.compare_exchange_strong(expected, STATE_OPEN, std::memory_order_acq_rel))
+					st.closing = true;
+				busy = true;
+
+			} else if (s == STATE_CLOSING || (last && s == STATE_OPEN)) {
+				if (!st.opened)
+					stream_open(&st);
+				st.closing = true;
+			}
+		}
+
+		busy |= drain();
+
+		for (size_t i = 0; i < streams_len; ++i) {
+
+			jsevlog::stream &st = streams[i];
+
+			if (!st.closing)
+				continue;
+
+			stream_close(&st);
+			st.opened  = false;
+			st.closing = false;
+			st.state.store(STATE_FREE, std::memory_order_release);
+			busy = true;
+		}
+
+		if (last)
+			break;
+
+		if (!busy)
+			nanosleep(&ts, NULL);
+	}
+}
+
+bool jsevlog::drain()
+{
+	size_t tail = queue_tail.load(std::memory_order_relaxed);
+	size_t head = queue_head.load(std::memory_order_acquire);
+
+	if (tail == head)
+		return false;
+
+	for (; tail != head; ++tail)
+		store(&queue[tail & queue_mask]);
+
+	queue_tail.store(tail, std::memory_order_release);
+
+	return true;
+}
+
+void jsevlog::store(const jsevlog::record *rec)
+{
+	if (rec->stream >= streams_len)
+		return;
+
+	jsevlog::stream &st = streams[rec->stream];
+
+	// opened and appended to since streams were scanned
+	if (!st.opened)
+		stream_open(&st);
+
+	// events of a stream whose file failed are discarded
+	if (!st.block)
+		return;
+
+	jsevlog_block *blk = (jsevlog_block *) st.block;
+	uint32_t       i   = blk->cnt;
+
+	((uint64_t *) (st.block + COL_TIME))[i] = rec->time_ns;
+	((int16_t *)  (st.block + COL_VALUE))[i] = rec->ev.value;
+	(st.block + COL_TYPE)[i]                 = rec->ev.type;
+	(st.block + COL_NUMBER)[i]               = rec->ev.number;
+
+	if (!i || rec->time_ns < blk->min_ns)
+		blk->min_ns = rec->time_ns;
+	if (!i || rec->time_ns > blk->max_ns)
+		blk->max_ns = rec->time_ns;
+
+	__atomic_store_n(&blk->cnt, i + 1, __ATOMIC_RELEASE);
+
+	if (i + 1 == JSEVLOG_BLOCK_EVENTS)
+		stream_map(&st, st.block_off + JSEVLOG_BLOCK_LEN);
+}
+
+bool jsevlog::stream_open(jsevlog::stream *st)
+{
+	st->opened = true;
+	st->fd = ::open(st->path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+	if (st->fd == -1) {
+		std::cerr << DBG_PREFIX"opening " << st->path << " failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	struct stat  sb;
+	jsevlog_file hdr;
+
+	if (fstat(st->fd, &sb)) {
+		stream_close(st);
+		return false;
+	}
+
+	uint64_t off = JSEVLOG_HEADER_LEN;
+
+	if (sb.st_size) {
+		if (pread(st->fd, &hdr, sizeof hdr, 0) != sizeof hdr || memcmp(hdr.magic, JSEVLOG_MAGIC, sizeof hdr.magic) ||
+		    hdr.block_events != JSEVLOG_BLOCK_EVENTS || hdr.block_len != JSEVLOG_BLOCK_LEN) {
+			std::cerr << DBG_PREFIX << st->path << " is not an event log" << std::endl;
+			stream_close(st);
+			return false;
+		}
+
+		// continue in the last complete block, a torn one is overwritten
+		uint64_t blocks = ((uint64_t) sb.st_size - JSEVLOG_HEADER_LEN) / JSEVLOG_BLOCK_LEN;
+
+		if (blocks)
+			off += (blocks - 1) * JSEVLOG_BLOCK_LEN;
+
+	} else {
+		memset(&hdr, 0, sizeof hdr);
+		memcpy(hdr.magic, JSEVLOG_MAGIC, sizeof hdr.magic);
+		hdr.block_events = JSEVLOG_BLOCK_EVENTS;
+		hdr.block_len    = JSEVLOG_BLOCK_LEN;
+
+		if (pwrite(st->fd, &hdr, sizeof hdr, 0) != sizeof hdr) {
+			std::cerr << DBG_PREFIX"writing " << st->path << " failed: " << strerror(errno) << std::endl;
+			stream_close(st);
+			return false;
+		}
+	}
+
+	if (!stream_map(st, off)) {
+		stream_close(st);
+		return false;
+	}
+
+	if (((jsevlog_block *) st->block)->cnt >= JSEVLOG_BLOCK_EVENTS && !stream_map(st, off + JSEVLOG_BLOCK_LEN)) {
+		stream_close(st);
+		return false;
+	}
+
+	return true;
+}
+
+bool jsevlog::stream_map(jsevlog::stream *st, uint64_t off)
+{
+	if (st->block) {
+		munmap(st->block, JSEVLOG_BLOCK_LEN);
+		st->block = 0;
+	}
+
+	struct stat sb;
+
+	// file grows by whole blocks, new ones read as zeros
+	if (fstat(st->fd, &sb) || ((uint64_t) sb.st_size < off + JSEVLOG_BLOCK_LEN && ftruncate(st->fd, off + JSEVLOG_BLOCK_LEN))) {
+		std::cerr << DBG_PREFIX"growing " << st->path << " failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	void *block = mmap(NULL, JSEVLOG_BLOCK_LEN, PROT_READ | PROT_WRITE, MAP_SHARED, st->fd, off);
+
+	if (block == MAP_FAILED) {
+		std::cerr << DBG_PREFIX"mapping " << st->path << " failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	st->block     = (uint8_t *) block;
+	st->block_off = off;
+
+	return true;
+}
+
+void jsevlog::stream_close(jsevlog::stream *st)
+{
+	if (st->block) {
+		munmap(st->block, JSEVLOG_BLOCK_LEN);
+		st->block = 0;
+	}
+
+	if (st->fd != -1) {
+		::close(st->fd);
+		st->fd = -1;
+	}
+}
+
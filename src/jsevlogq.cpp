@@ -0,0 +1,114 @@
+#include "jsevlog.h"
+
+#include <getopt.h>
+#include <linux/joystick.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+////////////////////////////////////////////////////////////////////////////////
+// types
+////////////////////////////////////////////////////////////////////////////////
+
+class jsq_printer : public jsevlog_visitor
+{
+public:
+	uint64_t cnt;
+
+	jsq_printer() : cnt(0) {}
+
+	virtual void on_event(uint64_t time_ns, const jsc_event *ev)
+	{
+		++cnt;
+		printf("%" PRIu64 ".%09" PRIu64 ", %6d, %02X, %02d\n", time_ns / 1000000000u, time_ns % 1000000000u,
+		       ev->value, ev->type, ev->number);
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// variables
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t from_ns;
+static uint64_t to_ns = UINT64_MAX;
+
+static const char* const short_opts = "hf:t:";
+
+static const struct option long_opts[] = {
+	{"help",      0, NULL, 'h'},
+	{"from",      1, NULL, 'f'},
+	{"to",        1, NULL, 't'},
+	{ NULL,       0, NULL,  0 }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+static void print_help();
+
+////////////////////////////////////////////////////////////////////////////////
+// aux functions
+////////////////////////////////////////////////////////////////////////////////
+
+static void print_help()
+{
+	std::cout << "usage: jsevlogq [arguments] <file>..."                                          << std::endl;
+	std::cout << "  -h  --help            print this help"                                        << std::endl;
+	std::cout << "  -f  --from <s>        print events received at or after unix time <s>"        << std::endl;
+	std::cout << "  -t  --to <s>          print events received at or before unix time <s>"       << std::endl;
+	std::cout << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	bool        err = false;
+	int         next_opt;
+	jsq_printer printer;
+
+	// parse options
+	do {
+		next_opt = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		switch (next_opt) {
+			case 'h':
+				print_help();
+				goto unwind;
+			case 'f':
+				from_ns = (uint64_t) (strtod(optarg, NULL) * 1e9);
+				break;
+			case 't':
+				to_ns = (uint64_t) (strtod(optarg, NULL) * 1e9);
+				break;
+			case -1:
+				break;
+			default:
+				std::cerr << "an arguments parsing error encountered" << std::endl;
+				print_help();
+				err = true;
+				goto unwind;
+		}
+	} while (next_opt != -1);
+
+	// check options
+	if (optind >= argc) {
+		std::cerr << "no log file" << std::endl;
+		print_help();
+		err = true;
+		goto unwind;
+	}
+
+	for (int i = optind; i < argc; ++i)
+		if (!jsevlog::query(argv[i], from_ns, to_ns, printer))
+			err = true;
+
+	std::cerr << "total: " << printer.cnt << " events" << std::endl;
+
+unwind:
+	return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
@@ -0,0 +1,178 @@
+#include "jslink.h"
+
+#include <cstring>
+
+jslink::jslink() : e(0), st(JOYSTICK_WAIT), joystick_period_ns(0), server_period_ns(0), alive_period_ns(0), alive_tx_ns(0), down_since(0)
+{
+	memset(&stats, 0, sizeof stats);
+}
+
+void jslink::init(jslink::env *e, uint32_t joystick_period_ms, uint32_t server_period_ms, uint32_t alive_period_ms)
+{
+	this->e            = e;
+	st                 = JOYSTICK_WAIT;
+	joystick_period_ns = joystick_period_ms * 1000000ULL;
+	server_period_ns   = server_period_ms * 1000000ULL;
+	alive_period_ns    = alive_period_ms * 1000000ULL;
+	alive_tx_ns        = 0;
+	down_since         = 0;
+
+	memset(&stats, 0, sizeof stats);
+}
+
+bool jslink::start()
+{
+	return monitor_joystick();
+}
+
+void jslink::stop()
+{
+	e->timer_disarm();
+	e->alive_disarm();
+	e->socket_close();
+	e->joystick_close();
+
+	st = JOYSTICK_WAIT;
+}
+
+bool jslink::timeout()
+{
+	switch (st) {
+		case JOYSTICK_WAIT:
+			if (!e->joystick_present() || !e->joystick_open())
+				return true;
+
+			++stats.opens;
+			down_since = e->now_ns();
+
+			return monitor_server();
+
+		case SERVER_WAIT:
+			++stats.connects;
+
+			if (!e->socket_connect())
+				return false;
+
+			st = CONNECTING;
+			return true;
+
+		case CONNECTING:
+		case CONNECTED:
+			return true;
+	}
+
+	return true;
+}
+
+bool jslink::connected(bool ok)
+{
+	// late completion of closed attempt
+	if (st != CONNECTING)
+		return true;
+
+	if (!ok || !e->socket_setup())
+		return socket_lost();
+
+	alive_tx_ns = e->now_ns();
+
+	if (alive_period_ns && !e->alive_arm(alive_period_ns))
+		return socket_lost();
+
+	st = CONNECTED;
+	++stats.connected;
+	down_end();
+
+	return true;
+}
+
+bool jslink::alive_timeout()
+{
+	if (st != CONNECTED)
+		return true;
+
+	uint64_t idle = e->now_ns() - alive_tx_ns;
+
+	// traffic went out meanwhile, wait for the rest of the period since then
+	if (idle < alive_period_ns)
+		return e->alive_arm(alive_period_ns - idle);
+
+	e->socket_alive();
+	++stats.alives;
+
+	alive_tx_ns = e->now_ns();
+
+	return e->alive_arm(alive_period_ns);
+}
+
+void jslink::transmitted()
+{
+	if (alive_period_ns)
+		alive_tx_ns = e->now_ns();
+}
+
+bool jslink::socket_lost()
+{
+	e->alive_disarm();
+	e->socket_close();
+
+	if (st != CONNECTING && st != CONNECTED)
+		return true;
+
+	if (st == CONNECTED)
+		down_since = e->now_ns();
+
+	++stats.socket_losses;
+
+	return monitor_server();
+}
+
+bool jslink::joystick_lost()
+{
+	e->alive_disarm();
+	e->socket_close();
+	e->joystick_close();
+
+	if (st == JOYSTICK_WAIT)
+		return true;
+
+	if (st != CONNECTED)
+		down_end();
+
+	++stats.device_losses;
+
+	return monitor_joystick();
+}
+
+jslink::state jslink::get_state() const
+{
+	return st;
+}
+
+const jslink_stats &jslink::get_stats() const
+{
+	return stats;
+}
+
+bool jslink::monitor_joystick()
+{
+	st = JOYSTICK_WAIT;
+
+	return e->timer_arm(joystick_period_ns, true);
+}
+
+bool jslink::monitor_server()
+{
+	st = SERVER_WAIT;
+
+	return e->timer_arm(server_period_ns, false);
+}
+
+void jslink::down_end()
+{
+	uint64_t down = e->now_ns() - down_since;
+
+	stats.down_ns += down;
+
+	if (down > stats.down_max_ns)
+		stats.down_max_ns = down;
+}
@@ -0,0 +1,191 @@
+#include "jslog.h"
+
+#include <time.h>
+#include <stdarg.h>
+
+#include <new>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#define DBG_PREFIX "jslog: "
+
+#define DRAIN_PERIOD_US 2000u
+
+/// @brief Formatted line waiting for the logging thread.
+struct jslog_record
+{
+	uint8_t level;
+	uint8_t len;
+	char    text[JSLOG_LINE_LEN];
+};
+
+static jslog_level           log_level = JSLOG_INFO;
+static jslog_record         *ring;
+static size_t                ring_mask;
+static std::atomic<size_t>   ring_head;     // written by producer only
+static std::atomic<size_t>   ring_tail;     // written by logging thread only
+static std::atomic<uint64_t> dropped;
+static std::atomic<bool>     running;
+static std::thread           drainer;
+
+static void write_line(uint8_t level, const char *text, size_t len)
+{
+	FILE *f = level <= JSLOG_WARN ? stderr : stdout;
+
+	fwrite(text, 1, len, f);
+	fputc('\n', f);
+}
+
+static bool drain()
+{
+	size_t tail = ring_tail.load(std::memory_order_relaxed);
+	size_t head = ring_head.load(std::memory_order_acquire);
+
+	if (tail == head)
+		return false;
+
+	for (; tail != head; ++tail) {
+		const jslog_record &rec = ring[tail & ring_mask];
+		write_line(rec.level, rec.text, rec.len);
+	}
+
+	// slots are handed back only after their text was copied out
+	ring_tail.store(tail, std::memory_order_release);
+
+	fflush(stdout);
+	fflush(stderr);
+
+	return true;
+}
+
+static void drain_loop()
+{
+	uint64_t        reported = 0;
+	struct timespec ts;
+
+	ts.tv_sec  = 0;
+	ts.tv_nsec = DRAIN_PERIOD_US * 1000L;
+
+	// polls instead of being woken up, so producer never makes a syscall
+	for (;;) {
+		bool last = !running.load(std::memory_order_acquire);
+
+		if (!drain() && !last)
+			nanosleep(&ts, NULL);
+
+		uint64_t d = dropped.load(std::memory_order_relaxed);
+
+		if (d != reported) {
+			fprintf(stderr, DBG_PREFIX"%" PRIu64 " lines dropped\n", d - reported);
+			reported = d;
+		}
+
+		if (last)
+			break;
+	}
+}
+
+bool jslog_init(size_t slots)
+{
+	jslog_cleanup();
+
+	size_t len = 1;
+
+	while (len < slots)
+		len <<= 1;
+
+	ring = new (std::nothrow) jslog_record[len];
+	if (!ring) {
+		std::cerr << DBG_PREFIX"allocating ring failed" << std::endl;
+		return false;
+	}
+
+	ring_mask = len - 1;
+	ring_head.store(0, std::memory_order_relaxed);
+	ring_tail.store(0, std::memory_order_relaxed);
+	dropped.store(0, std::memory_order_relaxed);
+	running.store(true, std::memory_order_release);
+
+	try {
+		drainer = std::thread(drain_loop);
+	} catch (...) {
+		std::cerr << DBG_PREFIX"starting logging thread failed" << std::endl;
+		running.store(false, std::memory_order_relaxed);
+		delete[] ring;
+		ring = 0;
+		return false;
+	}
+
+	return true;
+}
+
+void jslog_cleanup()
+{
+	if (!ring)
+		return;
+
+	running.store(false, std::memory_order_release);
+	drainer.join();
+
+	delete[] ring;
+	ring = 0;
+}
+
+void jslog_set_level(jslog_level level)
+{
+	log_level = level;
+}
+
+bool jslog_enabled(jslog_level level)
+{
+	return level <= log_level;
+}
+
+void jslog(jslog_level level, const char *fmt, ...)
+{
+	if (level > log_level)
+		return;
+
+	va_list args;
+	va_start(args, fmt);
+
+	if (!ring) {
+		char text[JSLOG_LINE_LEN];
+		int  len = vsnprintf(text, sizeof text, fmt, args);
+
+		if (len > 0) {
+			write_line(level, text, (size_t) len < sizeof text ? len : sizeof text - 1);
+			fflush(level <= JSLOG_WARN ? stderr : stdout);
+		}
+
+		va_end(args);
+		return;
+	}
+
+	size_t head = ring_head.load(std::memory_order_relaxed);
+
+	if (head - ring_tail.load(std::memory_order_acquire) > ring_mask) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		va_end(args);
+		return;
+	}
+
+	jslog_record &rec = ring[head & ring_mask];
+	int           len = vsnprintf(rec.text, sizeof rec.text, fmt, args);
+
+	va_end(args);
+
+	rec.level = level;
+	rec.len   = len < 0 ? 0 : (size_t) len < sizeof rec.text ? len : sizeof rec.text - 1;
+
+	ring_head.store(head + 1, std::memory_order_release);
+}
+
+uint64_t jslog_dropped()
+{
+	return dropped.load(std::memory_order_relaxed);
+}
+
@@ -0,0 +1,207 @@
+#include "jslowlat.h"
+#include "jsclock.h"
+
+#include <poll.h>
+#include <sched.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#define DBG_PREFIX "jslowlat: "
+
+#define DEFAULT_SPIN_US      200u
+#define DEFAULT_BUSYPOLL_US  50u
+
+jslowlat::jslowlat(struct epoller *epoller) : fdepoller(epoller), efd(-1), spins(0), hits(0), blocks(0)
+{
+	memset(&cfg, 0, sizeof cfg);
+	cfg.cpu = -1;
+}
+
+jslowlat::~jslowlat()
+{
+	cleanup();
+}
+
+bool jslowlat::parse(jslowlat_cfg *cfg, const char *str)
+{
+	enum { OPT_CPU, OPT_FIFO, OPT_SPIN, OPT_BUSYPOLL };
+	static char *const tokens[] = {(char *) "cpu", (char *) "fifo", (char *) "spin", (char *) "busypoll", NULL};
+
+	cfg->cpu         = -1;
+	cfg->fifo        = 0;
+	cfg->spin_us     = DEFAULT_SPIN_US;
+	cfg->busypoll_us = DEFAULT_BUSYPOLL_US;
+
+	if (!str)
+		return true;
+
+	// getsubopt modifies its input
+	char  buff[strlen(str) + 1];
+	char *opts = buff;
+	char *value;
+
+	strcpy(buff, str);
+
+	while (*opts) {
+		int opt = getsubopt(&opts, tokens, &value);
+
+		if (opt < 0) {
+			std::cerr << DBG_PREFIX"unknown suboption " << value << std::endl;
+			return false;
+		}
+
+		if (!value) {
+			std::cerr << DBG_PREFIX"suboption " << tokens[opt] << " needs a value" << std::endl;
+			return false;
+		}
+
+		switch (opt) {
+			case OPT_CPU:
+				cfg->cpu = atoi(value);
+				break;
+			case OPT_FIFO:
+				cfg->fifo = atoi(value);
+				break;
+			case OPT_SPIN:
+				cfg->spin_us = strtoul(value, NULL, 10);
+				break;
+			case OPT_BUSYPOLL:
+				cfg->busypoll_us = strtoul(value, NULL, 10);
+				break;
+		}
+	}
+
+	return true;
+}
+
+bool jslowlat::init(const jslowlat_cfg *cfg)
+{
+	this->cfg = *cfg;
+
+	if (cfg->cpu >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(cfg->cpu, &set);
+
+		if (sched_setaffinity(0, sizeof set, &set)) {
+			std::cerr << DBG_PREFIX"pinning to cpu " << cfg->cpu << " failed: " << strerror(errno) << std::endl;
+			return false;
+		}
+	}
+
+	if (cfg->fifo > 0) {
+		struct sched_param param;
+
+		memset(&param, 0, sizeof param);
+		param.sched_priority = cfg->fifo;
+
+		if (sched_setscheduler(0, SCHED_FIFO, &param)) {
+			std::cerr << DBG_PREFIX"setting SCHED_FIFO failed: " << strerror(errno) << std::endl;
+			return false;
+		}
+	}
+
+	if (!cfg->spin_us)
+		return true;
+
+	// counter is never read back to zero by the loop, so the eventfd stays readable
+	efd = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (efd == -1) {
+		std::cerr << DBG_PREFIX"creating eventfd failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	if (!fdepoller::init(efd, EPOLLIN)) {
+		std::cerr << DBG_PREFIX"watching eventfd failed" << std::endl;
+		close(efd);
+		efd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+void jslowlat::cleanup()
+{
+	if (efd == -1)
+		return;
+
+	fdepoller::cleanup();
+	close(efd);
+	efd = -1;
+}
+
+bool jslowlat::setup_socket(int fd)
+{
+	int val = cfg.busypoll_us;
+
+	if (!val)
+		return true;
+
+	if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof val)) {
+		std::cerr << DBG_PREFIX"setting SO_BUSY_POLL failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void jslowlat::print_stats()
+{
+	std::cout << "lowlat: " << spins << " spins, " << hits << " events caught spinning, " << blocks << " blocks" << std::endl;
+}
+
+int jslowlat::in()
+{
+	struct pollfd pfd;
+	uint64_t      val;
+	uint64_t      deadline = jsclock_ns() + cfg.spin_us * 1000ULL;
+
+	pfd.fd     = epoller->fd;
+	pfd.events = POLLIN;
+
+	// make ourselves not ready, so epoller descriptor shows only the others
+	if (read(efd, &val, sizeof val) != sizeof val) {
+		std::cerr << DBG_PREFIX"reading eventfd failed" << std::endl;
+		return -1;
+	}
+
+	++spins;
+
+	for (;;) {
+		if (poll(&pfd, 1, 0) > 0) {
+			++hits;
+			break;
+		}
+
+		if (jsclock_ns() >= deadline) {
+			++blocks;
+
+			// nothing came in time, sleep as the loop would do
+			if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+				std::cerr << DBG_PREFIX"polling epoller failed: " << strerror(errno) << std::endl;
+				return -1;
+			}
+
+			break;
+		}
+	}
+
+	val = 1;
+
+	if (write(efd, &val, sizeof val) != sizeof val) {
+		std::cerr << DBG_PREFIX"writing eventfd failed" << std::endl;
+		return -1;
+	}
+
+	return 0;
+}
+
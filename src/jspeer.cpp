@@ -1,13 +1,21 @@
 #include "jspeer.h"
-#include <iostream>
-
-#define SOCKET_RX_BUFF_LEN JS_MESSAGE_LENGTH_MAX
-#define SOCKET_TX_BUFF_LEN JS_MESSAGE_LENGTH_MAX
+#include "jsclock.h"
+#include "jslog.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <linux/joystick.h>
+#include <cstring>
+#include <new>
 
 #define DBG_PREFIX "jspeer: "
 
-jspeer::jspeer(struct epoller *epoller) : sockepoller(epoller)
+jspeer::jspeer(struct epoller *epoller) : sockepoller(epoller), rcvr(0), rx_buff_len(JSPEER_RX_BUFF_LEN), tx_buff_len(JSPEER_TX_BUFF_LEN), rx_ring_len(JSPEER_RX_RING_LEN), rx_ring_resize(false), tmr(epoller, this), requests_cnt(0), request_id(0), rtt(0), rx_bytes(0), session_id(0), session_seq(0), session_acked(0), parked_id(0), parked_seq(0), parked_ns(0), meta(0), meta_axes(0), meta_buttons(0), predictor(0), tracer(0), shaper(0), wheel(0), idle(this), idle_ms(0), idle_cfg_ms(0), idle_rx_tick(0), keepalive_ms(0), evlog(0), evlog_stream(-1), shm(0), shm_slot(0), sub_rates_cnt(0), subscribed(false)
+#ifdef JSREMOTE_IO_URING
+                                          , uring(0), uring_rx_armed(false)
+#endif
 {
+	// longest name a response can carry, so caching it never reallocates
+	meta_name.reserve(UINT8_MAX);
 }
 
 jspeer::jspeer() : jspeer(0)
@@ -17,19 +25,150 @@ jspeer::jspeer() : jspeer(0)
 jspeer::~jspeer()
 {
 	cleanup();
+	delete predictor;
 }
 
 bool jspeer::init(int fd)
 {
-	if (!sockepoller::init(fd, SOCKET_RX_BUFF_LEN, SOCKET_TX_BUFF_LEN, true, false, true))
+#ifdef JSREMOTE_IO_URING
+	// completions of the previous connection would be taken for this one's
+	if (uring_rx_armed) {
+		jslog(JSLOG_ERROR, DBG_PREFIX"io_uring receive of previous connection still pending");
+		return false;
+	}
+#endif
+
+	// ring of other length was set meanwhile
+	if (rx_ring_resize) {
+		rxring.cleanup();
+		rx_ring_resize = false;
+	}
+
+	if (!rxring.is_initialized() && !rxring.init(rx_ring_len))
 		return false;
 
+	rxring.clear();
+
+	if (!tmr.init())
+		return false;
+
+	tmr._timerhandler = &jspeer::timerhandler;
+	requests_cnt = 0;
+
+	// legacy until remote says hello
+	proto.version    = 0;
+	proto.encodings  = JS_ENCODING_SINGLE;
+	proto.max_length = JS_MESSAGE_LENGTH_MAX;
+
+	rtt      = 0;
+	rx_bytes = 0;
+	meta     = 0;
+	meta_name.clear();
+
+	// nothing is counted until this remote opens its session, state of the
+	// previous one stays parked until it resumes or the time to live passes
+	session_id    = 0;
+	session_seq   = 0;
+	session_acked = 0;
+
+	if (parked_id && jsclock_ns() - parked_ns > JSPEER_SESSION_TTL_MS * 1000000ULL)
+		parked_id = 0;
+
+	memset(axes, 0, sizeof axes);
+	memset(buttons, 0, sizeof buttons);
+
+	if (predictor)
+		predictor->reset();
+
+	if (!sockepoller::init(fd, rx_buff_len, tx_buff_len, true, false, true)) {
+		tmr.cleanup();
+		return false;
+	}
+
+	// configured timeout until remote announces its keepalive
+	keepalive_ms = 0;
+	idle_ms      = idle_cfg_ms;
+
+	if (wheel && idle_ms) {
+		idle_rx_tick = wheel->get_tick();
+		wheel->add(&idle, idle_ms);
+	}
+
+	// name belongs to one remote, it is set again for the next one
+	if (evlog && !evlog_name.empty() && (evlog_stream = evlog->open(evlog_name)) < 0)
+		jslog(JSLOG_WARN, DBG_PREFIX"no free event log stream for %s", evlog_name.c_str());
+
+	if (shm)
+		shm->peer_open(shm_slot, axes, buttons);
+
+	return true;
+}
+
+#ifdef JSREMOTE_IO_URING
+bool jspeer::init(int fd, jsuring *uring)
+{
+	if (!init(fd))
+		return false;
+
+	if (!disable_rx() || !uring->recv(fd, this)) {
+		jslog(JSLOG_ERROR, DBG_PREFIX"switching reception to io_uring failed");
+		cleanup();
+		return false;
+	}
+
+	this->uring    = uring;
+	uring_rx_armed = true;
+
+	if (!uring->submit()) {
+		jslog(JSLOG_ERROR, DBG_PREFIX"switching reception to io_uring failed");
+		cleanup();
+		return false;
+	}
+
 	return true;
 }
+#endif
 
 void jspeer::cleanup()
 {
+#ifdef JSREMOTE_IO_URING
+	// receive keeps the peer busy until its last completion arrives,
+	// shutdown ends it with end of stream if it cannot be cancelled
+	if (uring && is_initialized() && uring_rx_armed && !uring->cancel(this)) {
+		jslog(JSLOG_ERROR, DBG_PREFIX"cancelling io_uring receive failed, shutting socket down");
+		shutdown(fd, SHUT_RDWR);
+	}
+	uring = 0;
+#endif
+
+	if (is_initialized()) {
+		if (session_id) {
+			parked_id  = session_id;
+			parked_seq = session_seq;
+			parked_ns  = jsclock_ns();
+
+			memcpy(parked_axes, axes, sizeof axes);
+			memcpy(parked_buttons, buttons, sizeof buttons);
+		}
+
+		session_id = 0;
+
+		if (shm)
+			shm->peer_close(shm_slot);
+	}
+
 	sockepoller::cleanup();
+	tmr.cleanup();
+	rxring.clear();
+	requests_cnt = 0;
+
+	if (wheel)
+		wheel->remove(&idle);
+
+	if (evlog && evlog_stream >= 0)
+		evlog->close(evlog_stream);
+	evlog_stream = -1;
+	evlog_name.clear();
 }
 
 bool jspeer::is_initialized()
@@ -37,6 +176,15 @@ bool jspeer::is_initialized()
 	return fd != -1;
 }
 
+bool jspeer::is_draining()
+{
+#ifdef JSREMOTE_IO_URING
+	return !is_initialized() && uring_rx_armed;
+#else
+	return false;
+#endif
+}
+
 int jspeer::get_fd()
 {
 	return fd;
@@ -49,106 +197,712 @@ void jspeer::set_receiver(jspeer::receiver *rcvr)
 
 bool jspeer::get_axes()
 {
-	uint8_t buff[sizeof(jsmessage)];
-	jsmessage *msg  = (jsmessage *) buff;
+	uint8_t buff[JSCODEC_REQUEST_LEN];
+	return write_datagram(buff, jscodec_put_request(buff, JS_COMMAND_GETAXES, 0));
+}
 
-	msg->length  = sizeof buff;
-	msg->command = JS_COMMAND_GETAXES;
+bool jspeer::get_buttons()
+{
+	uint8_t buff[JSCODEC_REQUEST_LEN];
+	return write_datagram(buff, jscodec_put_request(buff, JS_COMMAND_GETBUTTONS, 0));
+}
 
-	return write_datagram((void *)buff, sizeof buff);
+bool jspeer::get_name()
+{
+	uint8_t buff[JSCODEC_REQUEST_LEN];
+	return write_datagram(buff, jscodec_put_request(buff, JS_COMMAND_GETNAME, 0));
 }
 
-bool jspeer::get_buttons()
+bool jspeer::query(const uint8_t *commands, uint16_t *ids, size_t n, uint32_t timeout_ms)
 {
-	uint8_t buff[sizeof(jsmessage)];
-	jsmessage *msg  = (jsmessage *) buff;
+	// tagged requests are all the same length, rows are back to back
+	uint8_t  buff[JSPEER_REQUESTS_MAX][JSCODEC_REQUEST_LEN];
+	uint64_t now      = jsclock_ns();
+	uint64_t deadline = timeout_ms ? now + timeout_ms * 1000000ULL : 0;
 
-	msg->length  = sizeof buff;
-	msg->command = JS_COMMAND_GETBUTTONS;
+	if (n > JSPEER_REQUESTS_MAX - requests_cnt) {
+		jslog(JSLOG_ERROR, DBG_PREFIX"too many outstanding requests");
+		return false;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		jsc_request req;
+
+		req.id = request_id + i;
+		jscodec_put_request(buff[i], commands[i], &req);
+	}
+
+	if (!write_datagram((void *)buff, n * JSCODEC_REQUEST_LEN))
+		return false;
+
+	for (size_t i = 0; i < n; ++i) {
+		jspeer::request &req = requests[requests_cnt++];
+
+		req.id       = request_id++;
+		req.command  = commands[i];
+		req.sent     = now;
+		req.deadline = deadline;
+
+		if (ids)
+			ids[i] = req.id;
+	}
 
-	return write_datagram((void *)buff, sizeof buff);
+	request_arm();
+
+	return true;
 }
 
-bool jspeer::get_name()
+bool jspeer::get_axes(uint16_t *id, uint32_t timeout_ms)
 {
-	uint8_t buff[sizeof(jsmessage)];
-	jsmessage *msg  = (jsmessage *) buff;
+	const uint8_t command = JS_COMMAND_GETAXES;
+	return query(&command, id, 1, timeout_ms);
+}
 
-	msg->length  = sizeof buff;
-	msg->command = JS_COMMAND_GETNAME;
+bool jspeer::get_buttons(uint16_t *id, uint32_t timeout_ms)
+{
+	const uint8_t command = JS_COMMAND_GETBUTTONS;
+	return query(&command, id, 1, timeout_ms);
+}
 
-	return write_datagram((void *)buff, sizeof buff);
+bool jspeer::get_name(uint16_t *id, uint32_t timeout_ms)
+{
+	const uint8_t command = JS_COMMAND_GETNAME;
+	return query(&command, id, 1, timeout_ms);
 }
 
-int jspeer::rx(int len)
+uint8_t jspeer::get_cached()
 {
-	if (len < 0) {
-		std::cerr << DBG_PREFIX"socket error" << std::endl;
+	return meta;
+}
 
-		if (rcvr)
-			rcvr->error(this);
+int jspeer::get_cached_axes()
+{
+	return meta & JSPEER_META_AXES ? meta_axes : -1;
+}
 
-	} else if (len == 0) {
+int jspeer::get_cached_buttons()
+{
+	return meta & JSPEER_META_BUTTONS ? meta_buttons : -1;
+}
+
+const std::string *jspeer::get_cached_name()
+{
+	return meta & JSPEER_META_NAME ? &meta_name : 0;
+}
+
+const jsc_hello *jspeer::get_protocol()
+{
+	return &proto;
+}
+
+uint64_t jspeer::get_rtt()
+{
+	return rtt;
+}
+
+uint16_t jspeer::get_keepalive_ms()
+{
+	return keepalive_ms;
+}
+
+int16_t jspeer::get_axis(uint8_t number)
+{
+	return axes[number];
+}
+
+bool jspeer::get_button(uint8_t number)
+{
+	return buttons[number];
+}
+
+bool jspeer::set_prediction(bool enable)
+{
+	if (!enable) {
+		delete predictor;
+		predictor = 0;
+		return true;
+	}
+
+	if (!predictor) {
+		predictor = new (std::nothrow) jspredictor();
+		if (!predictor)
+			return false;
+		predictor->set_rtt(rtt);
+	}
+
+	return true;
+}
+
+jspredictor *jspeer::get_predictor()
+{
+	return predictor;
+}
+
+int16_t jspeer::get_predicted_axis(uint8_t number)
+{
+	int16_t value = axes[number];
+
+	// axis without a sample since reset keeps its last received value
+	if (predictor)
+		predictor->predict(number, jsclock_ns(), &value);
+
+	return value;
+}
+
+void jspeer::set_shaper(const jsshaper *shaper)
+{
+	this->shaper = shaper;
+}
+
+int16_t jspeer::get_shaped_axis(uint8_t number)
+{
+	if (!shaper)
+		return axes[number];
+
+	return shaper->apply(number, axes[number]);
+}
+
+size_t jspeer::get_shaped_axes(int16_t *out)
+{
+	size_t n = (meta & JSPEER_META_AXES) ? meta_axes : JSPEER_AXES_MAX;
+
+	if (shaper)
+		shaper->apply(axes, out, n);
+	else
+		memcpy(out, axes, n * sizeof *axes);
+
+	return n;
+}
+
+void jspeer::set_tracer(jstrace *tracer)
+{
+	this->tracer = tracer;
+
+	if (tracer)
+		tracer->set_rtt(rtt);
+}
+
+bool jspeer::set_idle_timeout(jswheel *wheel, uint32_t timeout_ms)
+{
+	if (this->wheel)
+		this->wheel->remove(&idle);
+
+	this->wheel = timeout_ms ? wheel : 0;
+	idle_cfg_ms = timeout_ms;
+	idle_ms     = keepalive_ms ? keepalive_ms * JSPEER_KEEPALIVE_MISSES : timeout_ms;
+
+	if (!this->wheel || !is_initialized())
+		return true;
+
+	idle_rx_tick = this->wheel->get_tick();
+
+	return this->wheel->add(&idle, idle_ms);
+}
+
+bool jspeer::set_event_log(jsevlog *evlog, const std::string &name)
+{
+	if (this->evlog && evlog_stream >= 0)
+		this->evlog->close(evlog_stream);
+
+	this->evlog  = evlog;
+	evlog_name   = name;
+	evlog_stream = -1;
 
+	if (!evlog || !is_initialized())
+		return true;
+
+	return (evlog_stream = evlog->open(name)) >= 0;
+}
+
+void jspeer::set_shm(jsshm *shm, size_t slot)
+{
+	if (this->shm && is_initialized())
+		this->shm->peer_close(shm_slot);
+
+	this->shm = shm;
+	shm_slot  = slot;
+
+	if (!shm || !is_initialized())
+		return;
+
+	shm->peer_open(slot, axes, buttons);
+	shm_meta();
+}
+
+bool jspeer::subscribe(const jsc_subscribe *sub, const jsc_rate *rates, size_t cnt)
+{
+	if (cnt > JSPEER_AXES_MAX)
+		cnt = JSPEER_AXES_MAX;
+
+	// everything is what remote sends without filter, it's reset by pushing it
+	if (sub)
+		subscription = *sub;
+	else
+		memset(&subscription, 0xFF, sizeof subscription);
+
+	if (cnt)
+		memcpy(sub_rates, rates, cnt * sizeof *rates);
+
+	sub_rates_cnt = cnt;
+	subscribed    = sub || subscribed;
+
+	if (!is_initialized() || !(proto.encodings & JS_ENCODING_SUBSCRIBE))
+		return true;
+
+	return subscribe_send();
+}
+
+size_t jspeer::get_pending()
+{
+	return requests_cnt;
+}
+
+uint64_t jspeer::get_rx_bytes()
+{
+	return rx_bytes;
+}
+
+bool jspeer::set_buffers(size_t rx_len, size_t tx_len, size_t ring_len)
+{
+	if (rx_len < JS_MESSAGE_LENGTH_MAX || tx_len < JS_MESSAGE_LENGTH_MAX || ring_len < JS_MESSAGE_LENGTH_MAX) {
+		jslog(JSLOG_ERROR, DBG_PREFIX"buffers shorter than %u bytes", JS_MESSAGE_LENGTH_MAX);
+		return false;
+	}
+
+	rx_buff_len = rx_len;
+	tx_buff_len = tx_len;
+
+	if (ring_len != rx_ring_len) {
+		rx_ring_len    = ring_len;
+		rx_ring_resize = true;
+	}
+
+	return true;
+}
+
+size_t jspeer::get_memory()
+{
+	// socket buffers exist while initialized, the ring is kept for the next remote
+	return sizeof *this + meta_name.capacity() + evlog_name.capacity() + rxring.size() +
+	       (is_initialized() ? rx_buff_len + tx_buff_len : 0);
+}
+
+void jspeer::event(const jsc_event *ev, const jsc_trace *trace, uint64_t decode_ns)
+{
+	uint8_t type = ev->type & ~JS_EVENT_INIT;
+
+	if (type == JS_EVENT_AXIS)
+		axes[ev->number] = ev->value;
+	else if (type == JS_EVENT_BUTTON)
+		buttons[ev->number] = ev->value != 0;
+
+	if (predictor)
+		predictor->update(ev, jsclock_ns());
+
+	if (evlog_stream >= 0)
+		evlog->append(evlog_stream, ev, jsclock_realtime_ns());
+
+	if (shm)
+		shm->peer_event(shm_slot, ev);
+
+	if (session_id && ++session_seq - session_acked >= JSPEER_ACK_EVENTS)
+		session_ack();
+
+	if (!tracer) {
 		if (rcvr)
-			rcvr->disconnected(this);
+			rcvr->event(this, ev);
+		return;
+	}
 
-	} else {
+	uint64_t deliver_ns = jsclock_ns();
+
+	if (rcvr)
+		rcvr->event(this, ev);
+
+	// receiver may have unset the tracer
+	if (tracer)
+		tracer->record(ev, trace, decode_ns, deliver_ns, jsclock_ns());
+}
+
+void jspeer::hello(const jsc_hello *remote)
+{
+	uint8_t   buff[JSCODEC_HELLO_LEN];
+	jsc_hello local;
+
+	local.version    = JS_PROTOCOL_VERSION;
+	local.encodings  = JS_ENCODING_SINGLE | JS_ENCODING_BATCH | JS_ENCODING_SESSION | JS_ENCODING_SUBSCRIBE | (tracer ? JS_ENCODING_TRACE : 0);
+	local.max_length = rxring.size() < UINT16_MAX ? rxring.size() : UINT16_MAX;
+
+	jshello_negotiate(&proto, &local, remote);
+
+	if (!write_datagram(buff, jscodec_put_hello(buff, &local)))
+		return;
+
+	// right behind hello response, so remote filters its state resync already
+	if (subscribed && !subscribe_send())
+		return;
+
+	if (rcvr)
+		rcvr->hello(this, &proto);
+}
+
+void jspeer::session_ack()
+{
+	uint8_t     buff[JSCODEC_SESSION_LEN];
+	jsc_session data;
+
+	data.id  = session_id;
+	data.seq = session_seq;
+
+	if (write_datagram(buff, jscodec_put_session(buff, JS_COMMAND_ACK, &data)))
+		session_acked = session_seq;
+}
+
+void jspeer::shm_meta()
+{
+	if (shm)
+		shm->peer_meta(shm_slot, meta, meta_axes, meta_buttons, meta_name);
+}
+
+bool jspeer::subscribe_send()
+{
+	uint8_t buff[JSCODEC_SUBSCRIBE_LEN];
+
+	return write_datagram(buff, jscodec_put_subscribe(buff, &subscription, sub_rates, sub_rates_cnt));
+}
+
+void jspeer::request_remove(size_t i)
+{
+	// keep issue order, untagged responses are matched by it
+	for (--requests_cnt; i < requests_cnt; ++i)
+		requests[i] = requests[i + 1];
+}
+
+bool jspeer::request_done(uint16_t id)
+{
+	for (size_t i = 0; i < requests_cnt; ++i) {
+		if (requests[i].id == id) {
+			rtt = jsclock_ns() - requests[i].sent;
 
-		while (linbuff_tord(&rxbuff)) {
+			if (predictor)
+				predictor->set_rtt(rtt);
 
-			if (linbuff_tord(&rxbuff) < sizeof(jsmessage))
-				break;
+			if (tracer)
+				tracer->set_rtt(rtt);
 
-			jsmessage *msg = (jsmessage *)LINBUFF_RD_PTR(&rxbuff);
+			request_remove(i);
+			return true;
+		}
+	}
 
-			if (linbuff_tord(&rxbuff) < msg->length)
-				break;
+	// unknown or already timed out
+	return false;
+}
 
-			if (msg->command == JS_COMMAND_EVENT) {
+void jspeer::request_untagged(uint8_t command)
+{
+	// versioned peer tags its replies, untagged frames are its own pushes
+	// (metadata after hello) and must not complete a tagged request
+	if (proto.version)
+		return;
+
+	// legacy peer ignores request ids but answers in order
+	for (size_t i = 0; i < requests_cnt; ++i) {
+		if (requests[i].command == command) {
+			request_remove(i);
+			return;
+		}
+	}
+}
 
-				jsc_event *data = (jsc_event *) msg->data;
+void jspeer::request_arm()
+{
+	uint64_t deadline = 0;
 
-				if (rcvr)
-					rcvr->event(this, data);
+	for (size_t i = 0; i < requests_cnt; ++i)
+		if (requests[i].deadline && (!deadline || requests[i].deadline < deadline))
+			deadline = requests[i].deadline;
 
-			} else if (msg->command == JS_COMMAND_ALIVE) {
+	if (!deadline) {
+		tmr.disarm();
+		return;
+	}
 
-				if (rcvr)
-					rcvr->alive(this);
+	uint64_t now = jsclock_ns();
+	struct timespec ts;
 
-			} else if (msg->command == (JS_COMMAND_GETAXES | JS_RESPONSE)) {
+	// zero timespec would disarm the timer
+	if (!tmr.arm_oneshot(jsclock_ns2timespec(&ts, deadline > now ? deadline - now : 1)))
+		jslog(JSLOG_ERROR, DBG_PREFIX"arming request timer failed");
+}
 
-				jsr_getaxes *data = (jsr_getaxes *) msg->data;
+void jspeer::idler::expired()
+{
+	jspeer  *jsp  = owner;
+	uint64_t idle = (jsp->wheel->get_tick() - jsp->idle_rx_tick) * jsp->wheel->get_tick_ms();
 
-				if (rcvr)
-					rcvr->axes(this, data->number);
+	// received meanwhile, wait for the rest of the timeout since then
+	if (idle < jsp->idle_ms) {
+		jsp->wheel->add(this, jsp->idle_ms - idle);
+		return;
+	}
 
-			} else if (msg->command == (JS_COMMAND_GETBUTTONS | JS_RESPONSE)) {
+	jslog(JSLOG_WARN, DBG_PREFIX"idle for %" PRIu64 " ms", idle);
 
-				jsr_getbuttons *data = (jsr_getbuttons *) msg->data;
+	if (jsp->rcvr)
+		jsp->rcvr->idle(jsp);
+}
+
+int jspeer::timerhandler(timepoller &sender, uint64_t exp)
+{
+	jspeer  *jsp = static_cast<jspeer::timer &>(sender).owner;
+	uint64_t now = jsclock_ns();
 
-				if (rcvr)
-					rcvr->buttons(this, data->number);
+	for (size_t i = 0; i < jsp->requests_cnt;) {
 
-			} else if (msg->command == (JS_COMMAND_GETNAME | JS_RESPONSE)) {
+		jspeer::request req = jsp->requests[i];
 
-				jsr_getname *data = (jsr_getname *) msg->data;
+		if (!req.deadline || req.deadline > now) {
+			++i;
+			continue;
+		}
+
+		jsp->request_remove(i);
 
-				if (rcvr)
-					rcvr->name(this, std::string((char *)data->name, data->length));
+		if (jsp->rcvr)
+			jsp->rcvr->timeout(jsp, req.id, req.command);
 
-			} else {
-				std::cerr << DBG_PREFIX"unknown command" << std::endl;
+		// receiver may have cleaned up the peer
+		if (!jsp->is_initialized())
+			return 0;
+	}
 
-				if (rcvr)
-					rcvr->error(this);
-			}
+	jsp->request_arm();
 
-			linbuff_skip(&rxbuff, msg->length);
+	return 0;
+}
+
+void jspeer::decoder::on_event(const jsc_event *ev, const jsc_trace *trace)
+{
+	jsp->event(ev, trace, decode_ns);
+}
+
+void jspeer::decoder::on_events(const jsc_event *evs, size_t cnt)
+{
+	for (size_t i = 0; i < cnt && jsp->is_initialized(); ++i)
+		jsp->event(&evs[i], 0, decode_ns);
+}
+
+void jspeer::decoder::on_alive(const jsc_hello *hello, const jsc_keepalive *keepalive)
+{
+	// remote sends alive only on idle link, so anything received proves it alive
+	if (keepalive && keepalive->period_ms) {
+		jsp->keepalive_ms = keepalive->period_ms;
+
+		if (jsp->wheel) {
+			jsp->idle_ms = keepalive->period_ms * JSPEER_KEEPALIVE_MISSES;
+			jsp->wheel->add(&jsp->idle, jsp->idle_ms);
 		}
+	}
+
+	// alive carrying capabilities opens the handshake
+	if (hello)
+		jsp->hello(hello);
+
+	// idle link, ack the tail that didn't fill a whole ack period
+	if (jsp->session_id && jsp->session_acked != jsp->session_seq && jsp->is_initialized())
+		jsp->session_ack();
+
+	if (jsp->rcvr && jsp->is_initialized())
+		jsp->rcvr->alive(jsp);
+}
 
+void jspeer::decoder::on_axes(uint8_t number, const jsc_request *req)
+{
+	jsp->meta      |= JSPEER_META_AXES;
+	jsp->meta_axes  = number;
+	jsp->shm_meta();
+
+	if (!req) {
+		jsp->request_untagged(JS_COMMAND_GETAXES);
+		if (jsp->rcvr)
+			jsp->rcvr->axes(jsp, number);
+	} else if (jsp->request_done(req->id) && jsp->rcvr)
+		jsp->rcvr->reply_axes(jsp, req->id, number);
+}
+
+void jspeer::decoder::on_buttons(uint8_t number, const jsc_request *req)
+{
+	jsp->meta         |= JSPEER_META_BUTTONS;
+	jsp->meta_buttons  = number;
+	jsp->shm_meta();
+
+	if (!req) {
+		jsp->request_untagged(JS_COMMAND_GETBUTTONS);
+		if (jsp->rcvr)
+			jsp->rcvr->buttons(jsp, number);
+	} else if (jsp->request_done(req->id) && jsp->rcvr)
+		jsp->rcvr->reply_buttons(jsp, req->id, number);
+}
+
+void jspeer::decoder::on_name(const char *name, size_t len, const jsc_request *req)
+{
+	// capacity is kept across reconnects, so the name is copied without allocating
+	jsp->meta |= JSPEER_META_NAME;
+	jsp->meta_name.assign(name, len);
+	jsp->shm_meta();
+
+	if (!req) {
+		jsp->request_untagged(JS_COMMAND_GETNAME);
+		if (jsp->rcvr)
+			jsp->rcvr->name(jsp, jsp->meta_name);
+	} else if (jsp->request_done(req->id) && jsp->rcvr)
+		jsp->rcvr->reply_name(jsp, req->id, jsp->meta_name);
+}
+
+void jspeer::decoder::on_session(const jsc_session *session)
+{
+	uint8_t     buff[JSCODEC_SESSION_LEN];
+	jsc_session data;
+	bool        resumed = session->id && (session->id == jsp->session_id || session->id == jsp->parked_id);
+
+	// acks are sent only to remotes which negotiated them
+	if (!(jsp->proto.encodings & JS_ENCODING_SESSION)) {
+		jslog(JSLOG_WARN, DBG_PREFIX"session without negotiated session encoding ignored");
+		return;
+	}
+
+	if (resumed && session->id != jsp->session_id) {
+		jsp->session_id  = jsp->parked_id;
+		jsp->session_seq = jsp->parked_seq;
+
+		memcpy(jsp->axes, jsp->parked_axes, sizeof jsp->axes);
+		memcpy(jsp->buttons, jsp->parked_buttons, sizeof jsp->buttons);
+
+	// unknown or expired session starts from scratch, full state follows
+	} else if (!resumed) {
+		jsp->session_id  = session->id;
+		jsp->session_seq = 0;
+
+		memset(jsp->axes, 0, sizeof jsp->axes);
+		memset(jsp->buttons, 0, sizeof jsp->buttons);
+	}
+
+	// parked state is taken over or superseded
+	jsp->parked_id = 0;
+
+	if (jsp->predictor)
+		jsp->predictor->reset();
+
+	if (jsp->shm)
+		jsp->shm->peer_state(jsp->shm_slot, jsp->axes, jsp->buttons);
+
+	jsp->session_acked = jsp->session_seq;
+
+	data.id  = jsp->session_id;
+	data.seq = jsp->session_seq;
+
+	if (!jsp->write_datagram(buff, jscodec_put_session(buff, JS_COMMAND_SESSION | JS_RESPONSE, &data)))
+		return;
+
+	if (jsp->rcvr)
+		jsp->rcvr->session(jsp, jsp->session_id, resumed);
+}
+
+void jspeer::decoder::on_unknown(const jsmessage *msg)
+{
+	// skipped, newer peers may send commands we don't know yet
+	jslog(JSLOG_WARN, DBG_PREFIX"unknown command %d", (int) msg->command);
+}
+
+bool jspeer::parse()
+{
+	const jsmessage *msg;
+	jscodec_result   res;
+	jspeer::decoder  dec(this);
+
+	// lazy touch, the wheel entry is checked against it on expiry
+	if (wheel)
+		idle_rx_tick = wheel->get_tick();
+
+	while ((res = jscodec_frame(rxring.rd_ptr(), rxring.tord(), rxring.size(), &msg)) == JSCODEC_OK) {
+
+		dec.decode_ns = tracer ? jsclock_ns() : 0;
+
+		if (!jscodec_dispatch(dec, msg)) {
+			res = JSCODEC_INVALID;
+			break;
+		}
+
+		// receiver may have cleaned up the peer
+		if (!is_initialized())
+			return false;
+
+		rxring.skip(msg->length);
+	}
+
+	if (res == JSCODEC_INVALID) {
+		jslog(JSLOG_ERROR, DBG_PREFIX"malformed message");
+
+		if (rcvr)
+			rcvr->error(this);
+
+		return false;
+	}
+
+	return true;
+}
+
+int jspeer::rx(int len)
+{
+	if (len < 0) {
+		jslog(JSLOG_ERROR, DBG_PREFIX"socket error");
+
+		if (rcvr)
+			rcvr->error(this);
+
+	} else if (len == 0) {
+
+		if (rcvr)
+			rcvr->disconnected(this);
+
+	} else {
+
+		// hand over what sockepoller has already read and drain the rest
+		// of the socket straight into the ring, frames are always contiguous there
+		bool   eof = false;
+		size_t n   = linbuff_tord(&rxbuff);
+
+		if (rxring.write(LINBUFF_RD_PTR(&rxbuff), n) != n) {
+			jslog(JSLOG_ERROR, DBG_PREFIX"rx ring overflow");
+
+			if (rcvr)
+				rcvr->error(this);
+
+			return 0;
+		}
+
+		linbuff_skip(&rxbuff, n);
 		linbuff_compact(&rxbuff);
+
+		ssize_t filled = rxring.fill(fd, &eof);
+
+		if (filled < 0) {
+			jslog(JSLOG_ERROR, DBG_PREFIX"socket error");
+
+			if (rcvr)
+				rcvr->error(this);
+
+			return 0;
+		}
+
+		rx_bytes += n + filled;
+
+		if (!parse())
+			return 0;
+
+		if (eof && rcvr)
+			rcvr->disconnected(this);
 	}
 
 	return 0;
@@ -157,13 +911,13 @@ int jspeer::rx(int len)
 int jspeer::tx(int len)
 {
 	if (len < 0) {
-		std::cerr << "socket error" << std::endl;
+		jslog(JSLOG_ERROR, "socket error");
 
 		if (rcvr)
 			rcvr->error(this);
 
 	} else if (len == 0) {
-		std::cerr << "socket unexpected error" << std::endl;
+		jslog(JSLOG_ERROR, "socket unexpected error");
 
 		if (rcvr)
 			rcvr->error(this);
@@ -177,7 +931,7 @@ int jspeer::tx(int len)
 
 int jspeer::hup()
 {
-	std::cerr << DBG_PREFIX"hup" << std::endl;
+	jslog(JSLOG_ERROR, DBG_PREFIX"hup");
 
 	if (rcvr)
 		rcvr->error(this);
@@ -187,7 +941,7 @@ int jspeer::hup()
 
 int jspeer::err()
 {
-	std::cerr << DBG_PREFIX"err" << std::endl;
+	jslog(JSLOG_ERROR, DBG_PREFIX"err");
 
 	if (rcvr)
 		rcvr->error(this);
@@ -200,18 +954,71 @@ bool jspeer::write_datagram(const void *buff, size_t len)
 	ssize_t ret = sockepoller::write_dgram(buff, len);
 
 	if (ret < 0) {
-		std::cerr << "writing datagram to socket failed, unknown error" << std::endl;
+		jslog(JSLOG_ERROR, "writing datagram to socket failed, unknown error");
 		return false;
 
 	} else if (ret == 0) {
-		std::cerr << "writing datagram to socket failed, not enough space" << std::endl;
+		jslog(JSLOG_ERROR, "writing datagram to socket failed, not enough space");
 		return false;
 
 	} else if ((size_t)ret != len) {
-		std::cerr << "writing datagram to socket failed, unexpected error" << std::endl;
+		jslog(JSLOG_ERROR, "writing datagram to socket failed, unexpected error");
 		return false;
 
 	} else
 		return true;
 }
 
+#ifdef JSREMOTE_IO_URING
+void jspeer::uring_recv(jsuring *ur, const uint8_t *data, int len)
+{
+	// multishot receive is over with its first completion carrying no data
+	if (len <= 0)
+		uring_rx_armed = false;
+
+	// late completions of a cancelled receive
+	if (!is_initialized() || ur != uring || len == -ECANCELED)
+		return;
+
+	if (len == -ENOBUFS) {
+		if (!uring->recv(fd, this)) {
+			if (rcvr)
+				rcvr->error(this);
+			return;
+		}
+
+		uring_rx_armed = true;
+
+		if (!uring->submit()) {
+			if (rcvr)
+				rcvr->error(this);
+		}
+
+	} else if (len < 0) {
+		jslog(JSLOG_ERROR, DBG_PREFIX"socket error");
+
+		if (rcvr)
+			rcvr->error(this);
+
+	} else if (len == 0) {
+
+		if (rcvr)
+			rcvr->disconnected(this);
+
+	} else {
+
+		if (rxring.write(data, len) != (size_t) len) {
+			jslog(JSLOG_ERROR, DBG_PREFIX"rx ring overflow");
+
+			if (rcvr)
+				rcvr->error(this);
+
+			return;
+		}
+
+		rx_bytes += len;
+
+		parse();
+	}
+}
+#endif
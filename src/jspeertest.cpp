@@ -1,52 +1,70 @@
 #include "jspeer.h"
+#include "jsclock.h"
+#include "jslowlat.h"
 
 #include <epoller/epoller.h>
 #include <epoller/sigepoller.h>
+#include <epoller/timepoller.h>
 #include <epoller/tcpsepoller.h>
 
 #include <getopt.h>
 #include <unistd.h>
+#include <arpa/inet.h>
+#include <linux/joystick.h>
 
+#include <vector>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <csignal>
 
 ////////////////////////////////////////////////////////////////////////////////
 // macros
 ////////////////////////////////////////////////////////////////////////////////
 
+#define QUERY_TIMEOUT_MS 1000u
+#define TRACE_SPANS      (64u * 1024u)
+#define URING_ENTRIES    256u
+#define URING_BUFS       64u
+#define URING_BUF_LEN    4096u
+#define PEERS_MAX        4096u
+#define IDLE_TICK_MS     100u
+#define EVLOG_QUEUE_LEN  (64u * 1024u)
+
 ////////////////////////////////////////////////////////////////////////////////
 // types
 ////////////////////////////////////////////////////////////////////////////////
 
+/// @brief Peer counters of headless mode, interval ones are cleared by every summary.
+struct jsp_stats
+{
+	uint64_t events;
+	uint64_t bytes;
+	uint64_t alives;
+	uint64_t errors;
+	uint64_t gap_ns;       ///< longest local time between two events
+	uint64_t last_ns;      ///< local time of last event, zero if none
+	uint64_t bytes_seen;   ///< rx bytes of peer already counted
+	uint32_t last_time[JSPEER_BUTTONS_MAX + JSPEER_AXES_MAX];  ///< remote time of last live event per control, buttons first
+	bool     timed[JSPEER_BUTTONS_MAX + JSPEER_AXES_MAX];      ///< last_time is valid
+};
+
 class jsp_receiver : public jspeer::receiver
 {
 public:
-	virtual void disconnected(jspeer *jsp)
-	{
-		std::cout << "peer disconnected" << std::endl;
-		int fd = jsp->get_fd();
-		jsp->cleanup();
-		close(fd);
-	};
+	jsp_stats stats;
 
-	virtual void error(jspeer *jsp)
-	{
-		std::cout << "peer error" << std::endl;
-		int fd = jsp->get_fd();
-		jsp->cleanup();
-		close(fd);
-	};
+	jsp_receiver() { reset(); }
 
-	virtual void event(jspeer *jsp, const jsc_event *ev)
-	{
-		printf("peer event: %10u, %6d, %02X, %02d\n", ev->time, ev->value, ev->type, ev->number);
-	};
+	void reset();
+	void collect(jspeer *jsp);
+	void validate(jspeer *jsp, const jsc_event *ev);
 
-	virtual void alive(jspeer *jsp)
-	{
-		std::cout << "alive" << std::endl;
-	};
+	virtual void disconnected(jspeer *jsp);
+	virtual void error(jspeer *jsp);
+	virtual void event(jspeer *jsp, const jsc_event *ev);
+	virtual void alive(jspeer *jsp);
+	virtual void idle(jspeer *jsp);
 
 	virtual void axes(jspeer *jsp, uint8_t axes)
 	{
@@ -62,6 +80,22 @@ public:
 	{
 		std::cout << "peer name: " << name << std::endl;
 	};
+
+	virtual void hello(jspeer *jsp, const jsc_hello *proto)
+	{
+		std::cout << "peer protocol: version " << (int) proto->version << ", encodings " << (int) proto->encodings
+		          << ", max length " << proto->max_length << std::endl;
+	};
+
+	virtual void session(jspeer *jsp, uint32_t id, bool resumed)
+	{
+		std::cout << "peer session " << id << (resumed ? " resumed" : " opened") << std::endl;
+	};
+
+	virtual void timeout(jspeer *jsp, uint16_t id, uint8_t command)
+	{
+		std::cout << "peer request " << id << " (command " << (int) command << ") timed out" << std::endl;
+	};
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -71,18 +105,67 @@ public:
 static epoller      epoller;
 static sigepoller   sc(&epoller);
 static tcpsepoller  jss(&epoller);
-static jspeer       jsp(&epoller);
-static jsp_receiver jspr;
+static timepoller   summary(&epoller);
+static jswheel      wheel(&epoller);
+static jslowlat     lowlat(&epoller);
+#ifdef JSREMOTE_IO_URING
+static jsuring      uring(&epoller);
+static bool         uring_enabled;
+#endif
 
 static std::string  server_addr;
 static uint16_t     server_port;
-
-static const char* const short_opts = "ha:p:";
+static bool         predict;
+static jsshaper     shaper;
+static bool         shaping;
+static jstrace      tracer;
+static std::string  trace_file;
+static bool         lowlat_enabled;
+static jslowlat_cfg lowlat_cfg;
+static size_t       peers_max = 1;
+static uint32_t     headless_ms;
+static bool         validating;
+static uint32_t     idle_ms;
+static jsevlog      evlog;
+static std::string  evlog_dir;
+static jsshm        shm;
+static std::string  shm_name;
+static jsc_subscribe filter;
+static jsc_rate     filter_rates[JSPEER_AXES_MAX];
+static size_t       filter_rates_cnt;
+static bool         filtering;
+static size_t       rx_buff_len = JSPEER_RX_BUFF_LEN;
+static size_t       tx_buff_len = JSPEER_TX_BUFF_LEN;
+static size_t       rx_ring_len = JSPEER_RX_RING_LEN;
+
+// one receiver per peer slot, slots are reused by following clients
+static std::vector<jspeer *>      peers;
+static std::vector<jsp_receiver>  receivers;
+
+// totals over whole run
+static uint64_t     total_events;
+static uint64_t     total_bytes;
+static uint64_t     total_errors;
+
+static const char* const short_opts = "ha:p:PS:T:L::un:H:VI:E:M:F:B:";
 
 static const struct option long_opts[] = {
 	{"help",      0, NULL, 'h'},
 	{"addr",      1, NULL, 'a'},
 	{"port",      1, NULL, 'p'},
+	{"predict",   0, NULL, 'P'},
+	{"shape",     1, NULL, 'S'},
+	{"trace",     1, NULL, 'T'},
+	{"lowlat",    2, NULL, 'L'},
+	{"uring",     0, NULL, 'u'},
+	{"peers",     1, NULL, 'n'},
+	{"headless",  1, NULL, 'H'},
+	{"validate",  0, NULL, 'V'},
+	{"idle",      1, NULL, 'I'},
+	{"evlog",     1, NULL, 'E'},
+	{"shm",       1, NULL, 'M'},
+	{"filter",    1, NULL, 'F'},
+	{"buffers",   1, NULL, 'B'},
 	{ NULL,       0, NULL,  0 }
 };
 
@@ -91,8 +174,14 @@ static const struct option long_opts[] = {
 ////////////////////////////////////////////////////////////////////////////////
 
 static void print_help();
+static bool parse_list(uint8_t *map, const char *str);
+static bool parse_filter(const char *str);
+static bool parse_buffers(const char *str);
+static void print_summary(uint64_t interval_ns);
+static void peers_cleanup();
 
 static int sighandler(struct sigepoller *sc, struct signalfd_siginfo *siginfo);
+static int summaryhandler(timepoller &sender, uint64_t exp);
 static int jssacc(struct tcpsepoller *tcpsepoller, int fd, const struct sockaddr *addr, const socklen_t *addrlen);
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -105,9 +194,235 @@ static void print_help()
 	std::cout << "  -h  --help            print this help"                                        << std::endl;
 	std::cout << "  -a  --addr <address>  ip address to listen on (leave empty to listen on any)" << std::endl;
 	std::cout << "  -p  --port <port>     tcp port to listen on"                                  << std::endl;
+	std::cout << "  -P  --predict         print predicted axis positions"                         << std::endl;
+	std::cout << "  -S  --shape <opts>    shape all axes, opts: min=<n>,center=<n>,max=<n>,"      << std::endl;
+	std::cout << "                        deadzone=<0..1>,expo=<0..1>"                            << std::endl;
+	std::cout << "  -T  --trace <file>    trace delivery stages, print histograms and write"      << std::endl;
+	std::cout << "                        chrome/perfetto trace file on exit"                     << std::endl;
+	std::cout << "  -L  --lowlat[=<opts>] low-latency mode, opts: cpu=<n>,fifo=<prio>,"           << std::endl;
+	std::cout << "                        spin=<us>,busypoll=<us>"                                << std::endl;
+#ifdef JSREMOTE_IO_URING
+	std::cout << "  -u  --uring           receive through io_uring"                               << std::endl;
+#endif
+	std::cout << "  -n  --peers <n>       number of concurrent peers, default 1"                  << std::endl;
+	std::cout << "  -H  --headless <ms>   don't print events, print per peer counters every <ms>" << std::endl;
+	std::cout << "  -V  --validate        check that remote event times don't go backwards per"   << std::endl;
+	std::cout << "                        control and events fit the announced axes and buttons"  << std::endl;
+	std::cout << "  -I  --idle <ms>       close peers which send nothing for <ms>, or for three"  << std::endl;
+	std::cout << "                        keepalive periods announced by remote in its hello"     << std::endl;
+	std::cout << "  -E  --evlog <dir>     append received events to per remote <ip>-<port>.evlog" << std::endl;
+	std::cout << "                        files in <dir>"                                         << std::endl;
+	std::cout << "  -M  --shm <name>      publish peer state in shared memory <name> (e.g."       << std::endl;
+	std::cout << "                        /jsremote), one slot per peer"                          << std::endl;
+	std::cout << "  -F  --filter <opts>   subscribe only some controls, opts: axes=<list>,"       << std::endl;
+	std::cout << "                        buttons=<list>,rate=<hz>, list e.g. 0-3:6"              << std::endl;
+	std::cout << "  -B  --buffers <opts>  per peer buffer lengths, opts: rx=<n>,tx=<n>,ring=<n>"  << std::endl;
+	std::cout << "                        in bytes, ring bounds frame length offered to remote"   << std::endl;
 	std::cout << std::endl;
 }
 
+static bool parse_list(uint8_t *map, const char *str)
+{
+	memset(map, 0, JS_SUBSCRIBE_MAP_LEN);
+
+	// numbers and ranges separated by colons, commas separate suboptions
+	while (*str) {
+		char         *end;
+		unsigned long first = strtoul(str, &end, 10);
+		unsigned long last  = first;
+
+		if (end == str)
+			return false;
+
+		if (*end == '-') {
+			str  = end + 1;
+			last = strtoul(str, &end, 10);
+			if (end == str)
+				return false;
+		}
+
+		if (first > last || last > UINT8_MAX || (*end && *end != ':'))
+			return false;
+
+		for (unsigned long i = first; i <= last; ++i)
+			map[i / 8] |= 1u << (i % 8);
+
+		str = *end ? end + 1 : end;
+	}
+
+	return true;
+}
+
+static bool parse_filter(const char *str)
+{
+	enum { OPT_AXES, OPT_BUTTONS, OPT_RATE };
+	static char *const tokens[] = {(char *) "axes", (char *) "buttons", (char *) "rate", NULL};
+
+	// getsubopt modifies its input
+	char          buff[strlen(str) + 1];
+	char         *opts = buff;
+	char         *value;
+	unsigned long rate = 0;
+
+	strcpy(buff, str);
+	memset(&filter, 0xFF, sizeof filter);
+
+	while (*opts) {
+		int opt = getsubopt(&opts, tokens, &value);
+
+		if (opt < 0) {
+			std::cerr << "unknown filter suboption " << value << std::endl;
+			return false;
+		}
+
+		if (!value) {
+			std::cerr << "filter suboption " << tokens[opt] << " needs a value" << std::endl;
+			return false;
+		}
+
+		bool ok = true;
+
+		switch (opt) {
+			case OPT_AXES:
+				ok = parse_list(filter.axes, value);
+				break;
+			case OPT_BUTTONS:
+				ok = parse_list(filter.buttons, value);
+				break;
+			case OPT_RATE:
+				rate = strtoul(value, NULL, 10);
+				ok   = rate && rate <= UINT16_MAX;
+				break;
+		}
+
+		if (!ok) {
+			std::cerr << "invalid filter suboption " << tokens[opt] << std::endl;
+			return false;
+		}
+	}
+
+	filter_rates_cnt = 0;
+
+	for (size_t i = 0; rate && i < JSPEER_AXES_MAX; ++i) {
+		if (filter.axes[i / 8] & (1u << (i % 8))) {
+			filter_rates[filter_rates_cnt].number = i;
+			filter_rates[filter_rates_cnt].max_hz = rate;
+			++filter_rates_cnt;
+		}
+	}
+
+	return true;
+}
+
+static bool parse_buffers(const char *str)
+{
+	enum { OPT_RX, OPT_TX, OPT_RING };
+	static char *const tokens[] = {(char *) "rx", (char *) "tx", (char *) "ring", NULL};
+
+	// getsubopt modifies its input
+	char  buff[strlen(str) + 1];
+	char *opts = buff;
+	char *value;
+
+	strcpy(buff, str);
+
+	while (*opts) {
+		int opt = getsubopt(&opts, tokens, &value);
+
+		if (opt < 0) {
+			std::cerr << "unknown buffers suboption " << value << std::endl;
+			return false;
+		}
+
+		if (!value) {
+			std::cerr << "buffers suboption " << tokens[opt] << " needs a value" << std::endl;
+			return false;
+		}
+
+		size_t len = strtoul(value, NULL, 10);
+
+		if (len < JS_MESSAGE_LENGTH_MAX) {
+			std::cerr << "buffers suboption " << tokens[opt] << " shorter than " << JS_MESSAGE_LENGTH_MAX << std::endl;
+			return false;
+		}
+
+		switch (opt) {
+			case OPT_RX:
+				rx_buff_len = len;
+				break;
+			case OPT_TX:
+				tx_buff_len = len;
+				break;
+			case OPT_RING:
+				rx_ring_len = len;
+				break;
+		}
+	}
+
+	return true;
+}
+
+static void print_summary(uint64_t interval_ns)
+{
+	uint64_t events = 0;
+	uint64_t bytes  = 0;
+	uint64_t errors = 0;
+	size_t   active = 0;
+	size_t   memory = 0;
+	char     line[160];
+
+	for (size_t i = 0; i < peers.size(); ++i) {
+
+		jsp_stats &st = receivers[i].stats;
+
+		memory += peers[i]->get_memory();
+
+		if (!peers[i]->is_initialized() && !st.events && !st.bytes)
+			continue;
+
+		receivers[i].collect(peers[i]);
+
+		snprintf(line, sizeof line, "peer %3zu: %8.0f ev/s, %10.0f B/s, max gap %7.1f ms, alive %3" PRIu64 ", errors %" PRIu64 "\n",
+		         i, st.events * 1e9 / interval_ns, st.bytes * 1e9 / interval_ns, st.gap_ns / 1e6, st.alives, st.errors);
+		std::cout << line;
+
+		events += st.events;
+		bytes  += st.bytes;
+		errors += st.errors;
+		active += peers[i]->is_initialized();
+
+		st.events = 0;
+		st.bytes  = 0;
+		st.alives = 0;
+		st.errors = 0;
+		st.gap_ns = 0;
+	}
+
+	snprintf(line, sizeof line, "all %3zu peers: %8.0f ev/s, %10.0f B/s, errors %" PRIu64 ", memory %zu kB\n",
+	         active, events * 1e9 / interval_ns, bytes * 1e9 / interval_ns, errors, memory / 1024);
+
+	// one flush per summary
+	std::cout << line << std::flush;
+}
+
+static void peers_cleanup()
+{
+	for (size_t i = 0; i < peers.size(); ++i) {
+		if (peers[i]->is_initialized()) {
+			receivers[i].collect(peers[i]);
+
+			int fd = peers[i]->get_fd();
+			peers[i]->cleanup();
+			close(fd);
+		}
+
+		delete peers[i];
+	}
+
+	peers.clear();
+	receivers.clear();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // handlers
 ////////////////////////////////////////////////////////////////////////////////
@@ -140,6 +455,132 @@ static int sighandler(sigepoller &sender, struct signalfd_siginfo *siginfo)
 	}
 }
 
+void jsp_receiver::reset()
+{
+	memset(&stats, 0, sizeof stats);
+}
+
+void jsp_receiver::collect(jspeer *jsp)
+{
+	uint64_t bytes = jsp->get_rx_bytes() - stats.bytes_seen;
+
+	stats.bytes      += bytes;
+	stats.bytes_seen += bytes;
+	total_bytes      += bytes;
+}
+
+void jsp_receiver::validate(jspeer *jsp, const jsc_event *ev)
+{
+	const char *what = 0;
+	uint8_t     type = ev->type & ~JS_EVENT_INIT;
+	int         cnt  = type == JS_EVENT_AXIS ? jsp->get_cached_axes() : jsp->get_cached_buttons();
+
+	if (type != JS_EVENT_AXIS && type != JS_EVENT_BUTTON)
+		what = "unknown type";
+	else if (cnt >= 0 && ev->number >= cnt)
+		what = "number out of range";
+	else if (type == JS_EVENT_BUTTON && ev->value != 0 && ev->value != 1)
+		what = "button value out of range";
+	else if (!(ev->type & JS_EVENT_INIT)) {
+		// init events carry time of the original change, live ones are ordered
+		// per control only (buttons overtake parked axes, rate limited samples
+		// go out late), joystick time is in ms and wraps, so compare as signed difference
+		size_t c = type == JS_EVENT_AXIS ? JSPEER_BUTTONS_MAX + ev->number : ev->number;
+
+		if (stats.timed[c] && (int32_t)(ev->time - stats.last_time[c]) < 0)
+			what = "time went backwards";
+
+		stats.last_time[c] = ev->time;
+		stats.timed[c]     = true;
+	}
+
+	if (!what)
+		return;
+
+	++stats.errors;
+	++total_errors;
+
+	std::cerr << "peer event invalid (" << what << "): " << ev->time << ", " << ev->value << ", "
+	          << (int) ev->type << ", " << (int) ev->number << std::endl;
+}
+
+void jsp_receiver::disconnected(jspeer *jsp)
+{
+	std::cout << "peer disconnected" << std::endl;
+	collect(jsp);
+	int fd = jsp->get_fd();
+	jsp->cleanup();
+	close(fd);
+}
+
+void jsp_receiver::error(jspeer *jsp)
+{
+	std::cout << "peer error" << std::endl;
+	collect(jsp);
+	int fd = jsp->get_fd();
+	jsp->cleanup();
+	close(fd);
+}
+
+void jsp_receiver::event(jspeer *jsp, const jsc_event *ev)
+{
+	if (validating)
+		validate(jsp, ev);
+
+	if (headless_ms) {
+		uint64_t now = jsclock_ns();
+
+		if (stats.last_ns && now - stats.last_ns > stats.gap_ns)
+			stats.gap_ns = now - stats.last_ns;
+
+		stats.last_ns = now;
+		++stats.events;
+		++total_events;
+
+		// consumer view of the whole frame, keeps shaping cost in the measurement
+		if (shaping && (ev->type & ~JS_EVENT_INIT) == JS_EVENT_AXIS) {
+			int16_t frame[JSPEER_AXES_MAX];
+			jsp->get_shaped_axes(frame);
+		}
+
+		return;
+	}
+
+	++total_events;
+
+	if (jsp->get_predictor() && (ev->type & ~JS_EVENT_INIT) == JS_EVENT_AXIS)
+		printf("peer event: %10u, %6d, %02X, %02d, predicted %6d, delay %u ms\n", ev->time, ev->value, ev->type, ev->number,
+		       jsp->get_predicted_axis(ev->number), jsp->get_predictor()->get_delay_ms());
+	else if (shaping && (ev->type & ~JS_EVENT_INIT) == JS_EVENT_AXIS)
+		printf("peer event: %10u, %6d, %02X, %02d, shaped %6d\n", ev->time, ev->value, ev->type, ev->number,
+		       jsp->get_shaped_axis(ev->number));
+	else
+		printf("peer event: %10u, %6d, %02X, %02d\n", ev->time, ev->value, ev->type, ev->number);
+}
+
+void jsp_receiver::idle(jspeer *jsp)
+{
+	std::cout << "peer idle, closed" << std::endl;
+	collect(jsp);
+	int fd = jsp->get_fd();
+	jsp->cleanup();
+	close(fd);
+}
+
+void jsp_receiver::alive(jspeer *jsp)
+{
+	if (headless_ms)
+		++stats.alives;
+	else
+		std::cout << "alive" << std::endl;
+}
+
+static int summaryhandler(timepoller &sender, uint64_t exp)
+{
+	print_summary(exp * headless_ms * 1000000ULL);
+	return 0;
+}
+
 static int jssacc(tcpsepoller &sender, int fd, const struct sockaddr *addr, const socklen_t *addrlen)
 {
 	if (fd < 0) {
@@ -149,25 +590,70 @@ static int jssacc(tcpsepoller &sender, int fd, const struct sockaddr *addr, cons
 
 	std::cout << "client accepted" << std::endl;
 
-	if (jsp.is_initialized()) {
-		std::cout << "initialized peer already exists, client closed" << std::endl;
+	if (lowlat_enabled && !lowlat.setup_socket(fd))
+		std::cerr << "setting socket busy polling failed" << std::endl;
+
+	size_t i = 0;
+
+	while (i < peers.size() && (peers[i]->is_initialized() || peers[i]->is_draining()))
+		++i;
+
+	if (i == peers.size()) {
+		std::cout << "all " << peers.size() << " peers in use, client closed" << std::endl;
 		close(fd);
 		return 0;
 	}
 
+	jspeer &jsp = *peers[i];
+
+#ifdef JSREMOTE_IO_URING
+	if (uring_enabled ? !jsp.init(fd, &uring) : !jsp.init(fd)) {
+#else
 	if (!jsp.init(fd)) {
+#endif
 		std::cerr << "initializing peer failed" << std::endl;
 		close(fd);
 		return 0;
 	}
 
-	jsp.set_receiver(&jspr);
+	// counters left from previous client (collected on its disconnect) are shown by the next summary
+	receivers[i].stats.last_ns    = 0;
+	memset(receivers[i].stats.timed, 0, sizeof receivers[i].stats.timed);
+	receivers[i].stats.bytes_seen = 0;
+
+	jsp.set_receiver(&receivers[i]);
+	if (!jsp.set_prediction(predict))
+		std::cerr << "enabling prediction failed" << std::endl;
+	jsp.set_shaper(shaping ? &shaper : 0);
+	jsp.set_idle_timeout(&wheel, idle_ms);
+
+	if (!evlog_dir.empty()) {
+		const struct sockaddr_in *in = (const struct sockaddr_in *) addr;
+		char                      name[INET_ADDRSTRLEN + 16];
+		char                      ip[INET_ADDRSTRLEN];
+
+		inet_ntop(AF_INET, &in->sin_addr, ip, sizeof ip);
+		snprintf(name, sizeof name, "%s-%u.evlog", ip, ntohs(in->sin_port));
+
+		if (!jsp.set_event_log(&evlog, name))
+			std::cerr << "no free event log stream" << std::endl;
+	}
+
+	jsp.set_shm(shm_name.empty() ? 0 : &shm, i);
+
+	if (filtering)
+		jsp.subscribe(&filter, filter_rates, filter_rates_cnt);
+
+	// clock offset is estimated per remote, so only the first slot is traced
+	jsp.set_tracer(trace_file.empty() || i ? 0 : &tracer);
 
-	std::cout << "peer initialized" << std::endl;
+	std::cout << "peer " << i << " initialized" << std::endl;
 
-	jsp.get_axes();
-	jsp.get_buttons();
-	jsp.get_name();
+	// all metadata queries share one write
+	static const uint8_t query[] = {JS_COMMAND_GETAXES, JS_COMMAND_GETBUTTONS, JS_COMMAND_GETNAME};
+
+	if (!jsp.query(query, NULL, sizeof query, QUERY_TIMEOUT_MS))
+		std::cerr << "querying peer failed" << std::endl;
 
 	return 0;
 }
@@ -181,7 +667,6 @@ int main(int argc, char **argv)
 	bool     err = false;
 	int      next_opt;
 	sigset_t sigset;
-	int      fd;
 
 	// block signals
 	sigemptyset(&sigset);
@@ -206,6 +691,75 @@ int main(int argc, char **argv)
 			case 'p':
 				server_port = atoi(optarg);
 				break;
+			case 'P':
+				predict = true;
+				break;
+			case 'S': {
+				jsshape_axis cfg;
+
+				if (!jsshaper::parse(&cfg, optarg) || !shaper.set_axes(&cfg)) {
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				shaping = true;
+				break;
+			}
+			case 'T':
+				trace_file = optarg;
+				break;
+			case 'L':
+				lowlat_enabled = true;
+				if (!jslowlat::parse(&lowlat_cfg, optarg)) {
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				break;
+#ifdef JSREMOTE_IO_URING
+			case 'u':
+				uring_enabled = true;
+				break;
+#endif
+			case 'n':
+				peers_max = strtoul(optarg, NULL, 10);
+				break;
+			case 'H':
+				headless_ms = strtoul(optarg, NULL, 10);
+				if (!headless_ms) {
+					std::cerr << "invalid headless interval" << std::endl;
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				break;
+			case 'V':
+				validating = true;
+				break;
+			case 'I':
+				idle_ms = strtoul(optarg, NULL, 10);
+				break;
+			case 'E':
+				evlog_dir = optarg;
+				break;
+			case 'M':
+				shm_name = optarg;
+				break;
+			case 'F':
+				if (!parse_filter(optarg)) {
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				filtering = true;
+				break;
+			case 'B':
+				if (!parse_buffers(optarg)) {
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				break;
 			case -1:
 				break;
 			default:
@@ -224,6 +778,22 @@ int main(int argc, char **argv)
 		goto unwind;
 	}
 
+	if (!peers_max || peers_max > PEERS_MAX) {
+		std::cerr << "invalid number of peers" << std::endl;
+		print_help();
+		err = true;
+		goto unwind;
+	}
+
+	if (shaping)
+		std::cout << "shaping axes with " << shaper.get_kernel_name() << " kernel" << std::endl;
+
+	// initialize tracer
+	if (!trace_file.empty() && !tracer.init(TRACE_SPANS)) {
+		err = true;
+		goto unwind;
+	}
+
 	// initialize epoller
 	if (!epoller.init()) {
 		err = true;
@@ -237,10 +807,71 @@ int main(int argc, char **argv)
 	}
 	sc._sighandler = &sighandler;
 
+	// initialize low-latency mode
+	if (lowlat_enabled && !lowlat.init(&lowlat_cfg)) {
+		err = true;
+		goto unwind_sc;
+	}
+
+#ifdef JSREMOTE_IO_URING
+	// initialize io_uring backend
+	if (uring_enabled && !uring.init(URING_ENTRIES, URING_BUFS, URING_BUF_LEN, false)) {
+		err = true;
+		goto unwind_lowlat;
+	}
+#endif
+
+	// initialize summary timer
+	if (!summary.init()) {
+		err = true;
+		goto unwind_uring;
+	}
+	summary._timerhandler = &summaryhandler;
+
+	if (headless_ms) {
+		struct timespec ts;
+
+		ts.tv_sec  = headless_ms / 1000;
+		ts.tv_nsec = (headless_ms % 1000) * 1000000L;
+
+		if (!summary.arm_periodic(&ts)) {
+			std::cerr << "setting summary timer failed" << std::endl;
+			err = true;
+			goto unwind_summary;
+		}
+	}
+
+	// initialize idle timer wheel, shared by all peers
+	if (idle_ms && !wheel.init(IDLE_TICK_MS)) {
+		err = true;
+		goto unwind_summary;
+	}
+
+	// initialize event log, closed streams are freed by the writer later, so
+	// a quickly reused peer slot needs a second one meanwhile
+	if (!evlog_dir.empty() && !evlog.init(evlog_dir, 2 * peers_max, EVLOG_QUEUE_LEN)) {
+		err = true;
+		goto unwind_wheel;
+	}
+
+	// initialize shared memory, one slot per peer slot
+	if (!shm_name.empty() && !shm.init(shm_name, peers_max)) {
+		err = true;
+		goto unwind_evlog;
+	}
+
+	// allocate peer slots
+	receivers.resize(peers_max);
+
+	for (size_t i = 0; i < peers_max; ++i) {
+		peers.push_back(new jspeer(&epoller));
+		peers.back()->set_buffers(rx_buff_len, tx_buff_len, rx_ring_len);
+	}
+
 	// initialize server for jsremote applicatin
 	if (!jss.socket(AF_INET, server_addr, server_port)) {
 		err = true;
-		goto unwind_sc;
+		goto unwind_peers;
 	}
 	jss._acc = &jssacc;
 
@@ -250,13 +881,52 @@ int main(int argc, char **argv)
 
 	// cleanups
 
-	fd = jsp.get_fd();
-	jsp.cleanup();
-	close(fd);
+	peers_cleanup();
+
+	std::cout << "total: " << total_events << " events, " << total_bytes << " bytes";
+	if (validating)
+		std::cout << ", " << total_errors << " invalid";
+	std::cout << std::endl;
+
+	if (validating && total_errors)
+		err = true;
+
+	if (!trace_file.empty()) {
+		tracer.print(std::cout);
+		if (!tracer.export_chrome(trace_file))
+			err = true;
+	}
 
 //unwind_jss:
 	jss.close();
 
+unwind_peers:
+	peers_cleanup();
+
+	shm.cleanup();
+
+unwind_evlog:
+	if (evlog.get_dropped())
+		std::cerr << "event log dropped " << evlog.get_dropped() << " events" << std::endl;
+	evlog.cleanup();
+
+unwind_wheel:
+	wheel.cleanup();
+
+unwind_summary:
+	summary.cleanup();
+
+unwind_uring:
+#ifdef JSREMOTE_IO_URING
+	uring.cleanup();
+
+// reached only from io_uring initialization
+unwind_lowlat:
+#endif
+	if (lowlat_enabled)
+		lowlat.print_stats();
+	lowlat.cleanup();
+
 unwind_sc:
 	sc.cleanup();
 
@@ -0,0 +1,145 @@
+#include "jspredict.h"
+
+#include <linux/joystick.h>
+
+#include <cstring>
+
+#define DEFAULT_ALPHA       0.5f
+#define DEFAULT_BETA        0.1f
+#define DEFAULT_HORIZON_MS  100u
+#define DMIN_WINDOW_NS      (10ULL * 1000000000ULL)
+
+jspredictor::jspredictor() : md(MODE_ALPHABETA), alpha(DEFAULT_ALPHA), beta(DEFAULT_BETA), horizon_ms(DEFAULT_HORIZON_MS), rtt_ns(0)
+{
+	reset();
+}
+
+void jspredictor::reset()
+{
+	dmin_cur      = INT64_MAX;
+	dmin_prev     = INT64_MAX;
+	dmin_start_ns = 0;
+	dlast         = 0;
+
+	memset(axes, 0, sizeof axes);
+}
+
+void jspredictor::set_mode(jspredictor::mode md)
+{
+	this->md = md;
+}
+
+void jspredictor::set_gains(float alpha, float beta)
+{
+	this->alpha = alpha;
+	this->beta  = beta;
+}
+
+void jspredictor::set_horizon(uint32_t horizon_ms)
+{
+	this->horizon_ms = horizon_ms;
+}
+
+void jspredictor::set_rtt(uint64_t rtt_ns)
+{
+	this->rtt_ns = rtt_ns;
+}
+
+void jspredictor::update(const jsc_event *ev, uint64_t rx_ns)
+{
+	// remote clock is a wrapping 32-bit millisecond counter,
+	// so is the local one as far as we care, only modular differences are meaningful
+	int64_t d = (int32_t)((uint32_t)(rx_ns / 1000000ULL) - ev->time);
+
+	if (!dmin_start_ns || rx_ns - dmin_start_ns > DMIN_WINDOW_NS) {
+		dmin_prev     = dmin_cur;
+		dmin_cur      = INT64_MAX;
+		dmin_start_ns = rx_ns;
+	}
+
+	if (d < dmin_cur)
+		dmin_cur = d;
+
+	dlast = d;
+
+	if ((ev->type & ~JS_EVENT_INIT) != JS_EVENT_AXIS)
+		return;
+
+	jspredictor::axis &a = axes[ev->number];
+
+	// init events carry state, not motion
+	if (!a.valid || (ev->type & JS_EVENT_INIT)) {
+		a.x     = ev->value;
+		a.v     = 0;
+		a.t     = ev->time;
+		a.valid = true;
+		return;
+	}
+
+	int32_t dt = (int32_t)(ev->time - a.t);
+
+	if (dt <= 0) {
+		a.x = ev->value;
+		return;
+	}
+
+	if (md == MODE_LINEAR) {
+		a.v = (ev->value - a.x) / dt;
+		a.x = ev->value;
+
+	} else {
+		float xp = a.x + a.v * dt;
+		float r  = ev->value - xp;
+
+		a.x = xp + alpha * r;
+		a.v = a.v + beta * r / dt;
+	}
+
+	a.t = ev->time;
+}
+
+bool jspredictor::predict(uint8_t number, uint64_t now_ns, int16_t *value) const
+{
+	const jspredictor::axis &a = axes[number];
+
+	if (!a.valid)
+		return false;
+
+	// remote time corresponding to now
+	uint32_t remote = (uint32_t)(now_ns / 1000000ULL) - (uint32_t) get_offset_ms();
+	int32_t  dt     = (int32_t)(remote - a.t);
+
+	if (dt < 0)
+		dt = 0;
+	else if ((uint32_t) dt > horizon_ms)
+		dt = horizon_ms;
+
+	float x = a.x + a.v * dt;
+
+	if (x > INT16_MAX)
+		*value = INT16_MAX;
+	else if (x < -INT16_MAX)
+		*value = -INT16_MAX;
+	else
+		*value = (int16_t) x;
+
+	return true;
+}
+
+int64_t jspredictor::get_offset_ms() const
+{
+	int64_t dmin = dmin_cur < dmin_prev ? dmin_cur : dmin_prev;
+
+	if (dmin == INT64_MAX)
+		return 0;
+
+	// fastest sample took about half of the round trip
+	return dmin - (int64_t)(rtt_ns / 2000000ULL);
+}
+
+uint32_t jspredictor::get_delay_ms() const
+{
+	int64_t delay = dlast - get_offset_ms();
+	return delay > 0 ? (uint32_t) delay : 0;
+}
+
@@ -0,0 +1,848 @@
+#include "jspeer.h"
+
+#include <epoller/epoller.h>
+#include <epoller/sigepoller.h>
+#include <epoller/timepoller.h>
+#include <epoller/tcpsepoller.h>
+
+#include <errno.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <linux/joystick.h>
+
+#include <new>
+#include <list>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <iostream>
+
+////////////////////////////////////////////////////////////////////////////////
+// macros
+////////////////////////////////////////////////////////////////////////////////
+
+#define SUBSCRIBER_QUEUE_LEN   256u
+#define SUBSCRIBER_IOV_MAX     64u
+#define SUBSCRIBER_RX_BUFF_LEN JS_MESSAGE_LENGTH_MAX
+#define SUBSCRIBER_TX_BUFF_LEN JS_MESSAGE_LENGTH_MAX
+#define FLUSH_PERIOD_MS        10u
+#define QUERY_TIMEOUT_MS       1000u
+#define FRAME_LEN              JSCODEC_NAME_LEN
+#define SNAPSHOT_NUMBERS       256u
+
+////////////////////////////////////////////////////////////////////////////////
+// types
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Reference counted frame, encoded once and shared by all subscriber queues.
+///        Released frames go back to the pool, so forwarding never touches the heap.
+struct frame
+{
+	unsigned refs;
+	size_t   len;
+	frame   *next;  ///< pool link
+	uint8_t  data[FRAME_LEN];
+};
+
+/// @brief Fixed capacity frame queue, allocated once per subscriber.
+class frame_queue
+{
+private:
+	frame  **ring;
+	size_t   cap;
+	size_t   head;
+	size_t   cnt;
+
+public:
+	frame_queue() : ring(0), cap(0), head(0), cnt(0) {}
+	~frame_queue() { delete[] ring; }
+
+	bool init(size_t cap)
+	{
+		ring      = new (std::nothrow) frame *[cap];
+		this->cap = ring ? cap : 0;
+		return ring != 0;
+	}
+
+	size_t size() const { return cnt; }
+	bool empty() const { return !cnt; }
+	frame *&operator[](size_t i) { return ring[(head + i) % cap]; }
+	frame *front() { return ring[head]; }
+	void pop_front() { head = (head + 1) % cap; --cnt; }
+	void push_back(frame *f) { ring[(head + cnt++) % cap] = f; }
+	void clear() { head = 0; cnt = 0; }
+
+	void erase(size_t i)
+	{
+		for (--cnt; i < cnt; ++i)
+			(*this)[i] = (*this)[i + 1];
+	}
+};
+
+/// @brief Subscriber back-pressure policy.
+enum policy
+{
+	POLICY_DROP,      ///< drop new events while queue is full, resync from snapshot once drained
+	POLICY_COALESCE,  ///< replace queued update of the same axis while backlogged
+};
+
+/// @brief Downstream subscriber, speaks jsremote protocol towards its jspeer.
+class subscriber : public sockepoller
+{
+public:
+	frame_queue         queue;
+	size_t              offset;
+	enum policy         policy;
+	bool                resync;
+	bool                dead;
+	size_t              dropped;
+
+	subscriber(struct epoller *epoller) : sockepoller(epoller), offset(0), policy(POLICY_COALESCE), resync(false), dead(false), dropped(0) {}
+
+private:
+	virtual int rx(int len);
+	virtual int hup();
+	virtual int err();
+};
+
+/// @brief Decoder of frames received from subscriber.
+struct sub_decoder : public jscodec_visitor
+{
+	subscriber *sub;
+
+	sub_decoder(subscriber *sub) : sub(sub) {}
+
+	void on_request(uint8_t command, const jsc_request *req);
+};
+
+class up_receiver : public jspeer::receiver
+{
+public:
+	virtual void disconnected(jspeer *jsp);
+	virtual void error(jspeer *jsp);
+	virtual void event(jspeer *jsp, const jsc_event *ev);
+	virtual void alive(jspeer *jsp) {};
+	virtual void axes(jspeer *jsp, uint8_t axes) {};
+	virtual void buttons(jspeer *jsp, uint8_t buttons) {};
+	virtual void name(jspeer *jsp, const std::string &name) {};
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// variables
+////////////////////////////////////////////////////////////////////////////////
+
+static epoller      epoller;
+static sigepoller   sc(&epoller);
+static timepoller   flusher(&epoller);
+static tcpsepoller  ups(&epoller);
+static tcpsepoller  dns(&epoller);
+static jspeer       up(&epoller);
+static up_receiver  upr;
+
+static std::list<subscriber *> subscribers;
+
+// buttons first, then axes, empty slots have zero type
+static jsc_event    snapshot[2 * SNAPSHOT_NUMBERS];
+
+// frame pool, grown on subscriber accept to cover every queue filled up
+static frame       *frames_free;
+static size_t       frames_cnt;
+
+static std::string  server_addr;
+static uint16_t     up_port;
+static uint16_t     down_port;
+static size_t       queue_len = SUBSCRIBER_QUEUE_LEN;
+static enum policy  queue_policy = POLICY_COALESCE;
+
+static const char* const short_opts = "ha:p:s:q:P:";
+
+static const struct option long_opts[] = {
+	{"help",      0, NULL, 'h'},
+	{"addr",      1, NULL, 'a'},
+	{"port",      1, NULL, 'p'},
+	{"subport",   1, NULL, 's'},
+	{"queue",     1, NULL, 'q'},
+	{"policy",    1, NULL, 'P'},
+	{ NULL,       0, NULL,  0 }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+static bool frames_grow(size_t cnt);
+static void frames_cleanup();
+static frame *frame_alloc(size_t len);
+static frame *frame_ref(frame *f);
+static void frame_unref(frame *f);
+static frame *frame_event(const jsc_event *ev);
+static frame *frame_copy(const uint8_t *data, size_t len);
+static frame *frame_response(uint8_t command, const jsc_request *req);
+static bool frame_is_axis(const frame *f);
+static uint8_t frame_axis(const frame *f);
+
+static void subscriber_push(subscriber *sub, frame *f);
+static void subscriber_push_snapshot(subscriber *sub);
+static void subscriber_flush(subscriber *sub);
+static void subscriber_kill(subscriber *sub);
+static void subscribers_reap();
+
+static void print_help();
+
+static int sighandler(sigepoller &sender, struct signalfd_siginfo *siginfo);
+static int flushhandler(timepoller &sender, uint64_t exp);
+static int upsacc(tcpsepoller &sender, int fd, const struct sockaddr *addr, const socklen_t *addrlen);
+static int dnsacc(tcpsepoller &sender, int fd, const struct sockaddr *addr, const socklen_t *addrlen);
+
+////////////////////////////////////////////////////////////////////////////////
+// aux functions
+////////////////////////////////////////////////////////////////////////////////
+
+static bool frames_grow(size_t cnt)
+{
+	while (frames_cnt < cnt) {
+		frame *f = new (std::nothrow) frame;
+
+		if (!f)
+			return false;
+
+		f->next     = frames_free;
+		frames_free = f;
+		++frames_cnt;
+	}
+
+	return true;
+}
+
+static void frames_cleanup()
+{
+	while (frames_free) {
+		frame *f = frames_free;
+		frames_free = f->next;
+		delete f;
+	}
+
+	frames_cnt = 0;
+}
+
+static frame *frame_alloc(size_t len)
+{
+	// pool covers full queues, so it's empty only if growing it failed
+	if (!frames_free && !frames_grow(frames_cnt + 1))
+		return 0;
+
+	frame *f = frames_free;
+
+	frames_free = f->next;
+	f->refs     = 1;
+	f->len      = len;
+
+	return f;
+}
+
+static frame *frame_ref(frame *f)
+{
+	++f->refs;
+	return f;
+}
+
+static void frame_unref(frame *f)
+{
+	if (--f->refs)
+		return;
+
+	f->next     = frames_free;
+	frames_free = f;
+}
+
+static frame *frame_copy(const uint8_t *data, size_t len)
+{
+	frame *f = frame_alloc(len);
+
+	if (f)
+		memcpy(f->data, data, len);
+
+	return f;
+}
+
+static frame *frame_event(const jsc_event *ev)
+{
+	uint8_t buff[JSCODEC_TEVENT_LEN];
+	return frame_copy(buff, jscodec_put_event(buff, ev, 0));
+}
+
+static frame *frame_response(uint8_t command, const jsc_request *req)
+{
+	uint8_t            buff[JSCODEC_NAME_LEN];
+	const std::string *name = up.get_cached_name();
+
+	// answered from upstream metadata cache, unknown yet reads as empty
+	if (command == JS_COMMAND_GETAXES)
+		return frame_copy(buff, jscodec_put_axes(buff, up.get_cached_axes() < 0 ? 0 : up.get_cached_axes(), req));
+	else if (command == JS_COMMAND_GETBUTTONS)
+		return frame_copy(buff, jscodec_put_buttons(buff, up.get_cached_buttons() < 0 ? 0 : up.get_cached_buttons(), req));
+	else if (command == JS_COMMAND_GETNAME)
+		return frame_copy(buff, jscodec_put_name(buff, name ? name->c_str() : "", name ? name->length() : 0, req));
+	else
+		return 0;
+}
+
+static bool frame_is_axis(const frame *f)
+{
+	const jsmessage *msg = (const jsmessage *) f->data;
+	const jsc_event *ev  = (const jsc_event *) msg->data;
+
+	return msg->command == JS_COMMAND_EVENT && (ev->type & ~JS_EVENT_INIT) == JS_EVENT_AXIS;
+}
+
+static uint8_t frame_axis(const frame *f)
+{
+	return ((const jsc_event *) ((const jsmessage *) f->data)->data)->number;
+}
+
+static void subscriber_push(subscriber *sub, frame *f)
+{
+	if (sub->dead)
+		return;
+
+	if (sub->policy == POLICY_COALESCE && !sub->queue.empty() && frame_is_axis(f)) {
+
+		// the front frame may be partially written already, leave it alone
+		for (size_t i = 1; i < sub->queue.size(); ++i) {
+			if (frame_is_axis(sub->queue[i]) && frame_axis(sub->queue[i]) == frame_axis(f)) {
+				frame_unref(sub->queue[i]);
+				sub->queue[i] = frame_ref(f);
+				return;
+			}
+		}
+	}
+
+	if (sub->queue.size() >= queue_len) {
+
+		if (sub->policy == POLICY_DROP) {
+			++sub->dropped;
+			sub->resync = true;
+			return;
+		}
+
+		// coalescing couldn't keep up, drop the oldest queued axis update
+		for (size_t i = 1; i < sub->queue.size(); ++i) {
+			if (frame_is_axis(sub->queue[i])) {
+				frame_unref(sub->queue[i]);
+				sub->queue.erase(i);
+				++sub->dropped;
+				break;
+			}
+		}
+
+		// nothing but button edges, subscriber is hopelessly behind
+		if (sub->queue.size() >= queue_len) {
+			std::cerr << "subscriber queue overflow, subscriber closed" << std::endl;
+			subscriber_kill(sub);
+			return;
+		}
+	}
+
+	sub->queue.push_back(frame_ref(f));
+}
+
+static void subscriber_push_snapshot(subscriber *sub)
+{
+	for (const jsc_event &ev : snapshot) {
+
+		if (!ev.type)
+			continue;
+
+		frame *f = frame_event(&ev);
+
+		if (!f)
+			break;
+
+		subscriber_push(sub, f);
+		frame_unref(f);
+	}
+}
+
+static void subscriber_flush(subscriber *sub)
+{
+	while (!sub->dead && !sub->queue.empty()) {
+
+		struct iovec  iov[SUBSCRIBER_IOV_MAX];
+		struct msghdr mh;
+		size_t        cnt   = 0;
+		size_t        total = 0;
+		ssize_t       ret;
+
+		for (size_t i = 0; i < sub->queue.size() && cnt < SUBSCRIBER_IOV_MAX; ++i, ++cnt) {
+			iov[cnt].iov_base = sub->queue[i]->data + (i ? 0 : sub->offset);
+			iov[cnt].iov_len  = sub->queue[i]->len  - (i ? 0 : sub->offset);
+			total += iov[cnt].iov_len;
+		}
+
+		memset(&mh, 0, sizeof mh);
+		mh.msg_iov    = iov;
+		mh.msg_iovlen = cnt;
+
+		ret = sendmsg(sub->fd, &mh, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			if (errno != EAGAIN && errno != EWOULDBLOCK) {
+				std::cerr << "subscriber socket error" << std::endl;
+				subscriber_kill(sub);
+			}
+
+			return;
+		}
+
+		// release fully written frames
+		size_t done = ret + sub->offset;
+
+		while (!sub->queue.empty() && done >= sub->queue.front()->len) {
+			done -= sub->queue.front()->len;
+			frame_unref(sub->queue.front());
+			sub->queue.pop_front();
+		}
+
+		sub->offset = done;
+
+		// socket buffer is full, retried from flusher
+		if ((size_t) ret < total)
+			return;
+	}
+
+	// drained after dropping, bring subscriber back in sync
+	if (!sub->dead && sub->resync) {
+		sub->resync = false;
+		subscriber_push_snapshot(sub);
+	}
+}
+
+static void subscriber_kill(subscriber *sub)
+{
+	if (sub->dead)
+		return;
+
+	int fd = sub->fd;
+
+	sub->dead = true;
+	sub->cleanup();
+	close(fd);
+
+	for (size_t i = 0; i < sub->queue.size(); ++i)
+		frame_unref(sub->queue[i]);
+
+	sub->queue.clear();
+	sub->offset = 0;
+
+	std::cout << "subscriber closed, " << sub->dropped << " events dropped" << std::endl;
+}
+
+static void subscribers_reap()
+{
+	for (auto it = subscribers.begin(); it != subscribers.end();) {
+		if ((*it)->dead) {
+			delete *it;
+			it = subscribers.erase(it);
+		} else
+			++it;
+	}
+}
+
+static void print_help()
+{
+	std::cout << "usage: jsrelay [arguments]"                                                                               << std::endl;
+	std::cout << "  -h  --help              print this help"                                                                << std::endl;
+	std::cout << "  -a  --addr <address>    ip address to listen on (leave empty to listen on any)"                         << std::endl;
+	std::cout << "  -p  --port <port>       tcp port to listen on for upstream jsremote"                                    << std::endl;
+	std::cout << "  -s  --subport <port>    tcp port to listen on for subscribers"                                          << std::endl;
+	std::cout << "  -q  --queue <frames>    subscriber queue length (default: " << SUBSCRIBER_QUEUE_LEN << ")"              << std::endl;
+	std::cout << "  -P  --policy <policy>   slow subscriber policy, drop or coalesce (default: coalesce)"                    << std::endl;
+	std::cout << std::endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// handlers
+////////////////////////////////////////////////////////////////////////////////
+
+int subscriber::rx(int len)
+{
+	if (len < 0) {
+		std::cerr << "subscriber socket error" << std::endl;
+		subscriber_kill(this);
+		return 0;
+
+	} else if (len == 0) {
+		subscriber_kill(this);
+		return 0;
+	}
+
+	const jsmessage *msg;
+	jscodec_result   res;
+	sub_decoder      dec(this);
+
+	// anything but metadata requests (hello response, unknown commands) is ignored
+	while ((res = jscodec_frame(LINBUFF_RD_PTR(&rxbuff), linbuff_tord(&rxbuff), SUBSCRIBER_RX_BUFF_LEN, &msg)) == JSCODEC_OK) {
+
+		if (!jscodec_dispatch(dec, msg)) {
+			res = JSCODEC_INVALID;
+			break;
+		}
+
+		if (dead)
+			return 0;
+
+		linbuff_skip(&rxbuff, msg->length);
+	}
+
+	if (res == JSCODEC_INVALID) {
+		std::cerr << "subscriber sent malformed message" << std::endl;
+		subscriber_kill(this);
+		return 0;
+	}
+
+	linbuff_compact(&rxbuff);
+
+	subscriber_flush(this);
+
+	return 0;
+}
+
+void sub_decoder::on_request(uint8_t command, const jsc_request *req)
+{
+	frame *f = frame_response(command, req);
+
+	if (f) {
+		subscriber_push(sub, f);
+		frame_unref(f);
+	}
+}
+
+int subscriber::hup()
+{
+	subscriber_kill(this);
+	return 0;
+}
+
+int subscriber::err()
+{
+	std::cerr << "subscriber error" << std::endl;
+	subscriber_kill(this);
+	return 0;
+}
+
+void up_receiver::disconnected(jspeer *jsp)
+{
+	std::cout << "upstream disconnected" << std::endl;
+	int fd = jsp->get_fd();
+	jsp->cleanup();
+	close(fd);
+	memset(snapshot, 0, sizeof snapshot);
+}
+
+void up_receiver::error(jspeer *jsp)
+{
+	std::cout << "upstream error" << std::endl;
+	int fd = jsp->get_fd();
+	jsp->cleanup();
+	close(fd);
+	memset(snapshot, 0, sizeof snapshot);
+}
+
+void up_receiver::event(jspeer *jsp, const jsc_event *ev)
+{
+	uint8_t type = ev->type & ~JS_EVENT_INIT;
+
+	if (type == JS_EVENT_BUTTON || type == JS_EVENT_AXIS) {
+		jsc_event &init = snapshot[(type == JS_EVENT_AXIS ? SNAPSHOT_NUMBERS : 0) + ev->number];
+
+		init       = *ev;
+		init.type |= JS_EVENT_INIT;
+	}
+
+	// encode once, share among all subscribers
+	frame *f = frame_event(ev);
+
+	if (!f) {
+		std::cerr << "allocating frame failed" << std::endl;
+		return;
+	}
+
+	for (subscriber *sub : subscribers) {
+		subscriber_push(sub, f);
+		subscriber_flush(sub);
+	}
+
+	frame_unref(f);
+}
+
+static int sighandler(sigepoller &sender, struct signalfd_siginfo *siginfo)
+{
+	std::cerr << "received signal ";
+	switch (siginfo->ssi_signo) {
+		case SIGTERM:
+			std::cerr << "SIGTERM" << std::endl;
+			return 1;
+		case SIGINT:
+			std::cerr << "SIGINT" << std::endl;
+			return 1;
+		case SIGQUIT:
+			std::cerr << "SIGQUIT" << std::endl;
+			return 1;
+		case SIGUSR1:
+			std::cerr << "SIGUSR1" << std::endl;
+			return 0;
+		case SIGUSR2:
+			std::cerr << "SIGUSR2" << std::endl;
+			return 0;
+		case SIGPIPE:
+			std::cerr << "SIGPIPE" << std::endl;
+			return 0;
+		default:
+			std::cerr << "<unknown>" << std::endl;
+			return 0;
+	}
+}
+
+static int flushhandler(timepoller &sender, uint64_t exp)
+{
+	for (subscriber *sub : subscribers)
+		subscriber_flush(sub);
+
+	subscribers_reap();
+
+	return 0;
+}
+
+static int upsacc(tcpsepoller &sender, int fd, const struct sockaddr *addr, const socklen_t *addrlen)
+{
+	if (fd < 0) {
+		std::cout << "upstream accepting failed" << std::endl;
+		return 0;
+	}
+
+	if (up.is_initialized()) {
+		std::cout << "upstream already exists, client closed" << std::endl;
+		close(fd);
+		return 0;
+	}
+
+	if (!up.init(fd)) {
+		std::cerr << "initializing upstream failed" << std::endl;
+		close(fd);
+		return 0;
+	}
+
+	up.set_receiver(&upr);
+
+	std::cout << "upstream connected" << std::endl;
+
+	static const uint8_t query[] = {JS_COMMAND_GETAXES, JS_COMMAND_GETBUTTONS, JS_COMMAND_GETNAME};
+
+	if (!up.query(query, NULL, sizeof query, QUERY_TIMEOUT_MS))
+		std::cerr << "querying upstream failed" << std::endl;
+
+	return 0;
+}
+
+static int dnsacc(tcpsepoller &sender, int fd, const struct sockaddr *addr, const socklen_t *addrlen)
+{
+	if (fd < 0) {
+		std::cout << "subscriber accepting failed" << std::endl;
+		return 0;
+	}
+
+	subscriber *sub = new subscriber(&epoller);
+
+	// every queue may fill up with distinct frames, plus the one being encoded
+	if (!sub->queue.init(queue_len) || !frames_grow((subscribers.size() + 1) * queue_len + 1)) {
+		std::cerr << "allocating subscriber queue failed" << std::endl;
+		delete sub;
+		close(fd);
+		return 0;
+	}
+
+	if (!sub->init(fd, SUBSCRIBER_RX_BUFF_LEN, SUBSCRIBER_TX_BUFF_LEN, true, false, true)) {
+		std::cerr << "initializing subscriber failed" << std::endl;
+		delete sub;
+		close(fd);
+		return 0;
+	}
+
+	sub->policy = queue_policy;
+	subscribers.push_back(sub);
+
+	std::cout << "subscriber connected, " << subscribers.size() << " subscribers" << std::endl;
+
+	// late joiner gets current state at once
+	subscriber_push_snapshot(sub);
+	subscriber_flush(sub);
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	bool     err = false;
+	int      next_opt;
+	sigset_t sigset;
+	int      fd;
+	struct timespec ts;
+
+	// block signals
+	sigemptyset(&sigset);
+	sigaddset(&sigset, SIGTERM);
+	sigaddset(&sigset, SIGINT);
+	sigaddset(&sigset, SIGQUIT);
+	sigaddset(&sigset, SIGUSR1);
+	sigaddset(&sigset, SIGUSR2);
+	sigaddset(&sigset, SIGPIPE);
+	sigprocmask(SIG_BLOCK, &sigset, NULL);
+
+	// parse options
+	do {
+		next_opt = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		switch (next_opt) {
+			case 'h':
+				print_help();
+				goto unwind;
+			case 'a':
+				server_addr = optarg;
+				break;
+			case 'p':
+				up_port = atoi(optarg);
+				break;
+			case 's':
+				down_port = atoi(optarg);
+				break;
+			case 'q':
+				queue_len = strtoul(optarg, NULL, 10);
+				break;
+			case 'P':
+				if (!strcmp(optarg, "drop"))
+					queue_policy = POLICY_DROP;
+				else if (!strcmp(optarg, "coalesce"))
+					queue_policy = POLICY_COALESCE;
+				else {
+					std::cerr << "invalid policy" << std::endl;
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				break;
+			case -1:
+				break;
+			default:
+				std::cerr << "an arguments parsing error encountered" << std::endl;
+				print_help();
+				err = true;
+				goto unwind;
+		}
+	} while (next_opt != -1);
+
+	// check options
+	if (!up_port || !down_port) {
+		std::cerr << "invalid port" << std::endl;
+		print_help();
+		err = true;
+		goto unwind;
+	}
+	if (!queue_len) {
+		std::cerr << "invalid queue length" << std::endl;
+		print_help();
+		err = true;
+		goto unwind;
+	}
+
+	// initialize epoller
+	if (!epoller.init()) {
+		err = true;
+		goto unwind;
+	}
+
+	// initialize signal catcher
+	if (!sc.init(&sigset)) {
+		err = true;
+		goto unwind_epoller;
+	}
+	sc._sighandler = &sighandler;
+
+	// initialize flusher of backlogged subscribers
+	if (!flusher.init()) {
+		err = true;
+		goto unwind_sc;
+	}
+	ts.tv_sec  = 0;
+	ts.tv_nsec = FLUSH_PERIOD_MS * 1000000L;
+	if (!flusher.arm_periodic(&ts)) {
+		err = true;
+		goto unwind_flusher;
+	}
+	flusher._timerhandler = &flushhandler;
+
+	// initialize server for upstream jsremote application
+	if (!ups.socket(AF_INET, server_addr, up_port)) {
+		err = true;
+		goto unwind_flusher;
+	}
+	ups._acc = &upsacc;
+
+	// initialize server for subscribers
+	if (!dns.socket(AF_INET, server_addr, down_port)) {
+		err = true;
+		goto unwind_ups;
+	}
+	dns._acc = &dnsacc;
+
+	// enter the loop
+	std::cout << "waiting for signal... [TERM, INT, QUIT]" << std::endl;
+	err = !epoller.loop();
+
+	// cleanups
+
+	for (subscriber *sub : subscribers)
+		subscriber_kill(sub);
+	subscribers_reap();
+
+	// all queues are drained, every frame is back in the pool
+	frames_cleanup();
+
+	fd = up.get_fd();
+	up.cleanup();
+	close(fd);
+
+//unwind_dns:
+	dns.close();
+
+unwind_ups:
+	ups.close();
+
+unwind_flusher:
+	flusher.cleanup();
+
+unwind_sc:
+	sc.cleanup();
+
+unwind_epoller:
+	epoller.cleanup();
+
+unwind:
+	if (err) {
+		std::cout << "finished with error" << std::endl;
+		return EXIT_FAILURE;
+	} else {
+		std::cout << "finished with success" << std::endl;
+		return EXIT_SUCCESS;
+	}
+}
+
@@ -1,16 +1,30 @@
 #include "jsremote.h"
-
+#include "jscodec.h"
+#include "jsring.h"
+#include "jsclock.h"
+#include "jslowlat.h"
+#include "jslog.h"
+#include "jslink.h"
+#ifdef JSREMOTE_ALLOCCHECK
+#include "jsalloc.h"
+#endif
+#ifdef JSREMOTE_IO_URING
+#include "jsuring.h"
+#endif
+
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
-#include <map>
 #include <string>
 #include <csignal>
 #include <cstring>
 #include <cstdlib>
 #include <cstdio>
-#include <utility>
 #include <iostream>
 
 #include <epoller/epoller.h>
@@ -29,6 +43,80 @@
 #define MON_ALIVE_PERIOD_MS    0u
 #define SOCKET_RX_BUFF_LEN     JS_MESSAGE_LENGTH_MAX
 #define SOCKET_TX_BUFF_LEN     JS_MESSAGE_LENGTH_MAX
+#define SOCKET_RX_RING_LEN     (64u * 1024u)
+#define SOCKET_TX_SPILL_MAX    (64u * 1024u)
+#define SOCKET_TX_AXES_MAX     256u
+#define SESSION_RESYNC_MS      500u
+#define URING_ENTRIES          64u
+#define URING_BUFS             16u
+#define URING_BUF_LEN          4096u
+#define LOG_SLOTS              4096u
+#define JSSTATE_NUMBERS        256u
+#define JSSTATE_UNSENT         UINT32_MAX
+
+////////////////////////////////////////////////////////////////////////////////
+// types
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Last known state of a control and the session sequence number it was sent with.
+struct jsstate
+{
+	struct js_event ev;
+	uint32_t        seq;
+	bool            valid;
+};
+
+/// @brief Decoder of frames received from server.
+struct sock_decoder : public jscodec_visitor
+{
+	void on_request(uint8_t command, const jsc_request *req);
+	void on_hello(const jsc_hello *hello);
+	void on_session_reply(const jsc_session *session);
+	void on_ack(const jsc_session *session);
+	void on_subscribe(const jsc_subscribe *sub, const jsc_rate *rates, size_t cnt);
+	void on_unknown(const jsmessage *msg);
+};
+
+/// @brief Link environment, the joystick device and server socket of this process.
+class remote_link_env : public jslink::env
+{
+public:
+	virtual uint64_t now_ns();
+	virtual bool timer_arm(uint64_t ns, bool periodic);
+	virtual void timer_disarm();
+	virtual bool alive_arm(uint64_t ns);
+	virtual void alive_disarm();
+	virtual bool joystick_present();
+	virtual bool joystick_open();
+	virtual void joystick_close();
+	virtual bool socket_connect();
+	virtual bool socket_setup();
+	virtual void socket_close();
+	virtual void socket_alive();
+};
+
+/// @brief Output stage flusher. Its eventfd is signalled by the first frame gathered
+///        in a loop iteration, so it gets handled after everything else that was ready.
+class gather_flusher : public fdepoller
+{
+public:
+	gather_flusher(struct epoller *epoller) : fdepoller(epoller) {}
+
+private:
+	virtual int in();
+};
+
+#ifdef JSREMOTE_IO_URING
+class uring_handler_js : public jsuring::handler
+{
+	virtual void uring_done(jsuring *ur, int op, int res);
+};
+
+class uring_handler_sock : public jsuring::handler
+{
+	virtual void uring_recv(jsuring *ur, const uint8_t *data, int len);
+};
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 // variables
@@ -38,8 +126,72 @@ static epoller      epoller;
 static sigepoller   sc(&epoller);
 static jsepoller    js(&epoller);
 static timepoller   mon(&epoller);
+static timepoller   keepalive(&epoller);
+static jslink       jsl;
+static remote_link_env jsl_env;
+static timepoller   resync(&epoller);
+static timepoller   subflush(&epoller);
+static timepoller   batch(&epoller);
+#ifdef JSREMOTE_ALLOCCHECK
+static timepoller   alloccheck(&epoller);
+#endif
 static tcpcepoller  sock(&epoller);
+static jsring       sockring;
+static jslowlat     lowlat(&epoller);
 static bool         sockconnected;
+static jsc_hello    sockproto = {0, JS_ENCODING_SINGLE, JS_MESSAGE_LENGTH_MAX};
+
+// bulk lane, axis updates held back (latest value per axis) while txbuff is backlogged
+static jsc_event    txaxes[SOCKET_TX_AXES_MAX];
+static uint64_t     txaxes_read_ns[SOCKET_TX_AXES_MAX];
+static bool         txaxes_queued[SOCKET_TX_AXES_MAX];
+static uint8_t      txaxes_queue[SOCKET_TX_AXES_MAX];
+static size_t       txaxes_cnt;
+
+// output stage, frames produced in one loop iteration leave in one write,
+// consecutive events share one batch frame once the server accepts them
+static gather_flusher txflusher(&epoller);
+static int          txgather_efd = -1;
+static uint8_t     *txgather;
+static size_t       txgather_len;
+static size_t       txgather_batch;
+static size_t       txgather_batch_len;
+
+// spill stage, frames txbuff can't take wait here in order instead of being
+// dropped, it grows by doubling up to its limit and keeps its memory across connections
+static uint8_t     *txspill;
+static size_t       txspill_len;
+static size_t       txspill_cap;
+static uint64_t     txspill_dropped;
+
+// latency budget batching, gathered frames wait for the batch timer armed by
+// the first of them, or go out once they reach the size threshold
+static bool         batch_armed;
+static uint64_t     batch_flushes;
+static uint64_t     batch_bytes;
+
+// subscription filter of the connection, rate limited axis holds its
+// latest event until the interval since the last sent one passes
+static jsc_subscribe   subscription;
+static uint64_t        sub_interval_ns[SOCKET_TX_AXES_MAX];
+static uint64_t        sub_sent_ns[SOCKET_TX_AXES_MAX];
+static bool            sub_held[SOCKET_TX_AXES_MAX];
+static struct js_event sub_held_ev[SOCKET_TX_AXES_MAX];
+static uint64_t        sub_held_read_ns[SOCKET_TX_AXES_MAX];
+static uint64_t        sub_flush_at;
+
+#ifdef JSREMOTE_IO_URING
+static jsuring            uring(&epoller);
+static uring_handler_js   uring_js;
+static uring_handler_sock uring_sock;
+static bool               uring_enabled;
+static bool               uring_sqpoll;
+static int                uring_jsfd = -1;
+static size_t             uring_jspending;
+static bool               uring_jslinked;
+static bool               uring_jsread;
+static uint8_t            uring_jsbuff[JSCODEC_EVENT_LEN];
+#endif
 
 static std::string  jsdev = JSDEV;
 static std::string  server_addr;
@@ -47,10 +199,37 @@ static uint16_t     server_port;
 static size_t       mon_joystick_period_ms = MON_JOYSTICK_PERIOD_MS;
 static size_t       mon_server_period_ms = MON_SERVER_PERIOD_MS;
 static size_t       mon_alive_period_ms = MON_ALIVE_PERIOD_MS;
-
-static std::map<std::pair<uint8_t, uint8_t>, js_event> initev;
-
-static const char* const short_opts = "ha:p:j:x:y:l:";
+static size_t       sock_rx_buff_len = SOCKET_RX_BUFF_LEN;
+static size_t       sock_tx_buff_len = SOCKET_TX_BUFF_LEN;
+static size_t       sock_rx_ring_len = SOCKET_RX_RING_LEN;
+static size_t       sock_tx_spill_max = SOCKET_TX_SPILL_MAX;
+static uint32_t     batch_budget_us;
+static size_t       batch_size;
+static bool         batch_bypass;
+#ifdef JSREMOTE_ALLOCCHECK
+static uint32_t     alloccheck_ms;
+#endif
+static bool         trace_enabled;
+static bool         lowlat_enabled;
+static jslowlat_cfg lowlat_cfg;
+static bool         verbose;
+
+// buttons first, then axes, so state is replayed in the same order as ever
+static jsstate      initev[2 * JSSTATE_NUMBERS];
+
+// events sent in session, last count acked by server, live events are
+// held back (state is still recorded) until server says what it has seen
+static uint32_t     session_id;
+static uint32_t     session_seq;
+static uint32_t     session_acked;
+static bool         session_resyncing;
+
+// device metadata, read once at open
+static uint8_t      jsmeta_axes;
+static uint8_t      jsmeta_buttons;
+static std::string  jsmeta_name;
+
+static const char* const short_opts = "ha:p:j:x:y:l:B:b:A:tL::uQv";
 
 static const struct option long_opts[] = {
 	{"help",      0, NULL, 'h'},
@@ -60,6 +239,14 @@ static const struct option long_opts[] = {
 	{"jsmon",     1, NULL, 'x'},
 	{"servermon", 1, NULL, 'y'},
 	{"alive",     1, NULL, 'l'},
+	{"buffers",   1, NULL, 'B'},
+	{"batch",     1, NULL, 'b'},
+	{"alloccheck",1, NULL, 'A'},
+	{"trace",     0, NULL, 't'},
+	{"lowlat",    2, NULL, 'L'},
+	{"uring",     0, NULL, 'u'},
+	{"sqpoll",    0, NULL, 'Q'},
+	{"verbose",   0, NULL, 'v'},
 	{ NULL,       0, NULL,  0 }
 };
 
@@ -69,25 +256,62 @@ static const struct option long_opts[] = {
 
 static struct timespec* ms2timespec(struct timespec *ts, uint64_t ms);
 
-static bool monitor_joystick();
-static bool monitor_server();
-static bool monitor_alive();
-static void monitor_stop();
-
 static bool joystick_open();
 static void joystick_close();
+static uint32_t joystick_session_id();
+static void joystick_cache_info();
 static void joystick_print_info();
+static void joystick_event(const struct js_event *event);
+static jsstate *joystick_state(uint8_t type, uint8_t number);
+static uint8_t joystick_get_axes();
+static uint8_t joystick_get_buttons();
+static std::string joystick_get_name();
+static int joystick_get_version();
+
+#ifdef JSREMOTE_IO_URING
+static bool uring_joystick_arm();
+#endif
 
 static bool socket_connect();
 static void socket_close();
+static bool socket_gather_init();
+static void socket_gather_cleanup();
+static void socket_flush();
+static void socket_push(const void *buff, size_t len);
+static bool socket_gather(const void *buff, size_t len);
+static bool socket_gather_arm();
+static void socket_gather_check();
+static bool socket_spill(const void *buff, size_t len);
+static void socket_spill_drain();
+static bool socket_backlogged();
+static bool socket_fits(size_t len);
 static void socket_write_dgram(const void *buff, size_t len);
-static void socket_write_event(const struct js_event *event);
+static void socket_write_hello();
+static void socket_write_metadata(const jsc_request *req, uint8_t command);
+static void socket_local_proto(jsc_hello *proto);
+static void socket_write_event(const struct js_event *event, uint64_t read_ns);
+static bool socket_send_event(const jsc_event *event, uint64_t read_ns);
+static void socket_flush_axes();
+static void socket_resync(uint32_t from);
+static bool socket_parse();
+static void subscribe_reset();
+static bool subscribe_wanted(const jsc_subscribe *sub, uint8_t type, uint8_t number);
+static bool subscribe_pass(const struct js_event *event, uint64_t read_ns);
+static void subscribe_arm(uint64_t at);
+static void subscribe_flush(bool all);
+static bool parse_buffers(const char *str);
+static bool parse_batch(const char *str);
 static void print_help();
 
 static int sighandler(sigepoller &sender, struct signalfd_siginfo *siginfo);
-static int monhandler_joystick(timepoller &sender, uint64_t exp);
-static int monhandler_server(timepoller &sender, uint64_t exp);
-static int monhandler_alive(timepoller &sender, uint64_t exp);
+static int monhandler(timepoller &sender, uint64_t exp);
+static int keepalivehandler(timepoller &sender, uint64_t exp);
+static int resynchandler(timepoller &sender, uint64_t exp);
+static int subflushhandler(timepoller &sender, uint64_t exp);
+static int batchhandler(timepoller &sender, uint64_t exp);
+#ifdef JSREMOTE_ALLOCCHECK
+static int alloccheckhandler(timepoller &sender, uint64_t exp);
+#endif
 static int jshandler(jsepoller &sender, struct js_event *event);
 static int jserr(fdepoller &sender);
 static int sockcon(tcpcepoller &sender, bool connected);
@@ -106,57 +330,32 @@ static struct timespec* ms2timespec(struct timespec *ts, uint64_t ms)
 	return ts;
 }
 
-static bool monitor_joystick()
+static bool joystick_open()
 {
-	struct timespec ts;
+#ifdef JSREMOTE_IO_URING
+	// device is read by io_uring only, epoller must not compete for its events
+	if (uring_enabled) {
+		uring_jsfd = open(jsdev.c_str(), O_RDONLY | O_CLOEXEC);
+		if (uring_jsfd == -1)
+			return false;
 
-	if (!mon.arm_periodic(ms2timespec(&ts, mon_joystick_period_ms)))
-		return false;
-
-	mon._timerhandler = &monhandler_joystick;
+		memset(initev, 0, sizeof initev);
+		session_id = joystick_session_id();
 
-	//std::cout << "joystick periodic monitoring active" << std::endl;
+		jslog(JSLOG_INFO, "joystick open");
 
-	return true;
-}
-
-static bool monitor_server()
-{
-	struct timespec ts;
-
-	if (!mon.arm_oneshot(ms2timespec(&ts, mon_server_period_ms)))
-		return false;
+		joystick_cache_info();
+		joystick_print_info();
 
-	mon._timerhandler = &monhandler_server;
-
-	//std::cout << "server oneshot monitoring active" << std::endl;
-
-	return true;
-}
+		if (!uring_joystick_arm()) {
+			joystick_close();
+			return false;
+		}
 
-static bool monitor_alive()
-{
-	if (!mon_alive_period_ms)
 		return true;
+	}
+#endif
 
-	struct timespec ts;
-
-	if (!mon.arm_periodic(ms2timespec(&ts, mon_alive_period_ms)))
-		return false;
-
-	mon._timerhandler = &monhandler_alive;
-
-	return true;
-}
-
-static void monitor_stop()
-{
-	mon.disarm();
-	//std::cout << "monitoring stopped" << std::endl;
-}
-
-static bool joystick_open()
-{
 	if (!js.open(jsdev, 1))
 		return false;
 
@@ -164,10 +363,12 @@ static bool joystick_open()
 	js._hup       = &jserr;
 	js._jshandler = &jshandler;
 
-	initev.clear();
+	memset(initev, 0, sizeof initev);
+	session_id = joystick_session_id();
 
-	std::cout << "joystick open" << std::endl;
+	jslog(JSLOG_INFO, "joystick open");
 
+	joystick_cache_info();
 	joystick_print_info();
 
 	return true;
@@ -175,22 +376,53 @@ static bool joystick_open()
 
 static void joystick_close()
 {
+#ifdef JSREMOTE_IO_URING
+	if (uring_jsfd != -1) {
+		uring.cancel(&uring_js);
+		close(uring_jsfd);
+		uring_jsfd = -1;
+		jslog(JSLOG_INFO, "joystick closed");
+		return;
+	}
+#endif
+
 	if (js.fd == -1)
 		return;
 
 	js.close();
-	std::cout << "joystick closed" << std::endl;
+	jslog(JSLOG_INFO, "joystick closed");
+}
+
+static uint32_t joystick_session_id()
+{
+	// new device state, new session, never zero
+	uint32_t id = (uint32_t) (jsclock_ns() ^ ((uint64_t) getpid() << 16)) | 1u;
+
+	session_seq   = 0;
+	session_acked = 0;
+
+	return id;
+}
+
+static void joystick_cache_info()
+{
+	jsmeta_axes    = joystick_get_axes();
+	jsmeta_buttons = joystick_get_buttons();
+	jsmeta_name    = joystick_get_name();
+
+	if (jsmeta_name.length() > UINT8_MAX)
+		jsmeta_name.resize(UINT8_MAX);
 }
 
 static void joystick_print_info()
 {
-	size_t   axes = js.get_axes();
+	size_t   axes = jsmeta_axes;
 	//js_corr *corr = new js_corr[axes];
 
-	std::cout << "axes        : " << axes << std::endl;
-	std::cout << "buttons     : " << js.get_buttons() << std::endl;
-	std::cout << "version     : " << js.get_version() << std::endl;
-	std::cout << "name        : " << js.get_name() << std::endl;
+	jslog(JSLOG_INFO, "axes        : %zu", axes);
+	jslog(JSLOG_INFO, "buttons     : %d", (int) jsmeta_buttons);
+	jslog(JSLOG_INFO, "version     : %d", joystick_get_version());
+	jslog(JSLOG_INFO, "name        : %s", jsmeta_name.c_str());
 	/*
 	std::cout << "corrections : ";
 
@@ -210,21 +442,135 @@ static void joystick_print_info()
 		printf("<not available>\n");*/
 }
 
+static void joystick_event(const struct js_event *event)
+{
+	jslog(JSLOG_EVENT, "js: %10u, %6d, %02X, %02d", event->time, event->value, event->type, event->number);
+
+	jsstate *st = joystick_state(event->type, event->number);
+
+	if (!st)
+		return;
+
+	st->ev       = *event;
+	st->ev.type |= JS_EVENT_INIT;
+	st->valid    = true;
+
+	// not sent yet, beyond anything the server may have seen until
+	// socket_send_event stamps it, however long it waits in bulk lane or filter
+	st->seq      = JSSTATE_UNSENT;
+}
+
+static jsstate *joystick_state(uint8_t type, uint8_t number)
+{
+	// fixed slots, recording state never allocates
+	switch (type & ~JS_EVENT_INIT) {
+		case JS_EVENT_BUTTON:
+			return &initev[number];
+		case JS_EVENT_AXIS:
+			return &initev[JSSTATE_NUMBERS + number];
+		default:
+			return 0;
+	}
+}
+
+static uint8_t joystick_get_axes()
+{
+#ifdef JSREMOTE_IO_URING
+	uint8_t n = 0;
+
+	if (uring_jsfd != -1) {
+		ioctl(uring_jsfd, JSIOCGAXES, &n);
+		return n;
+	}
+#endif
+
+	return js.get_axes();
+}
+
+static uint8_t joystick_get_buttons()
+{
+#ifdef JSREMOTE_IO_URING
+	uint8_t n = 0;
+
+	if (uring_jsfd != -1) {
+		ioctl(uring_jsfd, JSIOCGBUTTONS, &n);
+		return n;
+	}
+#endif
+
+	return js.get_buttons();
+}
+
+static std::string joystick_get_name()
+{
+#ifdef JSREMOTE_IO_URING
+	char name[128];
+
+	if (uring_jsfd != -1) {
+		int len = ioctl(uring_jsfd, JSIOCGNAME(sizeof name), name);
+		return len > 0 ? std::string(name, strnlen(name, len)) : std::string();
+	}
+#endif
+
+	return js.get_name();
+}
+
+static int joystick_get_version()
+{
+#ifdef JSREMOTE_IO_URING
+	uint32_t version = 0;
+
+	if (uring_jsfd != -1) {
+		ioctl(uring_jsfd, JSIOCGVERSION, &version);
+		return version;
+	}
+#endif
+
+	return js.get_version();
+}
+
+#ifdef JSREMOTE_IO_URING
+static bool uring_joystick_arm()
+{
+	static_assert(sizeof(struct js_event) == sizeof(jsc_event), "js_event and jsc_event layouts differ");
+
+	// one chain in flight keeps events in order
+	if (uring_jsfd == -1 || uring_jspending)
+		return true;
+
+	// linked send writes to the socket directly, so it must not overtake
+	// (or land in the middle of) anything still queued in txbuff or spill stage
+	int sfd = sockconnected && !socket_backlogged() ? sock.fd : -1;
+
+	jscodec_header(uring_jsbuff, JS_COMMAND_EVENT, JSCODEC_EVENT_LEN);
+
+	// device writes the event straight into the frame payload, the frame is sent by the linked send
+	if (!uring.read_send(uring_jsfd, uring_jsbuff + sizeof(jsmessage), sizeof(jsc_event), sfd, uring_jsbuff, sizeof uring_jsbuff, &uring_js))
+		return false;
+
+	uring_jspending = sfd == -1 ? 1 : 2;
+	uring_jslinked  = sfd != -1;
+	uring_jsread    = false;
+
+	return uring.submit();
+}
+#endif
+
 static bool socket_connect()
 {
-	if (!sock.socket(AF_INET, SOCKET_RX_BUFF_LEN, SOCKET_TX_BUFF_LEN)) {
-		std::cerr << "creating socket failed" << std::endl;
+	if (!sock.socket(AF_INET, sock_rx_buff_len, sock_tx_buff_len)) {
+		jslog(JSLOG_ERROR, "creating socket failed");
 		return false;
 	}
 
 	if (!sock.set_so_tcp_nodelay(true)) {
-		std::cerr << "setting socket nodelay failed" << std::endl;
+		jslog(JSLOG_ERROR, "setting socket nodelay failed");
 		sock.close();
 		return false;
 	}
 
 	if (!sock.connect(server_addr, server_port)) {
-		std::cerr << "connecting socket failed" << std::endl;
+		jslog(JSLOG_ERROR, "connecting socket failed");
 		sock.close();
 		return false;
 	}
@@ -247,35 +593,677 @@ static void socket_close()
 
 	sockconnected = false;
 
+#ifdef JSREMOTE_ALLOCCHECK
+	// neither is reconnecting
+	if (alloccheck_ms) {
+		jsalloc_set_counting(false);
+		alloccheck.disarm();
+	}
+#endif
+
+#ifdef JSREMOTE_IO_URING
+	// drop socket receive and re-arm device read without the linked send
+	if (uring_enabled) {
+		uring.cancel(&uring_sock);
+		uring.cancel(&uring_js);
+	}
+#endif
+
+	sockproto.version    = 0;
+	sockproto.encodings  = JS_ENCODING_SINGLE;
+	sockproto.max_length = JS_MESSAGE_LENGTH_MAX;
+
 	sock.close();
+	sockring.clear();
+
+	memset(txaxes_queued, 0, sizeof txaxes_queued);
+	txaxes_cnt = 0;
+
+	txgather_len       = 0;
+	txgather_batch_len = 0;
+	txspill_len        = 0;
+
+	if (batch_armed) {
+		batch.disarm();
+		batch_armed = false;
+	}
+
+	session_resyncing = false;
+	resync.disarm();
+
+	subscribe_reset();
 	//std::cout << "socket closed" << std::endl;
 }
 
-static void socket_write_dgram(const void *buff, size_t len)
+static bool socket_gather_init()
 {
+	txgather = new (std::nothrow) uint8_t[sock_tx_buff_len];
+	if (!txgather) {
+		std::cerr << "allocating output stage failed" << std::endl;
+		return false;
+	}
+
+	txgather_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (txgather_efd == -1) {
+		std::cerr << "creating output stage eventfd failed" << std::endl;
+		delete[] txgather;
+		txgather = 0;
+		return false;
+	}
+
+	if (!txflusher.init(txgather_efd, EPOLLIN)) {
+		std::cerr << "watching output stage eventfd failed" << std::endl;
+		close(txgather_efd);
+		txgather_efd = -1;
+		delete[] txgather;
+		txgather = 0;
+		return false;
+	}
+
+	return true;
+}
+
+static void socket_gather_cleanup()
+{
+	if (txgather_efd == -1)
+		return;
+
+	txflusher.cleanup();
+	close(txgather_efd);
+	txgather_efd = -1;
+
+	delete[] txgather;
+	txgather = 0;
+
+	free(txspill);
+	txspill     = 0;
+	txspill_len = 0;
+	txspill_cap = 0;
+
+	if (txspill_dropped)
+		jslog(JSLOG_INFO, "frames dropped by full spill stage: %" PRIu64, txspill_dropped);
+
+	if (batch_flushes)
+		jslog(JSLOG_INFO, "batches: %" PRIu64 ", %.1f bytes average", batch_flushes, (double) batch_bytes / batch_flushes);
+}
+
+static void socket_flush()
+{
+	if (!txgather_len)
+		return;
+
+	socket_push(txgather, txgather_len);
+
+	if (batch_budget_us) {
+		++batch_flushes;
+		batch_bytes += txgather_len;
+	}
+
+	txgather_len       = 0;
+	txgather_batch_len = 0;
+
+	// flushed before its budget ran out
+	if (batch_armed) {
+		batch.disarm();
+		batch_armed = false;
+	}
+}
+
+static void socket_push(const void *buff, size_t len)
+{
+	// frames behind spilled ones wait too, so the stream keeps its order
+	if (txspill_len) {
+		if (!socket_spill(buff, len))
+			jslog(JSLOG_ERROR, "writing datagram to socket failed, spill stage full");
+		return;
+	}
+
 	ssize_t ret = sock.write_dgram(buff, len);
+	if (ret > 0)
+		jsl.transmitted();
+
 	if (ret < 0)
-		std::cerr << "writing datagram to socket failed, unknown error" << std::endl;
-	else if (ret == 0)
-		std::cerr << "writing datagram to socket failed, not enough space" << std::endl;
-	else if ((size_t)ret != len)
-		std::cerr << "writing datagram to socket failed, unexpected error" << std::endl;
+		jslog(JSLOG_ERROR, "writing datagram to socket failed, unknown error");
+	else if (ret == 0 && !socket_spill(buff, len))
+		jslog(JSLOG_ERROR, "writing datagram to socket failed, not enough space");
+	else if (ret > 0 && (size_t)ret != len)
+		jslog(JSLOG_ERROR, "writing datagram to socket failed, unexpected error");
+
+#ifdef JSREMOTE_IO_URING
+	// armed linked send would overtake the queued bytes, event goes through txbuff instead
+	if (uring_enabled && uring_jslinked && uring_jspending && socket_backlogged())
+		uring.cancel(&uring_js);
+#endif
 }
 
-static void socket_write_event(const struct js_event *event)
+static bool socket_gather(const void *buff, size_t len)
 {
-	uint8_t buff[sizeof(jsmessage) + sizeof(jsc_event)];
-	jsmessage *msg  = (jsmessage *) buff;
-	jsc_event *data = (jsc_event *) msg->data;
+#ifdef JSREMOTE_IO_URING
+	// linked sends go out on their own, so everything else does too to keep the order
+	if (uring_enabled) {
+		socket_push(buff, len);
+		return false;
+	}
+#endif
+
+	// gathered frames must fit tx buffer in one write
+	if (txgather_len + len > linbuff_towr(&sock.txbuff))
+		socket_flush();
+
+	if (!socket_fits(len)) {
+		jslog(JSLOG_ERROR, "writing datagram to socket failed, spill stage full");
+		++txspill_dropped;
+		return false;
+	}
+
+	if (!txgather_len && !socket_gather_arm()) {
+		socket_push(buff, len);
+		return false;
+	}
+
+	memcpy(txgather + txgather_len, buff, len);
+	txgather_len      += len;
+	txgather_batch_len = 0;
+
+	return true;
+}
+
+static bool socket_gather_arm()
+{
+	// first frame starts the budget
+	if (batch_budget_us) {
+		struct timespec ts;
+
+		ts.tv_sec  =  batch_budget_us / 1000000UL;
+		ts.tv_nsec = (batch_budget_us % 1000000UL) * 1000UL;
+
+		if (!batch.arm_oneshot(&ts))
+			return false;
+
+		batch_armed = true;
+		return true;
+	}
+
+	// otherwise frames leave at the end of loop iteration
+	uint64_t val = 1;
+
+	return write(txgather_efd, &val, sizeof val) == sizeof val;
+}
+
+static void socket_gather_check()
+{
+	if (batch_size && txgather_len >= batch_size)
+		socket_flush();
+}
+
+static bool socket_spill(const void *buff, size_t len)
+{
+	if (txspill_len + len > txspill_cap) {
+		size_t cap = txspill_cap ? txspill_cap : JS_MESSAGE_LENGTH_MAX;
+
+		while (cap < txspill_len + len)
+			cap *= 2;
+
+		if (cap > sock_tx_spill_max)
+			cap = sock_tx_spill_max;
+
+		uint8_t *p = cap >= txspill_len + len ? (uint8_t *) realloc(txspill, cap) : 0;
+
+		if (!p) {
+			++txspill_dropped;
+			return false;
+		}
+
+		txspill     = p;
+		txspill_cap = cap;
+	}
+
+	memcpy(txspill + txspill_len, buff, len);
+	txspill_len += len;
+
+	return true;
+}
+
+static void socket_spill_drain()
+{
+	// stream is bytes, so frames may be split between writes
+	while (txspill_len && linbuff_towr(&sock.txbuff)) {
+		size_t  n   = txspill_len < linbuff_towr(&sock.txbuff) ? txspill_len : linbuff_towr(&sock.txbuff);
+		ssize_t ret = sock.write_dgram(txspill, n);
+
+		if (ret <= 0) {
+			jslog(JSLOG_ERROR, "writing spilled frames to socket failed");
+			return;
+		}
+
+		jsl.transmitted();
+
+		txspill_len -= ret;
+		memmove(txspill, txspill + ret, txspill_len);
+	}
+}
+
+static bool socket_backlogged()
+{
+	return linbuff_tord(&sock.txbuff) || txspill_len;
+}
+
+static bool socket_fits(size_t len)
+{
+	// gather buffer leaves in one piece, so it is admitted only as long as
+	// the whole of it still goes to txbuff or the spill stage at flush
+	size_t total = txgather_len + len;
+
+	return (!txspill_len && total <= linbuff_towr(&sock.txbuff)) || txspill_len + total <= sock_tx_spill_max;
+}
+
+static void socket_write_dgram(const void *buff, size_t len)
+{
+	socket_gather(buff, len);
+	socket_gather_check();
+}
+
+static void socket_write_hello()
+{
+	uint8_t       buff[JSCODEC_KALIVE_LEN];
+	jsc_hello     local;
+	jsc_keepalive ka;
+
+	// legacy servers take it as plain alive
+	socket_local_proto(&local);
+
+	if (!mon_alive_period_ms) {
+		socket_write_dgram(buff, jscodec_put_alive(buff, &local));
+		return;
+	}
+
+	// server derives its idle timeout from the period
+	ka.period_ms = mon_alive_period_ms < UINT16_MAX ? mon_alive_period_ms : UINT16_MAX;
+	socket_write_dgram(buff, jscodec_put_alive(buff, &local, &ka));
+}
+
+static void socket_write_metadata(const jsc_request *req, uint8_t command)
+{
+	if (command == JS_COMMAND_GETAXES) {
+
+		uint8_t buff[JSCODEC_AXES_LEN];
+		socket_write_dgram(buff, jscodec_put_axes(buff, jsmeta_axes, req));
+
+	} else if (command == JS_COMMAND_GETBUTTONS) {
+
+		uint8_t buff[JSCODEC_BUTTONS_LEN];
+		socket_write_dgram(buff, jscodec_put_buttons(buff, jsmeta_buttons, req));
+
+	} else if (command == JS_COMMAND_GETNAME) {
+
+		uint8_t buff[JSCODEC_NAME_LEN];
+		socket_write_dgram(buff, jscodec_put_name(buff, jsmeta_name.c_str(), jsmeta_name.length(), req));
+	}
+}
+
+static void socket_local_proto(jsc_hello *proto)
+{
+	proto->version    = JS_PROTOCOL_VERSION;
+	proto->encodings  = JS_ENCODING_SINGLE | JS_ENCODING_BATCH | JS_ENCODING_SESSION | JS_ENCODING_SUBSCRIBE | (trace_enabled ? JS_ENCODING_TRACE : 0);
+
+#ifdef JSREMOTE_IO_URING
+	// linked sends bypass event counting and filtering
+	if (uring_enabled)
+		proto->encodings &= ~(JS_ENCODING_SESSION | JS_ENCODING_SUBSCRIBE);
+#endif
+	proto->max_length = sockring.size() < UINT16_MAX ? sockring.size() : UINT16_MAX;
+}
+
+static void socket_write_event(const struct js_event *event, uint64_t read_ns)
+{
+	jsc_event data;
+
+	data.time   = event->time;
+	data.value  = event->value;
+	data.type   = event->type;
+	data.number = event->number;
+
+	// axis motion goes to the bulk lane while anything is waiting, so buttons,
+	// responses and alive (priority lane, written straight to txbuff) overtake it
+	if (event->type == JS_EVENT_AXIS && (txaxes_cnt || socket_backlogged())) {
+
+		if (!txaxes_queued[event->number]) {
+			txaxes_queued[event->number]  = true;
+			txaxes_queue[txaxes_cnt++]    = event->number;
+			txaxes_read_ns[event->number] = read_ns;
+		}
+
+		// older sample is superseded, its read stamp is kept to show queueing
+		txaxes[event->number] = data;
+		return;
+	}
+
+	// state stays unsent, so resync after reconnect still delivers it
+	if (!socket_send_event(&data, read_ns)) {
+		jslog(JSLOG_ERROR, "event dropped, spill stage full");
+		++txspill_dropped;
+	}
+
+	// button edge doesn't wait for the budget, frames gathered before it go too
+	if (batch_bypass && event->type == JS_EVENT_BUTTON)
+		socket_flush();
+}
+
+static bool socket_send_event(const jsc_event *event, uint64_t read_ns)
+{
+	uint8_t   buff[JSCODEC_TEVENT_LEN];
+	jsc_trace trace;
+	size_t    len;
+
+	// replayed state has no read stamp and is not traced
+	if (read_ns && (sockproto.encodings & JS_ENCODING_TRACE)) {
+		trace.read_ns    = read_ns;
+		trace.enqueue_ns = jsclock_ns();
+		len = jscodec_put_event(buff, event, &trace);
+	} else
+		len = jscodec_put_event(buff, event, 0);
+
+	if (txgather_len + len > linbuff_towr(&sock.txbuff))
+		socket_flush();
+
+	// refused before it is counted, bulk lane keeps it for later
+	if (!socket_fits(len))
+		return false;
+
+	// untraced event joins the batch frame right behind it
+	if (len == JSCODEC_EVENT_LEN && txgather_batch_len && txgather_batch + txgather_batch_len == txgather_len &&
+	    txgather_batch_len + sizeof(jsc_event) <= sockproto.max_length && txgather_len + sizeof(jsc_event) <= linbuff_towr(&sock.txbuff)) {
+
+		txgather_batch_len = jscodec_put_events(txgather + txgather_batch, txgather_batch_len, event);
+		txgather_len       = txgather_batch + txgather_batch_len;
+
+	} else if (socket_gather(buff, len) && len == JSCODEC_EVENT_LEN && (sockproto.encodings & JS_ENCODING_BATCH)) {
+
+		// single event becomes first of a batch, same size on the wire
+		txgather_batch     = txgather_len - len;
+		txgather_batch_len = jscodec_put_events(txgather + txgather_batch, 0, event);
+	}
+
+	socket_gather_check();
+
+	// server counts every event frame, so do we, state is sent only
+	// once its latest value goes out
+	jsstate *st = joystick_state(event->type, event->number);
+
+	++session_seq;
+
+	if (st && st->valid && st->ev.time == event->time && st->ev.value == event->value)
+		st->seq = session_seq;
+
+	return true;
+}
+
+static void socket_resync(uint32_t from)
+{
+	resync.disarm();
+
+	session_resyncing = false;
+	session_seq       = from;
+
+	// changes the server hasn't seen, everything for a fresh session or legacy server
+	for (const jsstate &st : initev) {
+		if (st.valid && st.seq > from && subscribe_wanted(&subscription, st.ev.type & ~JS_EVENT_INIT, st.ev.number)) {
+			jsc_event ev;
+
+			ev.time   = st.ev.time;
+			ev.value  = st.ev.value;
+			ev.type   = st.ev.type;
+			ev.number = st.ev.number;
+
+			socket_send_event(&ev, 0);
+		}
+	}
+}
+
+static void socket_flush_axes()
+{
+	size_t i;
+
+	// bulk lane drains only behind an empty priority lane
+	if (!txaxes_cnt || socket_backlogged())
+		return;
+
+	for (i = 0; i < txaxes_cnt; ++i) {
+		uint8_t number = txaxes_queue[i];
+
+		if (!socket_send_event(&txaxes[number], txaxes_read_ns[number]))
+			break;
+
+		txaxes_queued[number] = false;
+	}
+
+	txaxes_cnt -= i;
+	memmove(txaxes_queue, txaxes_queue + i, txaxes_cnt);
+}
+
+static bool socket_parse()
+{
+	const jsmessage *msg;
+	jscodec_result   res;
+	sock_decoder     dec;
+
+	while ((res = jscodec_frame(sockring.rd_ptr(), sockring.tord(), sockring.size(), &msg)) == JSCODEC_OK) {
+
+		if (!jscodec_dispatch(dec, msg)) {
+			res = JSCODEC_INVALID;
+			break;
+		}
+
+		sockring.skip(msg->length);
+	}
+
+	if (res == JSCODEC_INVALID) {
+		jslog(JSLOG_ERROR, "malformed message");
+		return false;
+	}
+
+	return true;
+}
+
+static void subscribe_reset()
+{
+	memset(&subscription, 0xFF, sizeof subscription);
+	memset(sub_interval_ns, 0, sizeof sub_interval_ns);
+	memset(sub_held, 0, sizeof sub_held);
+
+	sub_flush_at = 0;
+	subflush.disarm();
+}
+
+static bool subscribe_wanted(const jsc_subscribe *sub, uint8_t type, uint8_t number)
+{
+	if (type == JS_EVENT_AXIS)
+		return sub->axes[number / 8] & (1u << (number % 8));
+
+	if (type == JS_EVENT_BUTTON)
+		return sub->buttons[number / 8] & (1u << (number % 8));
+
+	return true;
+}
+
+static bool subscribe_pass(const struct js_event *event, uint64_t read_ns)
+{
+	uint8_t type   = event->type & ~JS_EVENT_INIT;
+	uint8_t number = event->number;
+
+	if (!subscribe_wanted(&subscription, type, number))
+		return false;
+
+	if (type != JS_EVENT_AXIS || !sub_interval_ns[number])
+		return true;
+
+	uint64_t now = jsclock_ns();
+
+	if (!sub_held[number] && now - sub_sent_ns[number] >= sub_interval_ns[number]) {
+		sub_sent_ns[number] = now;
+		return true;
+	}
+
+	// superseded sample is dropped, only the latest one goes out
+	if (!sub_held[number]) {
+		sub_held[number] = true;
+		subscribe_arm(sub_sent_ns[number] + sub_interval_ns[number]);
+	}
+
+	sub_held_ev[number]      = *event;
+	sub_held_read_ns[number] = read_ns;
+
+	return false;
+}
+
+static void subscribe_arm(uint64_t at)
+{
+	if (sub_flush_at && sub_flush_at <= at)
+		return;
+
+	struct timespec ts;
+	uint64_t        now = jsclock_ns();
+
+	// zero would disarm the timer
+	if (!subflush.arm_oneshot(jsclock_ns2timespec(&ts, at > now ? at - now : 1))) {
+		jslog(JSLOG_ERROR, "setting subscription timer failed");
+		return;
+	}
+
+	sub_flush_at = at;
+}
+
+static void subscribe_flush(bool all)
+{
+	uint64_t now  = jsclock_ns();
+	uint64_t next = 0;
+
+	sub_flush_at = 0;
+
+	for (size_t i = 0; i < SOCKET_TX_AXES_MAX; ++i) {
+
+		if (!sub_held[i])
+			continue;
+
+		uint64_t due = sub_sent_ns[i] + sub_interval_ns[i];
+
+		if (!all && due > now) {
+			if (!next || due < next)
+				next = due;
+			continue;
+		}
+
+		sub_held[i]    = false;
+		sub_sent_ns[i] = now;
+
+		// resync sends the recorded state anyway
+		if (sockconnected && !session_resyncing && subscribe_wanted(&subscription, JS_EVENT_AXIS, i))
+			socket_write_event(&sub_held_ev[i], sub_held_read_ns[i]);
+	}
+
+	if (next)
+		subscribe_arm(next);
+}
+
+static bool parse_buffers(const char *str)
+{
+	enum { OPT_RX, OPT_TX, OPT_RING, OPT_SPILL };
+	static char *const tokens[] = {(char *) "rx", (char *) "tx", (char *) "ring", (char *) "spill", NULL};
+
+	// getsubopt modifies its input
+	char  buff[strlen(str) + 1];
+	char *opts = buff;
+	char *value;
+
+	strcpy(buff, str);
+
+	while (*opts) {
+		int opt = getsubopt(&opts, tokens, &value);
+
+		if (opt < 0) {
+			std::cerr << "unknown buffers suboption " << value << std::endl;
+			return false;
+		}
+
+		if (!value) {
+			std::cerr << "buffers suboption " << tokens[opt] << " needs a value" << std::endl;
+			return false;
+		}
+
+		size_t len = strtoul(value, NULL, 10);
+
+		if (opt == OPT_SPILL) {
+			sock_tx_spill_max = len;
+			continue;
+		}
+
+		if (len < JS_MESSAGE_LENGTH_MAX) {
+			std::cerr << "buffers suboption " << tokens[opt] << " shorter than " << JS_MESSAGE_LENGTH_MAX << std::endl;
+			return false;
+		}
+
+		switch (opt) {
+			case OPT_RX:
+				sock_rx_buff_len = len;
+				break;
+			case OPT_TX:
+				sock_tx_buff_len = len;
+				break;
+			case OPT_RING:
+				sock_rx_ring_len = len;
+				break;
+		}
+	}
+
+	return true;
+}
+
+static bool parse_batch(const char *str)
+{
+	enum { OPT_BUDGET, OPT_SIZE, OPT_BYPASS };
+	static char *const tokens[] = {(char *) "budget", (char *) "size", (char *) "bypass", NULL};
+
+	// getsubopt modifies its input
+	char  buff[strlen(str) + 1];
+	char *opts = buff;
+	char *value;
+
+	strcpy(buff, str);
+
+	while (*opts) {
+		int opt = getsubopt(&opts, tokens, &value);
+
+		if (opt < 0) {
+			std::cerr << "unknown batch suboption " << value << std::endl;
+			return false;
+		}
+
+		if (opt == OPT_BYPASS) {
+			batch_bypass = true;
+			continue;
+		}
+
+		if (!value) {
+			std::cerr << "batch suboption " << tokens[opt] << " needs a value" << std::endl;
+			return false;
+		}
+
+		switch (opt) {
+			case OPT_BUDGET:
+				batch_budget_us = strtoul(value, NULL, 10);
+				break;
+			case OPT_SIZE:
+				batch_size = strtoul(value, NULL, 10);
+				break;
+		}
+	}
 
-	msg->length  = sizeof buff;
-	msg->command = JS_COMMAND_EVENT;
-	data->time   = event->time;
-	data->value  = event->value;
-	data->type   = event->type;
-	data->number = event->number;
+	if (!batch_budget_us) {
+		std::cerr << "batch budget must be set" << std::endl;
+		return false;
+	}
 
-	socket_write_dgram(buff, sizeof buff);
+	return true;
 }
 
 static void print_help()
@@ -287,7 +1275,25 @@ static void print_help()
 	std::cout << "  -j  --jsdev <device>      joystick device (default: "                                        << JSDEV                  << ")" << std::endl;
 	std::cout << "  -x  --jsmon <period>      joystick monitoring period [ms] (default: "                        << MON_JOYSTICK_PERIOD_MS << ")" << std::endl;
 	std::cout << "  -y  --servermon <period>  server monitoring period [ms] (default: "                          << MON_SERVER_PERIOD_MS   << ")" << std::endl;
-	std::cout << "  -l  --alive <period>      alive packets period [ms], zero means no alive packets (default: " << MON_ALIVE_PERIOD_MS    << ")" << std::endl;
+	std::cout << "  -l  --alive <period>      send alive packet after link was idle for <period> [ms], zero means"                               << std::endl;
+	std::cout << "                            no alive packets (default: "                                       << MON_ALIVE_PERIOD_MS    << ")" << std::endl;
+	std::cout << "  -B  --buffers <opts>      buffer lengths in bytes, opts: rx=<n>,tx=<n>,ring=<n>,spill=<n>, ring bounds"                       << std::endl;
+	std::cout << "                            frame length offered to server, spill is the limit of frames waiting for"                           << std::endl;
+	std::cout << "                            full tx buffer, zero drops them (default: "                        << SOCKET_TX_SPILL_MAX    << ")" << std::endl;
+	std::cout << "  -b  --batch <opts>        hold frames up to a latency budget, opts: budget=<us>,size=<n>,bypass,"                             << std::endl;
+	std::cout << "                            flush after <us> since the first one or once <n> bytes are gathered,"                               << std::endl;
+	std::cout << "                            bypass sends button edges at once (not with --uring)"                                               << std::endl;
+#ifdef JSREMOTE_ALLOCCHECK
+	std::cout << "  -A  --alloccheck <ms>     count heap allocations after <ms> of each connection, fail at exit if"                              << std::endl;
+	std::cout << "                            anything was allocated (driven by jsalloccheck)"                                                    << std::endl;
+#endif
+	std::cout << "  -t  --trace               stamp events for hop tracing if server asks for it"                                                 << std::endl;
+	std::cout << "  -L  --lowlat[=<opts>]     low-latency mode, opts: cpu=<n>,fifo=<prio>,spin=<us>,busypoll=<us>"                               << std::endl;
+#ifdef JSREMOTE_IO_URING
+	std::cout << "  -u  --uring               forward events through io_uring"                                                                    << std::endl;
+	std::cout << "  -Q  --sqpoll              use io_uring kernel submission thread (with --uring)"                                               << std::endl;
+#endif
+	std::cout << "  -v  --verbose             log every joystick event"                                                                           << std::endl;
 	std::cout << std::endl;
 }
 
@@ -323,223 +1329,479 @@ static int sighandler(sigepoller &sender, struct signalfd_siginfo *siginfo)
 	}
 }
 
-static int monhandler_joystick(timepoller &sender, uint64_t exp)
+static int monhandler(timepoller &sender, uint64_t exp)
 {
-	if (access(jsdev.c_str(), R_OK) == -1)
-		return 0;
-
-	std::cout << "joystick connected" << std::endl;
+	return jsl.timeout() ? 0 : -1;
+}
 
-	if (!joystick_open())
-		return 0;
+static int keepalivehandler(timepoller &sender, uint64_t exp)
+{
+	return jsl.alive_timeout() ? 0 : -1;
+}
 
-	if (!monitor_server())
-		return -1;
+static int resynchandler(timepoller &sender, uint64_t exp)
+{
+	// no hello response, legacy server
+	if (session_resyncing)
+		socket_resync(0);
 
 	return 0;
 }
 
-static int monhandler_server(timepoller &sender, uint64_t exp)
+static int subflushhandler(timepoller &sender, uint64_t exp)
 {
-	if (!socket_connect())
-		return -1;
+	subscribe_flush(false);
 
 	return 0;
 }
 
-static int monhandler_alive(timepoller &sender, uint64_t exp)
+static int batchhandler(timepoller &sender, uint64_t exp)
 {
-	uint8_t buff[sizeof(jsmessage)];
-	jsmessage *msg = (jsmessage *) buff;
+	batch_armed = false;
 
-	msg->length  = sizeof buff;
-	msg->command = JS_COMMAND_ALIVE;
+	if (sockconnected)
+		socket_flush();
+
+	return 0;
+}
 
-	socket_write_dgram(buff, sizeof buff);
+#ifdef JSREMOTE_ALLOCCHECK
+static int alloccheckhandler(timepoller &sender, uint64_t exp)
+{
+	if (sockconnected) {
+		jslog(JSLOG_INFO, "counting allocations");
+		jsalloc_set_counting(true);
+	}
 
 	return 0;
 }
+#endif
 
 static int jshandler(jsepoller &sender, struct js_event *event)
 {
-	printf("js: %10u, %6d, %02X, %02d\n", event->time, event->value, event->type, event->number);
+	uint64_t read_ns = trace_enabled ? jsclock_ns() : 0;
 
-	if (sockconnected)
-		socket_write_event(event);
+	joystick_event(event);
 
-	event->type |= JS_EVENT_INIT;
-	initev[std::make_pair(event->type, event->number)] = *event;
+	if (sockconnected && !session_resyncing && subscribe_pass(event, read_ns))
+		socket_write_event(event, read_ns);
 
 	return 0;
 }
 
 static int jserr(fdepoller &sender)
 {
-	socket_close();
-
-	joystick_close();
-
-	if (!monitor_joystick())
-		return -1;
-
-	return 0;
+	return jsl.joystick_lost() ? 0 : -1;
 }
 
 static int sockcon(tcpcepoller &sender, bool connected)
 {
-	bool err =false;
+	return jsl.connected(connected) ? 0 : -1;
+}
+
+static int sockrx(fdepoller &sender, int len)
+{
+	bool err = false;
+
+	if (len < 0) {
+		jslog(JSLOG_ERROR, "socket error");
+		err = true;
 
-	if (connected) {
-		std::cout << "socket connected" << std::endl;
-		sockconnected = true;
+	} else if (len == 0) {
+		jslog(JSLOG_INFO, "socket disconnected");
+		err = true;
+
+	} else {
 
-		if (!sock.enable_rx()) {
-			std::cerr << "enabling reception on socket failed" << std::endl;
+		// hand over what tcpcepoller has already read and drain the rest
+		// of the socket straight into the ring, frames are always contiguous there
+		bool   eof = false;
+		size_t n   = linbuff_tord(&sock.rxbuff);
+
+		if (sockring.write(LINBUFF_RD_PTR(&sock.rxbuff), n) != n) {
+			jslog(JSLOG_ERROR, "socket rx ring overflow");
 			err = true;
+			goto finish;
 		}
 
-		if (!monitor_alive()) {
-			std::cerr << "setting alive timer failed" << std::endl;
+		linbuff_skip(&sock.rxbuff, n);
+		linbuff_compact(&sock.rxbuff);
+
+		if (sockring.fill(sock.fd, &eof) < 0) {
+			jslog(JSLOG_ERROR, "socket error");
 			err = true;
+			goto finish;
 		}
 
-		for (const auto &item : initev)
-			socket_write_event(&item.second);
+		if (!socket_parse()) {
+			err = true;
+			goto finish;
+		}
 
-	} else {
-		//perror("socket connecting failed");
-		err = true;
+		if (eof) {
+			jslog(JSLOG_INFO, "socket disconnected");
+			err = true;
+		}
 	}
 
-	if (err) {
-		socket_close();
+finish:
 
-		if (!monitor_server())
-			return -1;
-	}
+	if (err && !jsl.socket_lost())
+		return -1;
 
 	return 0;
 }
 
-static int sockrx(fdepoller &sender, int len)
+int gather_flusher::in()
+{
+	uint64_t val;
+
+	if (read(fd, &val, sizeof val) != sizeof val)
+		return 0;
+
+	// everything ready in this loop iteration has been handled
+	if (sockconnected)
+		socket_flush();
+
+	return 0;
+}
+
+static int socktx(fdepoller &sender, int len)
 {
 	bool err = false;
 
 	if (len < 0) {
-		std::cerr << "socket error" << std::endl;
+		jslog(JSLOG_ERROR, "socket error");
 		err = true;
 
 	} else if (len == 0) {
-		std::cout << "socket disconnected" << std::endl;
+		jslog(JSLOG_ERROR, "socket unexpected error");
 		err = true;
+	}
 
-	} else {
+	if (!linbuff_tord(&sock.txbuff))
+		linbuff_compact(&sock.txbuff);
 
-		while (linbuff_tord(&sock.rxbuff)) {
+	if (!err) {
+		socket_spill_drain();
+		socket_flush_axes();
+	}
 
-			if (linbuff_tord(&sock.rxbuff) < sizeof(jsmessage))
-				break;
+	if (err && !jsl.socket_lost())
+		return -1;
 
-			jsmessage *msg = (jsmessage *)LINBUFF_RD_PTR(&sock.rxbuff);
+	return 0;
+}
 
-			if (linbuff_tord(&sock.rxbuff) < msg->length)
-				break;
+static int sockerr(fdepoller &sender)
+{
+	jslog(JSLOG_ERROR, "socket error");
+	return jsl.socket_lost() ? 0 : -1;
+}
+
+uint64_t remote_link_env::now_ns()
+{
+	return jsclock_ns();
+}
+
+bool remote_link_env::timer_arm(uint64_t ns, bool periodic)
+{
+	struct timespec ts;
+
+	jsclock_ns2timespec(&ts, ns);
 
-			if (msg->command == JS_COMMAND_GETAXES) {
+	return periodic ? mon.arm_periodic(&ts) : mon.arm_oneshot(&ts);
+}
 
+void remote_link_env::timer_disarm()
+{
+	mon.disarm();
+}
 
-				uint8_t buff[sizeof(jsmessage) + sizeof(jsr_getaxes)];
-				jsmessage   *msg  = (jsmessage *) buff;
-				jsr_getaxes *data = (jsr_getaxes *) msg->data;
+bool remote_link_env::alive_arm(uint64_t ns)
+{
+	struct timespec ts;
 
-				msg->length  = sizeof buff;
-				msg->command = JS_COMMAND_GETAXES | JS_RESPONSE;
-				data->number = js.get_axes();
+	return keepalive.arm_oneshot(jsclock_ns2timespec(&ts, ns));
+}
 
-				socket_write_dgram(buff, sizeof buff);
+void remote_link_env::alive_disarm()
+{
+	keepalive.disarm();
+}
 
-			} else if (msg->command == JS_COMMAND_GETBUTTONS) {
+bool remote_link_env::joystick_present()
+{
+	return access(jsdev.c_str(), R_OK) != -1;
+}
 
-				uint8_t buff[sizeof(jsmessage) + sizeof(jsr_getbuttons)];
-				jsmessage      *msg  = (jsmessage *) buff;
-				jsr_getbuttons *data = (jsr_getbuttons *) msg->data;
+bool remote_link_env::joystick_open()
+{
+	jslog(JSLOG_INFO, "joystick connected");
 
-				msg->length  = sizeof buff;
-				msg->command = JS_COMMAND_GETBUTTONS | JS_RESPONSE;
-				data->number = js.get_buttons();
+	return ::joystick_open();
+}
 
-				socket_write_dgram(buff, sizeof buff);
+void remote_link_env::joystick_close()
+{
+	::joystick_close();
+}
 
-			} else if (msg->command == JS_COMMAND_GETNAME) {
+bool remote_link_env::socket_connect()
+{
+	return ::socket_connect();
+}
 
-				std::string name = js.get_name();
+bool remote_link_env::socket_setup()
+{
+	jslog(JSLOG_INFO, "socket connected");
+	sockconnected = true;
 
-				uint8_t buff[sizeof(jsmessage) + sizeof(jsr_getname) + name.length()];
-				jsmessage   *msg  = (jsmessage *) buff;
-				jsr_getname *data = (jsr_getname *) msg->data;
+#ifdef JSREMOTE_ALLOCCHECK
+	// connection setup is not steady state, counting starts after warm-up
+	if (alloccheck_ms) {
+		struct timespec ts;
 
-				msg->length  = sizeof buff;
-				msg->command = JS_COMMAND_GETNAME | JS_RESPONSE;
-				data->length = name.length();
-				memcpy(data->name, name.c_str(), name.length());
+		if (!alloccheck.arm_oneshot(ms2timespec(&ts, alloccheck_ms)))
+			jslog(JSLOG_ERROR, "setting allocation check timer failed");
+	}
+#endif
 
-				socket_write_dgram(buff, sizeof buff);
+	jslog(JSLOG_INFO, "connection memory: rx %zu, tx %zu, ring %zu, gather %zu, spill %zu (up to %zu) bytes",
+	      sock_rx_buff_len, sock_tx_buff_len, sockring.size(), sock_tx_buff_len, txspill_cap, sock_tx_spill_max);
 
-			} else {
-				std::cerr << "unkown command" << std::endl;
-				err= true;
-			}
+	if (lowlat_enabled && !lowlat.setup_socket(sock.fd))
+		jslog(JSLOG_ERROR, "setting socket busy polling failed");
 
-			linbuff_skip(&sock.rxbuff, msg->length);
+#ifdef JSREMOTE_IO_URING
+	if (uring_enabled) {
+		if (!uring.recv(sock.fd, &uring_sock) || !uring.submit()) {
+			jslog(JSLOG_ERROR, "enabling reception on socket failed");
+			return false;
 		}
+	} else
+#endif
+	if (!sock.enable_rx()) {
+		jslog(JSLOG_ERROR, "enabling reception on socket failed");
+		return false;
+	}
 
-		linbuff_compact(&sock.rxbuff);
+	socket_write_hello();
+
+	// state goes out once the server answered hello (and session),
+	// legacy servers never answer and get all of it after a while
+	session_resyncing = true;
+
+	struct timespec ts;
+
+	if (!resync.arm_oneshot(ms2timespec(&ts, SESSION_RESYNC_MS))) {
+		jslog(JSLOG_ERROR, "setting resync timer failed");
+		return false;
 	}
 
-finish:
+	return true;
+}
 
-	if (err) {
-		socket_close();
+void remote_link_env::socket_close()
+{
+	::socket_close();
+}
+
+void remote_link_env::socket_alive()
+{
+	uint8_t buff[JSCODEC_ALIVE_LEN];
+
+	socket_write_dgram(buff, jscodec_put_alive(buff, 0));
+}
+
+void sock_decoder::on_request(uint8_t command, const jsc_request *req)
+{
+	socket_write_metadata(req, command);
+}
+
+void sock_decoder::on_hello(const jsc_hello *hello)
+{
+	jsc_hello local;
+
+	socket_local_proto(&local);
+	jshello_negotiate(&sockproto, &local, hello);
+
+	jslog(JSLOG_INFO, "protocol version %d negotiated", (int) sockproto.version);
+
+	// server speaks the protocol, so it copes with responses it didn't ask for
+	socket_write_metadata(0, JS_COMMAND_GETAXES);
+	socket_write_metadata(0, JS_COMMAND_GETBUTTONS);
+	socket_write_metadata(0, JS_COMMAND_GETNAME);
+
+	if (!session_resyncing)
+		return;
 
-		if (!monitor_server())
-			return -1;
+	if (!(sockproto.encodings & JS_ENCODING_SESSION)) {
+		socket_resync(0);
+		return;
 	}
 
-	return 0;
+	uint8_t     buff[JSCODEC_SESSION_LEN];
+	jsc_session data;
+
+	data.id  = session_id;
+	data.seq = session_acked;
+
+	socket_write_dgram(buff, jscodec_put_session(buff, JS_COMMAND_SESSION, &data));
 }
 
-static int socktx(fdepoller &sender, int len)
+void sock_decoder::on_session_reply(const jsc_session *session)
 {
-	bool err = false;
+	if (!session_resyncing)
+		return;
 
-	if (len < 0) {
-		std::cerr << "socket error" << std::endl;
-		err = true;
+	// server can't have seen more than we sent, nor less than it acked
+	if (session->id != session_id || session->seq > session_seq || (session->seq && session->seq < session_acked)) {
+		jslog(JSLOG_WARN, "session %" PRIu32 " out of sync, sending full state", session_id);
+		socket_resync(0);
+		return;
+	}
 
-	} else if (len == 0) {
-		std::cerr << "socket unexpected error" << std::endl;
-		err = true;
+	jslog(JSLOG_INFO, "session %" PRIu32 " %s %" PRIu32, session_id, session->seq ? "resumed at" : "opened at", session->seq);
+
+	session_acked = session->seq;
+	socket_resync(session->seq);
+}
+
+void sock_decoder::on_ack(const jsc_session *session)
+{
+	if (session->id == session_id && session->seq <= session_seq)
+		session_acked = session->seq;
+}
+
+void sock_decoder::on_subscribe(const jsc_subscribe *sub, const jsc_rate *rates, size_t cnt)
+{
+	jsc_subscribe old = subscription;
+
+	// held samples go out right away, unless the new filter drops them
+	subscription = *sub;
+	subscribe_flush(true);
+
+	memset(sub_interval_ns, 0, sizeof sub_interval_ns);
+
+	for (size_t i = 0; i < cnt; ++i)
+		sub_interval_ns[rates[i].number] = rates[i].max_hz ? 1000000000ULL / rates[i].max_hz : 0;
+
+	jslog(JSLOG_INFO, "subscription changed, %zu axes rate limited", cnt);
+
+	if (!sockconnected || session_resyncing)
+		return;
+
+	// controls which became wanted start from their current state
+	for (const jsstate &st : initev) {
+
+		uint8_t type   = st.ev.type & ~JS_EVENT_INIT;
+		uint8_t number = st.ev.number;
+
+		if (!st.valid || subscribe_wanted(&old, type, number) || !subscribe_wanted(&subscription, type, number))
+			continue;
+
+		jsc_event ev;
+
+		ev.time   = st.ev.time;
+		ev.value  = st.ev.value;
+		ev.type   = st.ev.type;
+		ev.number = st.ev.number;
+
+		socket_send_event(&ev, 0);
 	}
+}
 
-	if (!linbuff_tord(&sock.txbuff))
-		linbuff_compact(&sock.txbuff);
+void sock_decoder::on_unknown(const jsmessage *msg)
+{
+	// skipped, newer servers may send commands we don't know yet
+	jslog(JSLOG_WARN, "unknown command %d", (int) msg->command);
+}
 
-	if (err) {
-		socket_close();
+#ifdef JSREMOTE_IO_URING
+void uring_handler_js::uring_done(jsuring *ur, int op, int res)
+{
+	--uring_jspending;
+
+	if (op == jsuring::OP_READ) {
+
+		if (res == sizeof(jsc_event)) {
+			struct js_event event;
+
+			memcpy(&event, uring_jsbuff + sizeof(jsmessage), sizeof event);
+			uring_jsread = true;
+
+			// state first, so sending it stamps it as sent
+			joystick_event(&event);
+
+			// socket connected while the read-only chain was in flight
+			if (!uring_jslinked && sockconnected && !session_resyncing)
+				socket_write_event(&event, 0);
+
+		} else if (res != -ECANCELED && uring_jsfd != -1) {
+			jslog(JSLOG_ERROR, "joystick error");
+			jserr(js);
+			return;
+		}
+
+	} else if (op == jsuring::OP_SEND) {
+
+		if (res > 0)
+			jsl.transmitted();
 
-		if (!monitor_server())
-			return -1;
+		if (res == -ECANCELED) {
+
+			// cancelled behind queued bytes after the event was read, frame is queued behind them
+			if (uring_jsread && sockconnected)
+				socket_push(uring_jsbuff, sizeof uring_jsbuff);
+
+		} else if (res != JSCODEC_EVENT_LEN && sockconnected) {
+			// short send leaves the stream mid-frame, other writes may follow already
+			if (res < 0)
+				jslog(JSLOG_ERROR, "socket error");
+			else
+				jslog(JSLOG_ERROR, "socket short send");
+
+			if (!jsl.socket_lost())
+				jslog(JSLOG_ERROR, "setting server monitor failed");
+		}
 	}
 
-	return 0;
+	if (!uring_jspending && !uring_joystick_arm())
+		jslog(JSLOG_ERROR, "arming joystick read failed");
 }
 
-static int sockerr(fdepoller &sender)
+void uring_handler_sock::uring_recv(jsuring *ur, const uint8_t *data, int len)
 {
-	std::cerr << "socket error" << std::endl;
-	socket_close();
-	return 0;
+	bool err = false;
+
+	// late completions of a cancelled receive
+	if (!sockconnected || len == -ECANCELED)
+		return;
+
+	if (len == -ENOBUFS) {
+		if (!uring.recv(sock.fd, &uring_sock) || !uring.submit())
+			err = true;
+
+	} else if (len < 0) {
+		jslog(JSLOG_ERROR, "socket error");
+		err = true;
+
+	} else if (len == 0) {
+		jslog(JSLOG_INFO, "socket disconnected");
+		err = true;
+
+	} else if (sockring.write(data, len) != (size_t) len) {
+		jslog(JSLOG_ERROR, "socket rx ring overflow");
+		err = true;
+
+	} else if (!socket_parse())
+		err = true;
+
+	if (err && !jsl.socket_lost())
+		jslog(JSLOG_ERROR, "setting server monitor failed");
 }
+#endif
 
 ////////////////////////////////////////////////////////////////////////////////
 // main
@@ -586,6 +1848,53 @@ int main(int argc, char **argv)
 			case 'l':
 				mon_alive_period_ms = strtoul(optarg, NULL, 10);
 				break;
+			case 'B':
+				if (!parse_buffers(optarg)) {
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				break;
+			case 'b':
+				if (!parse_batch(optarg)) {
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				break;
+#ifdef JSREMOTE_ALLOCCHECK
+			case 'A':
+				alloccheck_ms = strtoul(optarg, NULL, 10);
+				if (!alloccheck_ms) {
+					std::cerr << "invalid allocation check warm-up" << std::endl;
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				break;
+#endif
+			case 't':
+				trace_enabled = true;
+				break;
+			case 'L':
+				lowlat_enabled = true;
+				if (!jslowlat::parse(&lowlat_cfg, optarg)) {
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				break;
+#ifdef JSREMOTE_IO_URING
+			case 'u':
+				uring_enabled = true;
+				break;
+			case 'Q':
+				uring_sqpoll = true;
+				break;
+#endif
+			case 'v':
+				verbose = true;
+				break;
 			case -1:
 				break;
 			default:
@@ -627,11 +1936,25 @@ int main(int argc, char **argv)
 		err = true;
 		goto unwind;
 	}
+	if (batch_size > sock_tx_buff_len) {
+		std::cerr << "batch size exceeds tx buffer" << std::endl;
+		print_help();
+		err = true;
+		goto unwind;
+	}
+
+	// initialize logging, before low-latency mode pins the loop thread
+	jslog_set_level(verbose ? JSLOG_EVENT : JSLOG_INFO);
+
+	if (!jslog_init(LOG_SLOTS)) {
+		err = true;
+		goto unwind;
+	}
 
 	// initialize epoller
 	if (!epoller.init()) {
 		err = true;
-		goto unwind;
+		goto unwind_log;
 	}
 
 	// initialize signal catcher
@@ -641,34 +1964,140 @@ int main(int argc, char **argv)
 	}
 	sc._sighandler = &sighandler;
 
+	// initialize low-latency mode
+	if (lowlat_enabled && !lowlat.init(&lowlat_cfg)) {
+		err = true;
+		goto unwind_sc;
+	}
+
+	// initialize socket reception ring
+	if (!sockring.init(sock_rx_ring_len)) {
+		err = true;
+		goto unwind_lowlat;
+	}
+
+	// initialize socket output stage
+	if (!socket_gather_init()) {
+		err = true;
+		goto unwind_sockring;
+	}
+
+#ifdef JSREMOTE_IO_URING
+	// initialize io_uring backend
+	if (uring_enabled && !uring.init(URING_ENTRIES, URING_BUFS, URING_BUF_LEN, uring_sqpoll)) {
+		err = true;
+		goto unwind_gather;
+	}
+#endif
+
 	// initialize joystick/server monitor
 	if (!mon.init()) {
 		err = true;
-		goto unwind_sc;
+		goto unwind_uring;
 	}
-	if (!monitor_joystick()) {
+	mon._timerhandler = &monhandler;
+	if (!keepalive.init()) {
 		err = true;
 		goto unwind_mon;
 	}
+	keepalive._timerhandler = &keepalivehandler;
+	jsl.init(&jsl_env, mon_joystick_period_ms, mon_server_period_ms, mon_alive_period_ms);
+	if (!resync.init()) {
+		err = true;
+		goto unwind_keepalive;
+	}
+	resync._timerhandler = &resynchandler;
+	if (!subflush.init()) {
+		err = true;
+		goto unwind_resync;
+	}
+	subflush._timerhandler = &subflushhandler;
+	subscribe_reset();
+
+	// initialize batch timer
+	if (!batch.init()) {
+		err = true;
+		goto unwind_subflush;
+	}
+	batch._timerhandler = &batchhandler;
+
+#ifdef JSREMOTE_ALLOCCHECK
+	// initialize allocation check timer
+	if (!alloccheck.init()) {
+		err = true;
+		goto unwind_batch;
+	}
+	alloccheck._timerhandler = &alloccheckhandler;
+#endif
+
+	if (!jsl.start()) {
+		err = true;
+		goto unwind_alloccheck;
+	}
 
 	// enter the loop
-	std::cout << "waiting for signal... [TERM, INT, QUIT]" << std::endl;
+	jslog(JSLOG_INFO, "waiting for signal... [TERM, INT, QUIT]");
 	err = !epoller.loop();
 
 	// cleanups
 
-	socket_close();
-	joystick_close();
+	jsl.stop();
+
+#ifdef JSREMOTE_ALLOCCHECK
+	if (alloccheck_ms) {
+		std::cout << "steady state allocations: " << jsalloc_get_count() << std::endl;
+		if (jsalloc_get_count())
+			err = true;
+	}
+#endif
+
+unwind_alloccheck:
+#ifdef JSREMOTE_ALLOCCHECK
+	alloccheck.cleanup();
+
+// reached only from allocation check initialization
+unwind_batch:
+#endif
+	batch.cleanup();
+
+unwind_subflush:
+	subflush.cleanup();
+
+unwind_resync:
+	resync.cleanup();
+
+unwind_keepalive:
+	keepalive.cleanup();
 
 unwind_mon:
 	mon.cleanup();
 
+unwind_uring:
+#ifdef JSREMOTE_IO_URING
+	uring.cleanup();
+
+// reached only from io_uring initialization
+unwind_gather:
+#endif
+	socket_gather_cleanup();
+
+unwind_sockring:
+	sockring.cleanup();
+
+unwind_lowlat:
+	if (lowlat_enabled)
+		lowlat.print_stats();
+	lowlat.cleanup();
+
 unwind_sc:
 	sc.cleanup();
 
 unwind_epoller:
 	epoller.cleanup();
 
+unwind_log:
+	jslog_cleanup();
+
 unwind:
 	if (err) {
 		std::cout << "finished with error" << std::endl;
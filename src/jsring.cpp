@@ -0,0 +1,178 @@
+#include "jsring.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+#include <cstring>
+#include <iostream>
+
+#define DBG_PREFIX "jsring: "
+
+jsring::jsring() : buff(0), len(0), rd(0), used(0)
+{
+}
+
+jsring::~jsring()
+{
+	cleanup();
+}
+
+bool jsring::init(size_t len)
+{
+	size_t page = sysconf(_SC_PAGESIZE);
+	uint8_t *addr;
+	int fd;
+
+	cleanup();
+
+	len = (len + page - 1) / page * page;
+	if (!len)
+		len = page;
+
+	fd = memfd_create("jsring", MFD_CLOEXEC);
+	if (fd == -1) {
+		std::cerr << DBG_PREFIX"creating memory file failed" << std::endl;
+		return false;
+	}
+
+	if (ftruncate(fd, len) == -1) {
+		std::cerr << DBG_PREFIX"sizing memory file failed" << std::endl;
+		close(fd);
+		return false;
+	}
+
+	// reserve address space for both views, then map the file into each half
+	addr = (uint8_t *) mmap(NULL, 2 * len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (addr == MAP_FAILED) {
+		std::cerr << DBG_PREFIX"reserving address space failed" << std::endl;
+		close(fd);
+		return false;
+	}
+
+	if (mmap(addr,       len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+	    mmap(addr + len, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		std::cerr << DBG_PREFIX"mapping memory file failed" << std::endl;
+		munmap(addr, 2 * len);
+		close(fd);
+		return false;
+	}
+
+	close(fd);
+
+	this->buff = addr;
+	this->len  = len;
+	this->rd   = 0;
+	this->used = 0;
+
+	return true;
+}
+
+void jsring::cleanup()
+{
+	if (!buff)
+		return;
+
+	munmap(buff, 2 * len);
+
+	buff = 0;
+	len  = 0;
+	rd   = 0;
+	used = 0;
+}
+
+bool jsring::is_initialized() const
+{
+	return buff != 0;
+}
+
+void jsring::clear()
+{
+	rd   = 0;
+	used = 0;
+}
+
+size_t jsring::size() const
+{
+	return len;
+}
+
+size_t jsring::tord() const
+{
+	return used;
+}
+
+size_t jsring::towr() const
+{
+	return len - used;
+}
+
+uint8_t *jsring::rd_ptr() const
+{
+	return buff + rd;
+}
+
+uint8_t *jsring::wr_ptr() const
+{
+	return buff + rd + used;
+}
+
+void jsring::skip(size_t n)
+{
+	rd   += n;
+	used -= n;
+
+	if (rd >= len)
+		rd -= len;
+
+	if (!used)
+		rd = 0;
+}
+
+void jsring::commit(size_t n)
+{
+	used += n;
+}
+
+size_t jsring::write(const void *data, size_t n)
+{
+	if (n > towr())
+		n = towr();
+
+	memcpy(wr_ptr(), data, n);
+	commit(n);
+
+	return n;
+}
+
+ssize_t jsring::fill(int fd, bool *eof)
+{
+	ssize_t total = 0;
+
+	*eof = false;
+
+	while (towr()) {
+		ssize_t ret = recv(fd, wr_ptr(), towr(), MSG_DONTWAIT);
+
+		if (ret > 0) {
+			commit(ret);
+			total += ret;
+
+		} else if (ret == 0) {
+			*eof = true;
+			break;
+
+		} else if (errno == EINTR) {
+			continue;
+
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			break;
+
+		} else
+			return -1;
+	}
+
+	return total;
+}
+
@@ -0,0 +1,252 @@
+#include "jsshape.h"
+
+#include <math.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define DBG_PREFIX "jsshape: "
+
+#define RANGE 32767.0f
+
+jsshaper::jsshaper()
+{
+	reset();
+
+	kern      = &jsshaper::apply_scalar;
+	kern_name = "scalar";
+
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		kern      = &jsshaper::apply_avx2;
+		kern_name = "avx2";
+	} else if (__builtin_cpu_supports("sse2")) {
+		kern      = &jsshaper::apply_sse2;
+		kern_name = "sse2";
+	}
+#endif
+}
+
+bool jsshaper::parse(jsshape_axis *cfg, const char *str)
+{
+	enum { OPT_MIN, OPT_CENTER, OPT_MAX, OPT_DEADZONE, OPT_EXPO };
+	static char *const tokens[] = {(char *) "min", (char *) "center", (char *) "max", (char *) "deadzone", (char *) "expo", NULL};
+
+	cfg->min      = -32767;
+	cfg->center   = 0;
+	cfg->max      = 32767;
+	cfg->deadzone = 0;
+	cfg->expo     = 0;
+
+	if (!str)
+		return true;
+
+	// getsubopt modifies its input
+	char  buff[strlen(str) + 1];
+	char *opts = buff;
+	char *value;
+
+	strcpy(buff, str);
+
+	while (*opts) {
+		int opt = getsubopt(&opts, tokens, &value);
+
+		if (opt < 0) {
+			std::cerr << DBG_PREFIX"unknown suboption " << value << std::endl;
+			return false;
+		}
+
+		if (!value) {
+			std::cerr << DBG_PREFIX"suboption " << tokens[opt] << " needs a value" << std::endl;
+			return false;
+		}
+
+		switch (opt) {
+			case OPT_MIN:
+				cfg->min = atoi(value);
+				break;
+			case OPT_CENTER:
+				cfg->center = atoi(value);
+				break;
+			case OPT_MAX:
+				cfg->max = atoi(value);
+				break;
+			case OPT_DEADZONE:
+				cfg->deadzone = strtof(value, NULL);
+				break;
+			case OPT_EXPO:
+				cfg->expo = strtof(value, NULL);
+				break;
+		}
+	}
+
+	return true;
+}
+
+void jsshaper::reset()
+{
+	jsshape_axis cfg;
+
+	parse(&cfg, NULL);
+	set_axes(&cfg);
+}
+
+bool jsshaper::set_axis(uint8_t number, const jsshape_axis *cfg)
+{
+	if (cfg->min >= cfg->center || cfg->center >= cfg->max) {
+		std::cerr << DBG_PREFIX"axis " << (int) number << " needs min < center < max" << std::endl;
+		return false;
+	}
+
+	if (!(cfg->deadzone >= 0 && cfg->deadzone < 1) || !(cfg->expo >= 0 && cfg->expo <= 1)) {
+		std::cerr << DBG_PREFIX"axis " << (int) number << " deadzone or expo out of range" << std::endl;
+		return false;
+	}
+
+	// kernels only multiply, divisions are done here
+	center[number]         = cfg->center;
+	scale_neg[number]      = 1.0f / ((float) cfg->center - cfg->min);
+	scale_pos[number]      = 1.0f / ((float) cfg->max - cfg->center);
+	deadzone[number]       = cfg->deadzone;
+	deadzone_scale[number] = 1.0f / (1.0f - cfg->deadzone);
+	expo[number]           = cfg->expo;
+
+	return true;
+}
+
+bool jsshaper::set_axes(const jsshape_axis *cfg)
+{
+	for (size_t i = 0; i < JSSHAPE_AXES_MAX; ++i)
+		if (!set_axis(i, cfg))
+			return false;
+
+	return true;
+}
+
+void jsshaper::apply(const int16_t *in, int16_t *out, size_t n) const
+{
+	if (n > JSSHAPE_AXES_MAX)
+		n = JSSHAPE_AXES_MAX;
+
+	kern(this, in, out, 0, n);
+}
+
+int16_t jsshaper::apply(uint8_t number, int16_t value) const
+{
+	int16_t out;
+
+	apply_scalar(this, &value, &out, number, 1);
+
+	return out;
+}
+
+const char *jsshaper::get_kernel_name() const
+{
+	return kern_name;
+}
+
+void jsshaper::apply_scalar(const jsshaper *shaper, const int16_t *in, int16_t *out, size_t first, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+
+		size_t k = first + i;
+		float  d = in[i] - shaper->center[k];
+		float  t = d * (d < 0 ? shaper->scale_neg[k] : shaper->scale_pos[k]);
+		float  a = fminf(fabsf(t), 1.0f);
+
+		a = fmaxf(a - shaper->deadzone[k], 0.0f) * shaper->deadzone_scale[k];
+		a = a + shaper->expo[k] * (a * a * a - a);
+
+		out[i] = (int16_t) lrintf(copysignf(a, t) * RANGE);
+	}
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse2")))
+void jsshaper::apply_sse2(const jsshaper *shaper, const int16_t *in, int16_t *out, size_t first, size_t n)
+{
+	const __m128 sign  = _mm_set1_ps(-0.0f);
+	const __m128 zero  = _mm_setzero_ps();
+	const __m128 one   = _mm_set1_ps(1.0f);
+	const __m128 range = _mm_set1_ps(RANGE);
+	size_t       i     = 0;
+
+	// 8 axes per round, two float halves packed back with saturation
+	for (; i + 8 <= n; i += 8) {
+
+		__m128i raw = _mm_loadu_si128((const __m128i *) (in + i));
+		__m128  x[2];
+
+		x[0] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(raw, raw), 16));
+		x[1] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(raw, raw), 16));
+
+		__m128i y[2];
+
+		for (size_t h = 0; h < 2; ++h) {
+
+			size_t k = first + i + h * 4;
+			__m128 d = _mm_sub_ps(x[h], _mm_loadu_ps(shaper->center + k));
+			__m128 m = _mm_cmplt_ps(d, zero);
+			__m128 s = _mm_or_ps(_mm_and_ps(m, _mm_loadu_ps(shaper->scale_neg + k)), _mm_andnot_ps(m, _mm_loadu_ps(shaper->scale_pos + k)));
+			__m128 t = _mm_mul_ps(d, s);
+			__m128 a = _mm_min_ps(_mm_andnot_ps(sign, t), one);
+
+			a = _mm_mul_ps(_mm_max_ps(_mm_sub_ps(a, _mm_loadu_ps(shaper->deadzone + k)), zero), _mm_loadu_ps(shaper->deadzone_scale + k));
+			a = _mm_add_ps(a, _mm_mul_ps(_mm_loadu_ps(shaper->expo + k), _mm_sub_ps(_mm_mul_ps(_mm_mul_ps(a, a), a), a)));
+			a = _mm_or_ps(a, _mm_and_ps(sign, t));
+
+			y[h] = _mm_cvtps_epi32(_mm_mul_ps(a, range));
+		}
+
+		_mm_storeu_si128((__m128i *) (out + i), _mm_packs_epi32(y[0], y[1]));
+	}
+
+	apply_scalar(shaper, in + i, out + i, first + i, n - i);
+}
+
+__attribute__((target("avx2")))
+void jsshaper::apply_avx2(const jsshaper *shaper, const int16_t *in, int16_t *out, size_t first, size_t n)
+{
+	const __m256 sign  = _mm256_set1_ps(-0.0f);
+	const __m256 zero  = _mm256_setzero_ps();
+	const __m256 one   = _mm256_set1_ps(1.0f);
+	const __m256 range = _mm256_set1_ps(RANGE);
+	size_t       i     = 0;
+
+	// 16 axes per round, packing works per 128-bit lane so quadwords are reordered back
+	for (; i + 16 <= n; i += 16) {
+
+		__m256i y[2];
+
+		for (size_t h = 0; h < 2; ++h) {
+
+			size_t  k = first + i + h * 8;
+			__m256  x = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *) (in + i + h * 8))));
+			__m256  d = _mm256_sub_ps(x, _mm256_loadu_ps(shaper->center + k));
+			__m256  s = _mm256_blendv_ps(_mm256_loadu_ps(shaper->scale_pos + k), _mm256_loadu_ps(shaper->scale_neg + k), d);
+			__m256  t = _mm256_mul_ps(d, s);
+			__m256  a = _mm256_min_ps(_mm256_andnot_ps(sign, t), one);
+
+			a = _mm256_mul_ps(_mm256_max_ps(_mm256_sub_ps(a, _mm256_loadu_ps(shaper->deadzone + k)), zero), _mm256_loadu_ps(shaper->deadzone_scale + k));
+			a = _mm256_add_ps(a, _mm256_mul_ps(_mm256_loadu_ps(shaper->expo + k), _mm256_sub_ps(_mm256_mul_ps(_mm256_mul_ps(a, a), a), a)));
+			a = _mm256_or_ps(a, _mm256_and_ps(sign, t));
+
+			y[h] = _mm256_cvtps_epi32(_mm256_mul_ps(a, range));
+		}
+
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(y[0], y[1]), 0xD8);
+
+		_mm256_storeu_si256((__m256i *) (out + i), packed);
+	}
+
+	apply_sse2(shaper, in + i, out + i, first + i, n - i);
+}
+#endif
+
@@ -0,0 +1,304 @@
+#include "jsshm.h"
+#include "jsclock.h"
+
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/joystick.h>
+
+#include <cstring>
+#include <iostream>
+
+#define DBG_PREFIX "jsshm: "
+
+#define HEADER_LEN   64u
+#define READ_RETRIES 1000u
+
+static_assert(sizeof(jsshm_header) <= HEADER_LEN, "header doesn't fit its cache line");
+
+jsshm::jsshm() : hdr(0), peers(0), len(0), writer(false)
+{
+}
+
+jsshm::~jsshm()
+{
+	cleanup();
+}
+
+bool jsshm::init(const std::string &name, size_t peers)
+{
+	cleanup();
+
+	int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+	if (fd == -1) {
+		std::cerr << DBG_PREFIX"opening " << name << " failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	struct stat sb;
+	size_t      len   = HEADER_LEN + peers * sizeof(jsshm_peer);
+	bool        reuse = false;
+
+	if (fstat(fd, &sb)) {
+		std::cerr << DBG_PREFIX"stat of " << name << " failed: " << strerror(errno) << std::endl;
+		::close(fd);
+		return false;
+	}
+
+	if ((size_t) sb.st_size == len) {
+		jsshm_header old;
+
+		reuse = pread(fd, &old, sizeof old, 0) == sizeof old && !memcmp(old.magic, JSSHM_MAGIC, sizeof old.magic) &&
+		        old.peers == peers && old.peer_len == sizeof(jsshm_peer);
+	}
+
+	// segment of other layout is replaced, its readers keep the old one until they re-attach
+	if (!reuse && sb.st_size) {
+		::close(fd);
+		shm_unlink(name.c_str());
+
+		if ((fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644)) == -1) {
+			std::cerr << DBG_PREFIX"creating " << name << " failed: " << strerror(errno) << std::endl;
+			return false;
+		}
+	}
+
+	if (!reuse && ftruncate(fd, len)) {
+		std::cerr << DBG_PREFIX"sizing " << name << " failed: " << strerror(errno) << std::endl;
+		::close(fd);
+		return false;
+	}
+
+	if (!map(fd, len, true))
+		return false;
+
+	writer = true;
+
+	if (reuse) {
+		// attached readers see every slot go inactive, then the new generation
+		for (size_t i = 0; i < peers; ++i)
+			if (this->peers[i].active)
+				peer_close(i);
+
+		__atomic_store_n(&hdr->generation, hdr->generation + 1, __ATOMIC_RELEASE);
+	} else {
+		hdr->peers      = peers;
+		hdr->peer_len   = sizeof(jsshm_peer);
+		hdr->generation = 1;
+
+		// magic last, so readers never attach half created segment
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		memcpy(hdr->magic, JSSHM_MAGIC, sizeof hdr->magic);
+	}
+
+	return true;
+}
+
+bool jsshm::attach(const std::string &name)
+{
+	cleanup();
+
+	int fd = shm_open(name.c_str(), O_RDONLY | O_CLOEXEC, 0);
+
+	if (fd == -1) {
+		std::cerr << DBG_PREFIX"opening " << name << " failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	struct stat  sb;
+	jsshm_header h;
+
+	if (fstat(fd, &sb) || (size_t) sb.st_size < HEADER_LEN || pread(fd, &h, sizeof h, 0) != sizeof h ||
+	    memcmp(h.magic, JSSHM_MAGIC, sizeof h.magic) || h.peer_len != sizeof(jsshm_peer) ||
+	    (size_t) sb.st_size < HEADER_LEN + (size_t) h.peers * sizeof(jsshm_peer)) {
+		std::cerr << DBG_PREFIX << name << " is not a peer state segment" << std::endl;
+		::close(fd);
+		return false;
+	}
+
+	writer = false;
+
+	return map(fd, HEADER_LEN + (size_t) h.peers * sizeof(jsshm_peer), false);
+}
+
+void jsshm::cleanup()
+{
+	if (!hdr)
+		return;
+
+	// segment is kept for readers, they see the server gone
+	if (writer) {
+		for (size_t i = 0; i < hdr->peers; ++i)
+			if (peers[i].active)
+				peer_close(i);
+	}
+
+	munmap(hdr, len);
+
+	hdr    = 0;
+	peers  = 0;
+	len    = 0;
+	writer = false;
+}
+
+size_t jsshm::get_peers() const
+{
+	return hdr ? hdr->peers : 0;
+}
+
+uint32_t jsshm::get_generation() const
+{
+	return hdr ? __atomic_load_n(&hdr->generation, __ATOMIC_ACQUIRE) : 0;
+}
+
+bool jsshm::read(size_t i, jsshm_peer *out) const
+{
+	if (!hdr || i >= hdr->peers)
+		return false;
+
+	const jsshm_peer *p = &peers[i];
+
+	for (size_t tries = 0; tries < READ_RETRIES; ++tries) {
+
+		uint32_t seq = __atomic_load_n(&p->seq, __ATOMIC_ACQUIRE);
+
+		if (seq & 1)
+			continue;
+
+		memcpy(out, p, sizeof *out);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+		if (__atomic_load_n(&p->seq, __ATOMIC_RELAXED) == seq)
+			return true;
+	}
+
+	return false;
+}
+
+void jsshm::peer_open(size_t i, const int16_t *axes, const uint8_t *buttons)
+{
+	jsshm_peer *p = write_begin(i);
+
+	if (!p)
+		return;
+
+	++p->generation;
+	p->active      = 1;
+	p->meta        = 0;
+	p->axes_cnt    = 0;
+	p->buttons_cnt = 0;
+	p->events      = 0;
+	p->name[0]     = 0;
+
+	memcpy(p->axes, axes, sizeof p->axes);
+	memcpy(p->buttons, buttons, sizeof p->buttons);
+
+	write_end(p);
+}
+
+void jsshm::peer_close(size_t i)
+{
+	jsshm_peer *p = write_begin(i);
+
+	if (!p)
+		return;
+
+	p->active = 0;
+
+	write_end(p);
+}
+
+void jsshm::peer_state(size_t i, const int16_t *axes, const uint8_t *buttons)
+{
+	jsshm_peer *p = write_begin(i);
+
+	if (!p)
+		return;
+
+	memcpy(p->axes, axes, sizeof p->axes);
+	memcpy(p->buttons, buttons, sizeof p->buttons);
+
+	write_end(p);
+}
+
+void jsshm::peer_event(size_t i, const jsc_event *ev)
+{
+	jsshm_peer *p = write_begin(i);
+
+	if (!p)
+		return;
+
+	uint8_t type = ev->type & ~JS_EVENT_INIT;
+
+	if (type == JS_EVENT_AXIS)
+		p->axes[ev->number] = ev->value;
+	else if (type == JS_EVENT_BUTTON)
+		p->buttons[ev->number] = ev->value != 0;
+
+	++p->events;
+
+	write_end(p);
+}
+
+void jsshm::peer_meta(size_t i, uint8_t meta, uint8_t axes, uint8_t buttons, const std::string &name)
+{
+	jsshm_peer *p = write_begin(i);
+
+	if (!p)
+		return;
+
+	size_t n = name.size() < JSSHM_NAME_LEN - 1 ? name.size() : JSSHM_NAME_LEN - 1;
+
+	p->meta        = meta;
+	p->axes_cnt    = axes;
+	p->buttons_cnt = buttons;
+
+	memcpy(p->name, name.data(), n);
+	p->name[n] = 0;
+
+	write_end(p);
+}
+
+jsshm_peer *jsshm::write_begin(size_t i)
+{
+	if (!writer || i >= hdr->peers)
+		return 0;
+
+	jsshm_peer *p = &peers[i];
+
+	// odd sequence tells readers the slot is being written
+	__atomic_store_n(&p->seq, p->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	return p;
+}
+
+void jsshm::write_end(jsshm_peer *p)
+{
+	p->update_ns = jsclock_ns();
+
+	__atomic_store_n(&p->seq, p->seq + 1, __ATOMIC_RELEASE);
+}
+
+bool jsshm::map(int fd, size_t len, bool writable)
+{
+	void *addr = mmap(NULL, len, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+
+	// mapping keeps the segment, descriptor is not needed anymore
+	::close(fd);
+
+	if (addr == MAP_FAILED) {
+		std::cerr << DBG_PREFIX"mapping failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	hdr       = (jsshm_header *) addr;
+	peers     = (jsshm_peer *) ((uint8_t *) addr + HEADER_LEN);
+	this->len = len;
+
+	return true;
+}
+
@@ -0,0 +1,140 @@
+#include "jsshm.h"
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+////////////////////////////////////////////////////////////////////////////////
+// macros
+////////////////////////////////////////////////////////////////////////////////
+
+#define AXES_PRINTED    8u
+#define BUTTONS_PRINTED 16u
+
+////////////////////////////////////////////////////////////////////////////////
+// variables
+////////////////////////////////////////////////////////////////////////////////
+
+static jsshm    shm;
+static uint32_t interval_ms;
+
+static const char* const short_opts = "hi:";
+
+static const struct option long_opts[] = {
+	{"help",      0, NULL, 'h'},
+	{"interval",  1, NULL, 'i'},
+	{ NULL,       0, NULL,  0 }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+static void print_help();
+static bool print_peers();
+
+////////////////////////////////////////////////////////////////////////////////
+// aux functions
+////////////////////////////////////////////////////////////////////////////////
+
+static void print_help()
+{
+	std::cout << "usage: jsshmcat [arguments] <name>"                                             << std::endl;
+	std::cout << "  -h  --help            print this help"                                        << std::endl;
+	std::cout << "  -i  --interval <ms>   print state every <ms> until interrupted"               << std::endl;
+	std::cout << std::endl;
+}
+
+static bool print_peers()
+{
+	jsshm_peer p;
+	bool       ok = true;
+
+	printf("generation %u\n", shm.get_generation());
+
+	for (size_t i = 0; i < shm.get_peers(); ++i) {
+
+		if (!shm.read(i, &p)) {
+			std::cerr << "peer " << i << " kept changing, not read" << std::endl;
+			ok = false;
+			continue;
+		}
+
+		if (!p.active)
+			continue;
+
+		printf("peer %3zu/%u: %-24s %8" PRIu64 " ev, axes", i, p.generation, p.name, p.events);
+
+		for (size_t a = 0; a < p.axes_cnt && a < AXES_PRINTED; ++a)
+			printf(" %6d", p.axes[a]);
+
+		printf(", buttons ");
+
+		for (size_t b = 0; b < p.buttons_cnt && b < BUTTONS_PRINTED; ++b)
+			putchar(p.buttons[b] ? '1' : '0');
+
+		putchar('\n');
+	}
+
+	fflush(stdout);
+
+	return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	bool err = false;
+	int  next_opt;
+
+	// parse options
+	do {
+		next_opt = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		switch (next_opt) {
+			case 'h':
+				print_help();
+				goto unwind;
+			case 'i':
+				interval_ms = strtoul(optarg, NULL, 10);
+				break;
+			case -1:
+				break;
+			default:
+				std::cerr << "an arguments parsing error encountered" << std::endl;
+				print_help();
+				err = true;
+				goto unwind;
+		}
+	} while (next_opt != -1);
+
+	// check options
+	if (optind + 1 != argc) {
+		std::cerr << "no segment name" << std::endl;
+		print_help();
+		err = true;
+		goto unwind;
+	}
+
+	// attach segment
+	if (!shm.attach(argv[optind])) {
+		err = true;
+		goto unwind;
+	}
+
+	// reading takes no syscalls, only the wait between prints does
+	do {
+		err = !print_peers();
+	} while (interval_ms && !usleep(interval_ms * 1000));
+
+	shm.cleanup();
+
+unwind:
+	return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
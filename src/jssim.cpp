@@ -0,0 +1,855 @@
+#include "jslink.h"
+#include "jscodec.h"
+#include "jsclock.h"
+
+#include <getopt.h>
+#include <linux/joystick.h>
+
+#include <cmath>
+#include <deque>
+#include <queue>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <functional>
+
+////////////////////////////////////////////////////////////////////////////////
+// macros
+////////////////////////////////////////////////////////////////////////////////
+
+#define MON_JOYSTICK_PERIOD_MS 1000u
+#define MON_SERVER_PERIOD_MS   1000u
+#define MON_ALIVE_PERIOD_MS    0u
+#define SIM_AXES               6u
+#define SIM_BUTTONS            12u
+#define LAT_SUBS               8u
+#define LAT_BUCKETS            (62u * LAT_SUBS)
+
+////////////////////////////////////////////////////////////////////////////////
+// types
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief Kind of simulation step.
+enum sim_kind
+{
+	SIM_START,    ///< remote process starts
+	SIM_TIMER,    ///< link timer expires
+	SIM_ALIVE,    ///< keepalive timer expires
+	SIM_CONNECT,  ///< connection attempt completes
+	SIM_DELIVER,  ///< frame arrives at server
+	SIM_INPUT,    ///< joystick produces event
+	SIM_DROP,     ///< connection breaks
+	SIM_UNPLUG,   ///< joystick disappears
+	SIM_PLUG,     ///< joystick comes back
+	SIM_OUTAGE,   ///< server goes down
+	SIM_RECOVER,  ///< server comes back
+};
+
+/// @brief Scheduled simulation step, stale ones are recognized by generation.
+struct sim_event
+{
+	uint64_t at;
+	uint64_t seq;
+	uint32_t idx;
+	uint32_t gen;
+	sim_kind kind;
+
+	// equal times run in scheduling order, so runs are reproducible
+	bool operator>(const sim_event &other) const
+	{
+		return at != other.at ? at > other.at : seq > other.seq;
+	}
+};
+
+/// @brief Frame on its way to server.
+struct sim_frame
+{
+	uint64_t sent_ns;
+	uint8_t  len;
+	uint8_t  data[JSCODEC_TEVENT_LEN];
+};
+
+/// @brief Simulated server, shared by remotes with the same index modulo number of servers.
+struct sim_server
+{
+	bool     up;
+	uint64_t busy_until;  ///< server link is serializing frames until then
+	size_t   conns;
+};
+
+/// @brief Link environment of one simulated remote, in virtual time.
+///        Only jslink is the real code, frames are encoded with jscodec and go
+///        straight into the link model, jsremote's output stage (gather, bulk lane,
+///        spill, session resync, subscription) and jspeer are not simulated.
+class sim_remote : public jslink::env
+{
+public:
+	jslink                link;
+	uint32_t              idx;
+	sim_server           *srv;
+	uint32_t              timer_gen;
+	uint64_t              timer_period;
+	uint32_t              alive_gen;
+	uint32_t              sock_gen;
+	bool                  sock_open;
+	bool                  sock_up;
+	uint32_t              device_gen;
+	bool                  present;
+	bool                  opened;
+	std::deque<sim_frame> inflight;
+	size_t                inflight_bytes;
+	uint64_t              arrive_last;
+
+	sim_remote() : idx(0), srv(0), timer_gen(0), timer_period(0), alive_gen(0), sock_gen(0), sock_open(false), sock_up(false),
+	               device_gen(0), present(true), opened(false), inflight_bytes(0), arrive_last(0) {}
+
+	void send(const uint8_t *data, size_t len);
+	void send_event(uint8_t type, uint8_t number, int16_t value);
+
+	virtual uint64_t now_ns();
+	virtual bool timer_arm(uint64_t ns, bool periodic);
+	virtual void timer_disarm();
+	virtual bool alive_arm(uint64_t ns);
+	virtual void alive_disarm();
+	virtual bool joystick_present();
+	virtual bool joystick_open();
+	virtual void joystick_close();
+	virtual bool socket_connect();
+	virtual bool socket_setup();
+	virtual void socket_close();
+	virtual void socket_alive();
+};
+
+/// @brief Server side decoder, the same codec jspeer parses with.
+struct sim_decoder : public jscodec_visitor
+{
+	uint64_t events;
+	uint64_t hellos;
+	uint64_t alives;
+
+	sim_decoder() : events(0), hellos(0), alives(0) {}
+
+	void on_event(const jsc_event *ev, const jsc_trace *trace) { ++events; }
+	void on_alive(const jsc_hello *hello, const jsc_keepalive *keepalive) { hello ? ++hellos : ++alives; }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// variables
+////////////////////////////////////////////////////////////////////////////////
+
+static uint64_t     sim_now;
+static uint64_t     sim_seq;
+static uint64_t     sim_rnd = 1;
+static std::priority_queue<sim_event, std::vector<sim_event>, std::greater<sim_event>> sim_queue;
+
+static std::vector<sim_remote> remotes;
+static std::vector<sim_server> servers;
+static sim_decoder  decoder;
+
+static size_t       remotes_cnt = 1000;
+static size_t       servers_cnt = 10;
+static double       duration_s  = 60;
+static double       rate_hz     = 100;
+static uint32_t     mon_joystick_period_ms = MON_JOYSTICK_PERIOD_MS;
+static uint32_t     mon_server_period_ms = MON_SERVER_PERIOD_MS;
+static uint32_t     mon_alive_period_ms = MON_ALIVE_PERIOD_MS;
+
+// link model
+static uint64_t     delay_ns  = 1000000;
+static uint64_t     jitter_ns;
+static double       loss;
+static uint64_t     rto_ns    = 200000000;
+static double       bw;
+
+// fault model, mean times between faults, zero disables them
+static double       drop_s;
+static double       outage_s;
+static uint64_t     outage_len_ns = 5000000000ULL;
+static double       unplug_s;
+static uint64_t     unplug_len_ns = 2000000000ULL;
+
+// totals
+static uint64_t     steps;
+static uint64_t     frames_sent;
+static uint64_t     frames_delivered;
+static uint64_t     frames_invalid;
+static uint64_t     events_sent;
+static uint64_t     events_held;
+static uint64_t     bytes_lost;
+static uint64_t     drops;
+static uint64_t     outages;
+static uint64_t     unplugs;
+static uint64_t     fatals;
+static size_t       inflight_max;
+static uint64_t     lat[LAT_BUCKETS];
+static uint64_t     lat_cnt;
+static uint64_t     lat_max;
+
+static const char* const short_opts = "hn:s:d:r:L:F:x:y:l:S:";
+
+static const struct option long_opts[] = {
+	{"help",      0, NULL, 'h'},
+	{"remotes",   1, NULL, 'n'},
+	{"servers",   1, NULL, 's'},
+	{"duration",  1, NULL, 'd'},
+	{"rate",      1, NULL, 'r'},
+	{"link",      1, NULL, 'L'},
+	{"faults",    1, NULL, 'F'},
+	{"jsmon",     1, NULL, 'x'},
+	{"servermon", 1, NULL, 'y'},
+	{"alive",     1, NULL, 'l'},
+	{"seed",      1, NULL, 'S'},
+	{ NULL,       0, NULL,  0 }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// prototypes
+////////////////////////////////////////////////////////////////////////////////
+
+static void print_help();
+static bool parse_link(const char *str);
+static bool parse_faults(const char *str);
+static void print_summary(uint64_t wall_ns);
+
+static uint64_t rnd();
+static double rnd_unit();
+static uint64_t rnd_exp(double mean_s);
+static void schedule(uint64_t at, sim_kind kind, uint32_t idx, uint32_t gen);
+static void lat_record(uint64_t ns);
+static uint64_t lat_percentile(double p);
+static void deliver(sim_remote &r);
+static void step(const sim_event &ev);
+
+////////////////////////////////////////////////////////////////////////////////
+// aux functions
+////////////////////////////////////////////////////////////////////////////////
+
+static void print_help()
+{
+	std::cout << "usage: jssim [arguments]"                                                       << std::endl;
+	std::cout << "runs jslink (reconnect, keepalive) against modelled links and servers"          << std::endl;
+	std::cout << "  -h  --help            print this help"                                        << std::endl;
+	std::cout << "  -n  --remotes <n>     number of simulated remotes, default 1000"              << std::endl;
+	std::cout << "  -s  --servers <n>     number of simulated servers, default 10"                << std::endl;
+	std::cout << "  -d  --duration <s>    simulated time [s], default 60"                         << std::endl;
+	std::cout << "  -r  --rate <hz>       mean joystick event rate per remote, default 100"       << std::endl;
+	std::cout << "  -L  --link <opts>     link model, opts: delay=<us>,jitter=<us>,loss=<0..1>,"  << std::endl;
+	std::cout << "                        rto=<ms>,bw=<B/s> (bandwidth into each server)"         << std::endl;
+	std::cout << "  -F  --faults <opts>   fault model, opts: drop=<s>,outage=<s>,outlen=<ms>,"    << std::endl;
+	std::cout << "                        unplug=<s>,unplen=<ms> (mean times between faults)"     << std::endl;
+	std::cout << "  -x  --jsmon <period>  joystick monitoring period [ms] (default: "             << MON_JOYSTICK_PERIOD_MS << ")" << std::endl;
+	std::cout << "  -y  --servermon <p>   server monitoring period [ms] (default: "               << MON_SERVER_PERIOD_MS   << ")" << std::endl;
+	std::cout << "  -l  --alive <period>  alive packets period [ms] (default: "                   << MON_ALIVE_PERIOD_MS    << ")" << std::endl;
+	std::cout << "  -S  --seed <n>        random seed, same seed gives the same run"              << std::endl;
+	std::cout << std::endl;
+}
+
+static bool parse_link(const char *str)
+{
+	enum { OPT_DELAY, OPT_JITTER, OPT_LOSS, OPT_RTO, OPT_BW };
+	static char *const tokens[] = {(char *) "delay", (char *) "jitter", (char *) "loss", (char *) "rto", (char *) "bw", NULL};
+
+	// getsubopt modifies its input
+	char  buff[strlen(str) + 1];
+	char *opts = buff;
+	char *value;
+
+	strcpy(buff, str);
+
+	while (*opts) {
+		int opt = getsubopt(&opts, tokens, &value);
+
+		if (opt < 0) {
+			std::cerr << "unknown link suboption " << value << std::endl;
+			return false;
+		}
+
+		if (!value) {
+			std::cerr << "link suboption " << tokens[opt] << " needs a value" << std::endl;
+			return false;
+		}
+
+		double v = strtod(value, NULL);
+
+		if (v < 0 || (opt == OPT_LOSS && v > 1)) {
+			std::cerr << "invalid link suboption " << tokens[opt] << std::endl;
+			return false;
+		}
+
+		switch (opt) {
+			case OPT_DELAY:  delay_ns  = v * 1e3; break;
+			case OPT_JITTER: jitter_ns = v * 1e3; break;
+			case OPT_LOSS:   loss      = v;       break;
+			case OPT_RTO:    rto_ns    = v * 1e6; break;
+			case OPT_BW:     bw        = v;       break;
+		}
+	}
+
+	return true;
+}
+
+static bool parse_faults(const char *str)
+{
+	enum { OPT_DROP, OPT_OUTAGE, OPT_OUTLEN, OPT_UNPLUG, OPT_UNPLEN };
+	static char *const tokens[] = {(char *) "drop", (char *) "outage", (char *) "outlen", (char *) "unplug", (char *) "unplen", NULL};
+
+	// getsubopt modifies its input
+	char  buff[strlen(str) + 1];
+	char *opts = buff;
+	char *value;
+
+	strcpy(buff, str);
+
+	while (*opts) {
+		int opt = getsubopt(&opts, tokens, &value);
+
+		if (opt < 0) {
+			std::cerr << "unknown fault suboption " << value << std::endl;
+			return false;
+		}
+
+		if (!value) {
+			std::cerr << "fault suboption " << tokens[opt] << " needs a value" << std::endl;
+			return false;
+		}
+
+		double v = strtod(value, NULL);
+
+		if (v < 0) {
+			std::cerr << "invalid fault suboption " << tokens[opt] << std::endl;
+			return false;
+		}
+
+		switch (opt) {
+			case OPT_DROP:   drop_s        = v;       break;
+			case OPT_OUTAGE: outage_s      = v;       break;
+			case OPT_OUTLEN: outage_len_ns = v * 1e6; break;
+			case OPT_UNPLUG: unplug_s      = v;       break;
+			case OPT_UNPLEN: unplug_len_ns = v * 1e6; break;
+		}
+	}
+
+	return true;
+}
+
+static void print_summary(uint64_t wall_ns)
+{
+	jslink_stats st;
+	uint64_t     connected = 0;
+
+	memset(&st, 0, sizeof st);
+
+	for (const sim_remote &r : remotes) {
+		const jslink_stats &s = r.link.get_stats();
+
+		st.opens         += s.opens;
+		st.connects      += s.connects;
+		st.connected     += s.connected;
+		st.socket_losses += s.socket_losses;
+		st.device_losses += s.device_losses;
+		st.alives        += s.alives;
+		st.down_ns       += s.down_ns;
+		connected        += r.link.get_state() == jslink::CONNECTED;
+
+		if (s.down_max_ns > st.down_max_ns)
+			st.down_max_ns = s.down_max_ns;
+	}
+
+	printf("simulated %.3f s in %.3f s (%.1fx), %" PRIu64 " steps\n",
+	       sim_now / 1e9, wall_ns / 1e9, wall_ns ? sim_now / (double) wall_ns : 0, steps);
+	printf("remotes %zu (%" PRIu64 " connected at end), servers %zu\n", remotes.size(), connected, servers.size());
+	printf("links: %" PRIu64 " opens, %" PRIu64 " connects, %" PRIu64 " connected, %" PRIu64 " socket losses, %" PRIu64 " device losses\n",
+	       st.opens, st.connects, st.connected, st.socket_losses, st.device_losses);
+	printf("faults: %" PRIu64 " drops, %" PRIu64 " outages, %" PRIu64 " unplugs, %" PRIu64 " fatal\n", drops, outages, unplugs, fatals);
+	printf("reconnect: %.1f ms mean, %.1f ms max\n",
+	       st.connected ? st.down_ns / 1e6 / st.connected : 0, st.down_max_ns / 1e6);
+	printf("frames: %" PRIu64 " sent, %" PRIu64 " delivered, %" PRIu64 " invalid, %" PRIu64 " bytes lost with connections\n",
+	       frames_sent, frames_delivered, frames_invalid, bytes_lost);
+	printf("events: %" PRIu64 " sent, %" PRIu64 " decoded, %" PRIu64 " held while disconnected, %" PRIu64 " hellos\n",
+	       events_sent, decoder.events, events_held, decoder.hellos);
+	printf("alives: %" PRIu64 " sent on idle links, %" PRIu64 " decoded\n", st.alives, decoder.alives);
+	printf("latency: p50 %.3f ms, p99 %.3f ms, p99.9 %.3f ms, max %.3f ms\n",
+	       lat_percentile(0.5) / 1e6, lat_percentile(0.99) / 1e6, lat_percentile(0.999) / 1e6, lat_max / 1e6);
+	printf("in flight: %zu bytes max per remote (link model)\n", inflight_max);
+}
+
+static uint64_t rnd()
+{
+	// xorshift64*
+	sim_rnd ^= sim_rnd >> 12;
+	sim_rnd ^= sim_rnd << 25;
+	sim_rnd ^= sim_rnd >> 27;
+	return sim_rnd * 2685821657736338717ULL;
+}
+
+static double rnd_unit()
+{
+	// (0, 1], safe for log
+	return ((rnd() >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+static uint64_t rnd_exp(double mean_s)
+{
+	return -log(rnd_unit()) * mean_s * 1e9;
+}
+
+static void schedule(uint64_t at, sim_kind kind, uint32_t idx, uint32_t gen)
+{
+	sim_queue.push(sim_event{at, sim_seq++, idx, gen, kind});
+}
+
+static void lat_record(uint64_t ns)
+{
+	size_t i = ns;
+
+	// eight linear sub-buckets per power of two
+	if (ns >= LAT_SUBS) {
+		unsigned oct = 63 - __builtin_clzll(ns);
+		i = (oct - 2) * LAT_SUBS + ((ns >> (oct - 3)) & (LAT_SUBS - 1));
+	}
+
+	++lat[i];
+	++lat_cnt;
+
+	if (ns > lat_max)
+		lat_max = ns;
+}
+
+static uint64_t lat_percentile(double p)
+{
+	uint64_t want = ceil(lat_cnt * p);
+	uint64_t seen = 0;
+
+	for (size_t i = 0; i < LAT_BUCKETS && lat_cnt; ++i) {
+		if ((seen += lat[i]) < want)
+			continue;
+
+		if (i < LAT_SUBS)
+			return i;
+
+		// upper bound of bucket, never above the largest one seen
+		unsigned oct = i / LAT_SUBS + 2;
+		uint64_t top = ((LAT_SUBS + i % LAT_SUBS + 1ULL) << (oct - 3)) - 1;
+
+		return top < lat_max ? top : lat_max;
+	}
+
+	return 0;
+}
+
+static void deliver(sim_remote &r)
+{
+	sim_frame        f = r.inflight.front();
+	const jsmessage *msg;
+	uint64_t         events = decoder.events;
+
+	r.inflight.pop_front();
+	r.inflight_bytes -= f.len;
+
+	++frames_delivered;
+
+	if (jscodec_frame(f.data, f.len, JS_MESSAGE_LENGTH_MAX, &msg) != JSCODEC_OK || !jscodec_dispatch(decoder, msg)) {
+		++frames_invalid;
+		return;
+	}
+
+	if (decoder.events != events)
+		lat_record(sim_now - f.sent_ns);
+}
+
+void sim_remote::send(const uint8_t *data, size_t len)
+{
+	if (!sock_up)
+		return;
+
+	sim_frame f;
+	uint64_t  start = sim_now > srv->busy_until ? sim_now : srv->busy_until;
+	uint64_t  tx    = bw ? len * 1e9 / bw : 0;
+
+	// frames share the link into server, stream keeps order of its frames
+	srv->busy_until = start + tx;
+
+	uint64_t arrive = start + tx + delay_ns + (uint64_t) (jitter_ns * rnd_unit()) + (rnd_unit() <= loss ? rto_ns : 0);
+
+	if (arrive < arrive_last)
+		arrive = arrive_last;
+
+	arrive_last = arrive;
+
+	f.sent_ns = sim_now;
+	f.len     = len;
+	memcpy(f.data, data, len);
+
+	inflight.push_back(f);
+	inflight_bytes += len;
+
+	if (inflight_bytes > inflight_max)
+		inflight_max = inflight_bytes;
+
+	++frames_sent;
+
+	schedule(arrive, SIM_DELIVER, idx, sock_gen);
+	link.transmitted();
+}
+
+void sim_remote::send_event(uint8_t type, uint8_t number, int16_t value)
+{
+	uint8_t   buff[JSCODEC_TEVENT_LEN];
+	jsc_event ev;
+
+	ev.time   = sim_now / 1000000;
+	ev.value  = value;
+	ev.type   = type;
+	ev.number = number;
+
+	send(buff, jscodec_put_event(buff, &ev, 0));
+	++events_sent;
+}
+
+uint64_t sim_remote::now_ns()
+{
+	return sim_now;
+}
+
+bool sim_remote::timer_arm(uint64_t ns, bool periodic)
+{
+	timer_period = periodic ? ns : 0;
+	schedule(sim_now + ns, SIM_TIMER, idx, ++timer_gen);
+	return true;
+}
+
+void sim_remote::timer_disarm()
+{
+	++timer_gen;
+}
+
+bool sim_remote::alive_arm(uint64_t ns)
+{
+	schedule(sim_now + ns, SIM_ALIVE, idx, ++alive_gen);
+	return true;
+}
+
+void sim_remote::alive_disarm()
+{
+	++alive_gen;
+}
+
+bool sim_remote::joystick_present()
+{
+	return present;
+}
+
+bool sim_remote::joystick_open()
+{
+	opened = true;
+
+	if (rate_hz)
+		schedule(sim_now + rnd_exp(1 / rate_hz), SIM_INPUT, idx, device_gen);
+
+	return true;
+}
+
+void sim_remote::joystick_close()
+{
+	opened = false;
+	++device_gen;
+}
+
+bool sim_remote::socket_connect()
+{
+	sock_open = true;
+
+	// handshake takes one round trip
+	schedule(sim_now + 2 * delay_ns, SIM_CONNECT, idx, ++sock_gen);
+	return true;
+}
+
+bool sim_remote::socket_setup()
+{
+	sock_up = true;
+	++srv->conns;
+
+	uint8_t       buff[JSCODEC_KALIVE_LEN];
+	jsc_hello     hello = {JS_PROTOCOL_VERSION, JS_ENCODING_SINGLE, JS_MESSAGE_LENGTH_MAX};
+	jsc_keepalive ka    = {(uint16_t) mon_alive_period_ms};
+
+	send(buff, ka.period_ms ? jscodec_put_alive(buff, &hello, &ka) : jscodec_put_alive(buff, &hello));
+
+	// legacy resync, whole state goes out on every connect
+	for (uint8_t i = 0; i < SIM_BUTTONS; ++i)
+		send_event(JS_EVENT_BUTTON | JS_EVENT_INIT, i, 0);
+
+	for (uint8_t i = 0; i < SIM_AXES; ++i)
+		send_event(JS_EVENT_AXIS | JS_EVENT_INIT, i, 0);
+
+	if (drop_s)
+		schedule(sim_now + rnd_exp(drop_s), SIM_DROP, idx, sock_gen);
+
+	return true;
+}
+
+void sim_remote::socket_close()
+{
+	if (!sock_open)
+		return;
+
+	if (sock_up)
+		--srv->conns;
+
+	// whatever was in flight dies with the connection
+	bytes_lost += inflight_bytes;
+	inflight.clear();
+	inflight_bytes = 0;
+	arrive_last    = 0;
+
+	sock_open = false;
+	sock_up   = false;
+	++sock_gen;
+}
+
+void sim_remote::socket_alive()
+{
+	uint8_t buff[JSCODEC_ALIVE_LEN];
+
+	send(buff, jscodec_put_alive(buff, 0));
+}
+
+static void step(const sim_event &ev)
+{
+	// idx is server index for server faults
+	sim_remote *r = ev.kind < SIM_OUTAGE ? &remotes[ev.idx] : 0;
+
+	switch (ev.kind) {
+
+		case SIM_START:
+			if (!r->link.start())
+				++fatals;
+			break;
+
+		case SIM_TIMER:
+			if (ev.gen != r->timer_gen)
+				break;
+
+			if (r->timer_period)
+				schedule(sim_now + r->timer_period, SIM_TIMER, ev.idx, ev.gen);
+
+			if (!r->link.timeout())
+				++fatals;
+			break;
+
+		case SIM_ALIVE:
+			if (ev.gen == r->alive_gen && !r->link.alive_timeout())
+				++fatals;
+			break;
+
+		case SIM_CONNECT:
+			if (ev.gen == r->sock_gen && r->sock_open && !r->link.connected(r->srv->up))
+				++fatals;
+			break;
+
+		case SIM_DELIVER:
+			if (ev.gen == r->sock_gen)
+				deliver(*r);
+			break;
+
+		case SIM_INPUT:
+			if (ev.gen != r->device_gen || !r->opened)
+				break;
+
+			if (r->sock_up) {
+				uint32_t n = rnd() % (SIM_AXES + SIM_BUTTONS);
+
+				if (n < SIM_AXES)
+					r->send_event(JS_EVENT_AXIS, n, (int16_t) rnd());
+				else
+					r->send_event(JS_EVENT_BUTTON, n - SIM_AXES, rnd() & 1);
+			} else
+				++events_held;
+
+			schedule(sim_now + rnd_exp(1 / rate_hz), SIM_INPUT, ev.idx, ev.gen);
+			break;
+
+		case SIM_DROP:
+			if (ev.gen != r->sock_gen || !r->sock_up)
+				break;
+
+			++drops;
+
+			if (!r->link.socket_lost())
+				++fatals;
+			break;
+
+		case SIM_UNPLUG:
+			++unplugs;
+			r->present = false;
+
+			if (r->opened && !r->link.joystick_lost())
+				++fatals;
+
+			schedule(sim_now + unplug_len_ns, SIM_PLUG, ev.idx, 0);
+			break;
+
+		case SIM_PLUG:
+			r->present = true;
+			schedule(sim_now + rnd_exp(unplug_s), SIM_UNPLUG, ev.idx, 0);
+			break;
+
+		case SIM_OUTAGE: {
+			sim_server &srv = servers[ev.idx];
+
+			++outages;
+			srv.up = false;
+
+			for (size_t i = ev.idx; i < remotes.size(); i += servers.size())
+				if (remotes[i].sock_open && !remotes[i].link.socket_lost())
+					++fatals;
+
+			schedule(sim_now + outage_len_ns, SIM_RECOVER, ev.idx, 0);
+			break;
+		}
+
+		case SIM_RECOVER:
+			servers[ev.idx].up = true;
+			schedule(sim_now + rnd_exp(outage_s), SIM_OUTAGE, ev.idx, 0);
+			break;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// main
+////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+	bool     err = false;
+	int      next_opt;
+	uint64_t end_ns;
+	uint64_t wall_ns;
+
+	// parse options
+	do {
+		next_opt = getopt_long(argc, argv, short_opts, long_opts, NULL);
+		switch (next_opt) {
+			case 'h':
+				print_help();
+				goto unwind;
+			case 'n':
+				remotes_cnt = strtoul(optarg, NULL, 10);
+				break;
+			case 's':
+				servers_cnt = strtoul(optarg, NULL, 10);
+				break;
+			case 'd':
+				duration_s = strtod(optarg, NULL);
+				break;
+			case 'r':
+				rate_hz = strtod(optarg, NULL);
+				break;
+			case 'L':
+				if (!parse_link(optarg)) {
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				break;
+			case 'F':
+				if (!parse_faults(optarg)) {
+					print_help();
+					err = true;
+					goto unwind;
+				}
+				break;
+			case 'x':
+				mon_joystick_period_ms = strtoul(optarg, NULL, 10);
+				break;
+			case 'y':
+				mon_server_period_ms = strtoul(optarg, NULL, 10);
+				break;
+			case 'l':
+				mon_alive_period_ms = strtoul(optarg, NULL, 10);
+				break;
+			case 'S':
+				sim_rnd = strtoull(optarg, NULL, 10) | 1;
+				break;
+			case -1:
+				break;
+			default:
+				std::cerr << "an arguments parsing error encountered" << std::endl;
+				print_help();
+				err = true;
+				goto unwind;
+		}
+	} while (next_opt != -1);
+
+	// check options
+	if (!remotes_cnt || !servers_cnt || remotes_cnt > UINT32_MAX) {
+		std::cerr << "invalid number of remotes or servers" << std::endl;
+		print_help();
+		err = true;
+		goto unwind;
+	}
+
+	if (duration_s <= 0 || rate_hz < 0) {
+		std::cerr << "invalid duration or rate" << std::endl;
+		print_help();
+		err = true;
+		goto unwind;
+	}
+
+	if (!mon_joystick_period_ms || !mon_server_period_ms) {
+		std::cerr << "invalid monitoring period" << std::endl;
+		print_help();
+		err = true;
+		goto unwind;
+	}
+
+	// build the world, processes start spread over one joystick monitoring period
+	servers.resize(servers_cnt);
+	remotes.resize(remotes_cnt);
+
+	for (size_t i = 0; i < servers.size(); ++i) {
+		servers[i].up = true;
+
+		if (outage_s)
+			schedule(rnd_exp(outage_s), SIM_OUTAGE, i, 0);
+	}
+
+	for (size_t i = 0; i < remotes.size(); ++i) {
+		sim_remote &r = remotes[i];
+
+		r.idx = i;
+		r.srv = &servers[i % servers.size()];
+		r.link.init(&r, mon_joystick_period_ms, mon_server_period_ms, mon_alive_period_ms);
+
+		schedule(rnd() % (mon_joystick_period_ms * 1000000ULL), SIM_START, i, 0);
+
+		if (unplug_s)
+			schedule(rnd_exp(unplug_s), SIM_UNPLUG, i, 0);
+	}
+
+	// run
+	end_ns  = duration_s * 1e9;
+	wall_ns = jsclock_ns();
+
+	while (!sim_queue.empty() && sim_queue.top().at <= end_ns) {
+		sim_event ev = sim_queue.top();
+
+		sim_queue.pop();
+		sim_now = ev.at;
+		step(ev);
+		++steps;
+	}
+
+	sim_now = end_ns;
+	wall_ns = jsclock_ns() - wall_ns;
+
+	print_summary(wall_ns);
+
+	if (frames_invalid || fatals)
+		err = true;
+
+unwind:
+	return err ? EXIT_FAILURE : EXIT_SUCCESS;
+}
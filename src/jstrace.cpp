@@ -0,0 +1,244 @@
+#include "jstrace.h"
+
+#include <errno.h>
+#include <linux/joystick.h>
+
+#include <new>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#define DBG_PREFIX "jstrace: "
+
+#define DMIN_WINDOW_NS (10ULL * 1000000000ULL)
+
+static const char *const stage_names[jstrace::STAGES_CNT] = {
+	"remote",
+	"network",
+	"dispatch",
+	"consumer",
+};
+
+jstrace::jstrace() : spans(0), spans_len(0), spans_cnt(0), spans_wr(0), rtt_ns(0)
+{
+	reset();
+}
+
+jstrace::~jstrace()
+{
+	cleanup();
+}
+
+bool jstrace::init(size_t spans_len)
+{
+	cleanup();
+
+	if (spans_len) {
+		spans = new (std::nothrow) jstrace::span[spans_len];
+		if (!spans) {
+			std::cerr << DBG_PREFIX"allocating spans failed" << std::endl;
+			return false;
+		}
+	}
+
+	this->spans_len = spans_len;
+
+	reset();
+
+	return true;
+}
+
+void jstrace::cleanup()
+{
+	delete[] spans;
+
+	spans     = 0;
+	spans_len = 0;
+	spans_cnt = 0;
+	spans_wr  = 0;
+}
+
+void jstrace::reset()
+{
+	memset(hist, 0, sizeof hist);
+
+	for (size_t i = 0; i < STAGES_CNT; ++i)
+		hist[i].min = UINT64_MAX;
+
+	spans_cnt     = 0;
+	spans_wr      = 0;
+	dmin_cur      = INT64_MAX;
+	dmin_prev     = INT64_MAX;
+	dmin_start_ns = 0;
+}
+
+void jstrace::set_rtt(uint64_t rtt_ns)
+{
+	this->rtt_ns = rtt_ns;
+}
+
+void jstrace::record(const jsc_event *ev, const jsc_trace *trace, uint64_t decode_ns, uint64_t deliver_ns, uint64_t done_ns)
+{
+	uint64_t read_ns    = decode_ns;
+	uint64_t enqueue_ns = decode_ns;
+
+	if (trace) {
+		// clocks of both hosts are unrelated, the fastest enqueue->decode
+		// seen recently is taken as half of the round trip
+		int64_t d = (int64_t)(decode_ns - trace->enqueue_ns);
+
+		if (!dmin_start_ns || decode_ns - dmin_start_ns > DMIN_WINDOW_NS) {
+			dmin_prev     = dmin_cur;
+			dmin_cur      = INT64_MAX;
+			dmin_start_ns = decode_ns;
+		}
+
+		if (d < dmin_cur)
+			dmin_cur = d;
+
+		int64_t off = offset();
+
+		read_ns    = trace->read_ns + off;
+		enqueue_ns = trace->enqueue_ns + off;
+
+		if (enqueue_ns > decode_ns)
+			enqueue_ns = decode_ns;
+		if (read_ns > enqueue_ns)
+			read_ns = enqueue_ns;
+
+		add(STAGE_REMOTE,  trace->enqueue_ns - trace->read_ns);
+		add(STAGE_NETWORK, decode_ns - enqueue_ns);
+	}
+
+	add(STAGE_DISPATCH, deliver_ns - decode_ns);
+	add(STAGE_CONSUMER, done_ns - deliver_ns);
+
+	if (!spans_len)
+		return;
+
+	jstrace::span &sp = spans[spans_wr];
+
+	sp.stamps[STAGE_REMOTE]   = read_ns;
+	sp.stamps[STAGE_NETWORK]  = enqueue_ns;
+	sp.stamps[STAGE_DISPATCH] = decode_ns;
+	sp.stamps[STAGE_CONSUMER] = deliver_ns;
+	sp.stamps[STAGES_CNT]     = done_ns;
+	sp.type                   = ev->type;
+	sp.number                 = ev->number;
+
+	spans_wr = (spans_wr + 1) % spans_len;
+
+	if (spans_cnt < spans_len)
+		++spans_cnt;
+}
+
+const jstrace::histogram *jstrace::get_histogram(jstrace::stage st) const
+{
+	return &hist[st];
+}
+
+void jstrace::print(std::ostream &os) const
+{
+	for (size_t i = 0; i < STAGES_CNT; ++i) {
+
+		const jstrace::histogram &h = hist[i];
+
+		os << std::setw(8) << stage_names[i] << ": cnt " << h.cnt;
+
+		if (!h.cnt) {
+			os << std::endl;
+			continue;
+		}
+
+		os << ", min " << h.min << " ns, avg " << h.sum / h.cnt << " ns, max " << h.max << " ns" << std::endl;
+
+		for (size_t b = 0; b < JSTRACE_BUCKETS; ++b)
+			if (h.buckets[b])
+				os << "          < 2^" << std::setw(2) << b + 1 << " ns: " << h.buckets[b] << std::endl;
+	}
+}
+
+bool jstrace::export_chrome(const std::string &path) const
+{
+	FILE *f = fopen(path.c_str(), "w");
+
+	if (!f) {
+		std::cerr << DBG_PREFIX"opening " << path << " failed: " << strerror(errno) << std::endl;
+		return false;
+	}
+
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+	bool first = true;
+
+	// oldest span first, one complete event per stage, one track per stage
+	for (size_t i = 0; i < spans_cnt; ++i) {
+
+		const jstrace::span &sp = spans[(spans_wr + spans_len - spans_cnt + i) % spans_len];
+
+		for (size_t st = 0; st < STAGES_CNT; ++st) {
+
+			if (sp.stamps[st + 1] == sp.stamps[st])
+				continue;
+
+			fprintf(f, "%s{\"name\":\"%s %u\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+			        first ? "" : ",\n",
+			        (sp.type & ~JS_EVENT_INIT) == JS_EVENT_AXIS ? "axis" : "button",
+			        sp.number,
+			        stage_names[st],
+			        st + 1,
+			        sp.stamps[st] / 1000.0,
+			        (sp.stamps[st + 1] - sp.stamps[st]) / 1000.0);
+
+			first = false;
+		}
+	}
+
+	for (size_t st = 0; st < STAGES_CNT; ++st)
+		fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":\"%s\"}}",
+		        first && !st ? "" : ",\n", st + 1, stage_names[st]);
+
+	fprintf(f, "\n]}\n");
+
+	if (fclose(f)) {
+		std::cerr << DBG_PREFIX"writing " << path << " failed" << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+void jstrace::add(jstrace::stage st, uint64_t ns)
+{
+	jstrace::histogram &h = hist[st];
+
+	// wrapped differences (clock adjustment across hosts) are not latencies
+	if ((int64_t) ns < 0)
+		ns = 0;
+
+	size_t b = ns ? 64 - __builtin_clzll(ns) - 1 : 0;
+
+	if (b >= JSTRACE_BUCKETS)
+		b = JSTRACE_BUCKETS - 1;
+
+	++h.buckets[b];
+	++h.cnt;
+	h.sum += ns;
+
+	if (ns < h.min)
+		h.min = ns;
+	if (ns > h.max)
+		h.max = ns;
+}
+
+int64_t jstrace::offset() const
+{
+	int64_t dmin = dmin_cur < dmin_prev ? dmin_cur : dmin_prev;
+
+	if (dmin == INT64_MAX)
+		return 0;
+
+	return dmin - (int64_t)(rtt_ns / 2);
+}
+
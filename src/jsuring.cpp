@@ -0,0 +1,237 @@
+#include "jsuring.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#define DBG_PREFIX "jsuring: "
+
+#define BUF_GROUP    0
+#define OP_MASK      0x7ULL
+#define SQ_IDLE_MS   1000u
+
+static inline uint64_t pack(jsuring::handler *h, int op)
+{
+	return (uint64_t)(uintptr_t) h | (uint64_t) op;
+}
+
+jsuring::jsuring(struct epoller *epoller) : fdepoller(epoller), br(0), bufs(0), bufs_cnt(0), buf_len(0), initialized(false)
+{
+}
+
+jsuring::~jsuring()
+{
+	cleanup();
+}
+
+bool jsuring::init(unsigned entries, unsigned bufs_cnt, size_t buf_len, bool sqpoll)
+{
+	struct io_uring_params params;
+	int ret;
+
+	memset(&params, 0, sizeof params);
+
+	if (sqpoll) {
+		params.flags          = IORING_SETUP_SQPOLL;
+		params.sq_thread_idle = SQ_IDLE_MS;
+	}
+
+	ret = io_uring_queue_init_params(entries, &ring, &params);
+	if (ret < 0) {
+		std::cerr << DBG_PREFIX"initializing ring failed: " << strerror(-ret) << std::endl;
+		return false;
+	}
+
+	br = io_uring_setup_buf_ring(&ring, bufs_cnt, BUF_GROUP, 0, &ret);
+	if (!br) {
+		std::cerr << DBG_PREFIX"registering buffer ring failed: " << strerror(-ret) << std::endl;
+		io_uring_queue_exit(&ring);
+		return false;
+	}
+
+	bufs = (uint8_t *) malloc(bufs_cnt * buf_len);
+	if (!bufs) {
+		std::cerr << DBG_PREFIX"allocating buffers failed" << std::endl;
+		io_uring_free_buf_ring(&ring, br, bufs_cnt, BUF_GROUP);
+		io_uring_queue_exit(&ring);
+		return false;
+	}
+
+	for (unsigned i = 0; i < bufs_cnt; ++i)
+		io_uring_buf_ring_add(br, bufs + i * buf_len, buf_len, i, io_uring_buf_ring_mask(bufs_cnt), i);
+	io_uring_buf_ring_advance(br, bufs_cnt);
+
+	this->bufs_cnt = bufs_cnt;
+	this->buf_len  = buf_len;
+
+	// completions are reaped from the epoller loop
+	if (!fdepoller::init(ring.ring_fd, EPOLLIN)) {
+		std::cerr << DBG_PREFIX"watching ring failed" << std::endl;
+		free(bufs);
+		io_uring_free_buf_ring(&ring, br, bufs_cnt, BUF_GROUP);
+		io_uring_queue_exit(&ring);
+		return false;
+	}
+
+	initialized = true;
+
+	return true;
+}
+
+void jsuring::cleanup()
+{
+	if (!initialized)
+		return;
+
+	fdepoller::cleanup();
+
+	io_uring_free_buf_ring(&ring, br, bufs_cnt, BUF_GROUP);
+	io_uring_queue_exit(&ring);
+	free(bufs);
+
+	br          = 0;
+	bufs        = 0;
+	initialized = false;
+}
+
+bool jsuring::is_initialized()
+{
+	return initialized;
+}
+
+bool jsuring::recv(int fd, jsuring::handler *h)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+
+	if (!sqe) {
+		std::cerr << DBG_PREFIX"submission queue full" << std::endl;
+		return false;
+	}
+
+	io_uring_prep_recv_multishot(sqe, fd, NULL, 0, 0);
+	sqe->flags    |= IOSQE_BUFFER_SELECT;
+	sqe->buf_group = BUF_GROUP;
+	io_uring_sqe_set_data64(sqe, pack(h, OP_RECV));
+
+	return true;
+}
+
+bool jsuring::read_send(int rfd, void *rbuff, size_t rlen, int sfd, const void *sbuff, size_t slen, jsuring::handler *h)
+{
+	if (io_uring_sq_space_left(&ring) < (sfd == -1 ? 1u : 2u)) {
+		std::cerr << DBG_PREFIX"submission queue full" << std::endl;
+		return false;
+	}
+
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+
+	io_uring_prep_read(sqe, rfd, rbuff, rlen, -1);
+	io_uring_sqe_set_data64(sqe, pack(h, OP_READ));
+
+	if (sfd == -1)
+		return true;
+
+	// short read severs the link, partial data are never sent
+	sqe->flags |= IOSQE_IO_LINK;
+
+	sqe = io_uring_get_sqe(&ring);
+	io_uring_prep_send(sqe, sfd, sbuff, slen, MSG_NOSIGNAL);
+	io_uring_sqe_set_data64(sqe, pack(h, OP_SEND));
+
+	return true;
+}
+
+bool jsuring::send(int fd, const void *buff, size_t len, jsuring::handler *h)
+{
+	struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+
+	if (!sqe) {
+		std::cerr << DBG_PREFIX"submission queue full" << std::endl;
+		return false;
+	}
+
+	io_uring_prep_send(sqe, fd, buff, len, MSG_NOSIGNAL);
+	io_uring_sqe_set_data64(sqe, pack(h, OP_SEND));
+
+	return true;
+}
+
+bool jsuring::cancel(jsuring::handler *h)
+{
+	static const int ops[] = {OP_RECV, OP_READ, OP_SEND};
+
+	if (io_uring_sq_space_left(&ring) < sizeof ops / sizeof ops[0]) {
+		std::cerr << DBG_PREFIX"submission queue full" << std::endl;
+		return false;
+	}
+
+	for (size_t i = 0; i < sizeof ops / sizeof ops[0]; ++i) {
+		struct io_uring_sqe *sqe = io_uring_get_sqe(&ring);
+		io_uring_prep_cancel64(sqe, pack(h, ops[i]), IORING_ASYNC_CANCEL_ALL);
+		io_uring_sqe_set_data64(sqe, 0);
+	}
+
+	return submit();
+}
+
+bool jsuring::submit()
+{
+	// with sqpoll this only wakes the kernel thread if it went idle
+	int ret = io_uring_submit(&ring);
+
+	if (ret < 0) {
+		std::cerr << DBG_PREFIX"submitting failed: " << strerror(-ret) << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int jsuring::in()
+{
+	struct io_uring_cqe *cqe;
+	unsigned head;
+	unsigned cnt = 0;
+
+	io_uring_for_each_cqe(&ring, head, cqe) {
+
+		uint64_t           data = io_uring_cqe_get_data64(cqe);
+		jsuring::handler  *h    = (jsuring::handler *)(uintptr_t)(data & ~OP_MASK);
+		int                op   = data & OP_MASK;
+
+		++cnt;
+
+		// cancellation results
+		if (!h)
+			continue;
+
+		if (op == OP_RECV) {
+
+			if (cqe->flags & IORING_CQE_F_BUFFER) {
+				unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+
+				h->uring_recv(this, bufs + bid * buf_len, cqe->res);
+
+				// hand the buffer back to the kernel at once, handler may rearm
+				io_uring_buf_ring_add(br, bufs + bid * buf_len, buf_len, bid, io_uring_buf_ring_mask(bufs_cnt), 0);
+				io_uring_buf_ring_advance(br, 1);
+
+			} else
+				h->uring_recv(this, NULL, cqe->res);
+
+			// multishot stopped without end of stream or error, handler has to rearm
+			if (!(cqe->flags & IORING_CQE_F_MORE) && cqe->res > 0)
+				h->uring_recv(this, NULL, -ENOBUFS);
+
+		} else
+			h->uring_done(this, op, cqe->res);
+	}
+
+	io_uring_cq_advance(&ring, cnt);
+
+	return 0;
+}
+
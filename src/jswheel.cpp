@@ -0,0 +1,191 @@
+#include "jswheel.h"
+
+#include <cstring>
+#include <iostream>
+
+#define DBG_PREFIX "jswheel: "
+
+#define SLOT_BITS 6u
+
+static_assert(JSWHEEL_SLOTS == 1u << SLOT_BITS, "slot bits don't match number of slots");
+
+jswheel::jswheel(struct epoller *epoller) : timepoller(epoller), now(0), tick_ms(0), cnt(0)
+{
+	memset(slots, 0, sizeof slots);
+}
+
+jswheel::~jswheel()
+{
+	cleanup();
+}
+
+bool jswheel::init(uint32_t tick_ms)
+{
+	cleanup();
+
+	if (!tick_ms) {
+		std::cerr << DBG_PREFIX"tick period must not be zero" << std::endl;
+		return false;
+	}
+
+	if (!timepoller::init())
+		return false;
+
+	_timerhandler = &jswheel::timerhandler;
+
+	struct timespec ts;
+
+	ts.tv_sec  = tick_ms / 1000;
+	ts.tv_nsec = (tick_ms % 1000) * 1000000L;
+
+	// ticks all the time, so the tick count is usable as a clock
+	if (!arm_periodic(&ts)) {
+		std::cerr << DBG_PREFIX"arming timer failed" << std::endl;
+		timepoller::cleanup();
+		return false;
+	}
+
+	this->tick_ms = tick_ms;
+	now           = 0;
+
+	return true;
+}
+
+void jswheel::cleanup()
+{
+	for (size_t l = 0; l < JSWHEEL_LEVELS; ++l) {
+		for (size_t s = 0; s < JSWHEEL_SLOTS; ++s) {
+			while (slots[l][s])
+				unlink(slots[l][s]);
+		}
+	}
+
+	if (tick_ms)
+		timepoller::cleanup();
+
+	tick_ms = 0;
+}
+
+bool jswheel::add(jswheel::entry *e, uint32_t timeout_ms)
+{
+	if (!tick_ms)
+		return false;
+
+	if (e->slot)
+		unlink(e);
+
+	uint64_t ticks = (timeout_ms + tick_ms - 1) / tick_ms;
+
+	e->expires = now + (ticks ? ticks : 1);
+	link(e);
+
+	return true;
+}
+
+void jswheel::remove(jswheel::entry *e)
+{
+	if (e->slot)
+		unlink(e);
+}
+
+uint64_t jswheel::get_tick() const
+{
+	return now;
+}
+
+uint32_t jswheel::get_tick_ms() const
+{
+	return tick_ms;
+}
+
+size_t jswheel::get_count() const
+{
+	return cnt;
+}
+
+void jswheel::link(jswheel::entry *e)
+{
+	uint64_t delta = e->expires - now;
+	size_t   level = 0;
+
+	// lowest level whose revolution covers the delta, the top one takes the rest
+	while (level + 1 < JSWHEEL_LEVELS && delta >> (SLOT_BITS * (level + 1)))
+		++level;
+
+	uint64_t at = e->expires;
+
+	if (delta >> (SLOT_BITS * (level + 1)))
+		at = now + ((uint64_t) JSWHEEL_SLOTS << (SLOT_BITS * level)) - 1;
+
+	jswheel::entry **slot = &slots[level][(at >> (SLOT_BITS * level)) & (JSWHEEL_SLOTS - 1)];
+
+	e->slot = slot;
+	e->prev = 0;
+	e->next = *slot;
+
+	if (*slot)
+		(*slot)->prev = e;
+
+	*slot = e;
+	++cnt;
+}
+
+void jswheel::unlink(jswheel::entry *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		*e->slot = e->next;
+
+	if (e->next)
+		e->next->prev = e->prev;
+
+	e->slot = 0;
+	e->prev = 0;
+	e->next = 0;
+	--cnt;
+}
+
+void jswheel::cascade(size_t level)
+{
+	jswheel::entry **slot = &slots[level][(now >> (SLOT_BITS * level)) & (JSWHEEL_SLOTS - 1)];
+
+	// re-linked by the remaining delta, which is now below this level's granularity
+	while (*slot) {
+		jswheel::entry *e = *slot;
+		unlink(e);
+		link(e);
+	}
+}
+
+int jswheel::timerhandler(timepoller &sender, uint64_t exp)
+{
+	jswheel &w = static_cast<jswheel &>(sender);
+
+	while (exp--) {
+
+		++w.now;
+
+		for (size_t level = 1; level < JSWHEEL_LEVELS; ++level) {
+			if (w.now & ((1ULL << (SLOT_BITS * level)) - 1))
+				break;
+			w.cascade(level);
+		}
+
+		jswheel::entry **slot = &w.slots[0][w.now & (JSWHEEL_SLOTS - 1)];
+
+		// expired entry may reschedule itself or remove others
+		while (*slot) {
+			jswheel::entry *e = *slot;
+			w.unlink(e);
+
+			if (e->expires > w.now)
+				w.link(e);
+			else
+				e->expired();
+		}
+	}
+
+	return 0;
+}
+